@@ -0,0 +1,115 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+#include "stdafx.h"
+#include <type_traits>
+
+/**
+ * \brief Memory layer for the coefficients of Tensor, Matrix and Vector.
+ *
+ * All blocks are 64-byte aligned. Freed blocks are kept in a thread-local,
+ * size-class free list (the pool) and handed out again by the next request of
+ * the same size class, so short-lived temporaries in tree sweeps do not hit the
+ * system allocator. Optionally, an Arena can be activated for a scope; all
+ * allocations on that thread are then bump-allocated from the arena.
+ *
+ * Usage:
+ * Memory::resetStatistics();
+ * Sweep(...);
+ * cout << Memory::statistics().allocations << endl;
+ */
+namespace Memory {
+
+	/// Alignment of all blocks in bytes
+	constexpr size_t alignment = 64;
+
+	enum class Policy {
+		Pool,  ///< Thread-local size-class free lists (default)
+		System ///< Every request goes to the system allocator
+	};
+
+	/// Allocation counters (summed over all threads)
+	struct Statistics {
+		size_t allocations = 0;   ///< Number of allocate() calls
+		size_t deallocations = 0; ///< Number of deallocate() calls
+		size_t poolHits = 0;      ///< Requests served from a free list
+		size_t systemAllocations = 0; ///< Requests that went to the system allocator
+		size_t arenaAllocations = 0;  ///< Requests served from an Arena
+		size_t bytesRequested = 0;    ///< Sum of requested bytes
+	};
+
+	/// Allocate an aligned block of at least "bytes" bytes
+	void *allocate(size_t bytes);
+
+	/// Return a block obtained from allocate(); nullptr is ignored
+	void deallocate(void *ptr);
+
+	template<typename T>
+	T *allocate(size_t n) {
+		static_assert(is_trivially_destructible<T>::value,
+			"Memory::allocate only supports trivially destructible types");
+		return (T *) allocate(n * sizeof(T));
+	}
+
+	template<typename T>
+	void deallocate(T *ptr) {
+		deallocate((void *) ptr);
+	}
+
+	void setPolicy(Policy policy);
+	Policy policy();
+
+	/// Maximum number of bytes cached in the free lists of each thread
+	void setPoolCapacity(size_t bytes);
+
+	/// Release all blocks cached in the calling thread's free lists
+	void releasePool();
+
+	Statistics statistics();
+	void resetStatistics();
+
+	/**
+	 * \brief Bump allocator that serves all allocations of a thread inside an ArenaScope.
+	 *
+	 * Deallocating an arena block only decrements the live count. Memory is
+	 * reused after reset(), which requires that no block is alive anymore.
+	 */
+	class Arena {
+	public:
+		explicit Arena(size_t capacity = (1 << 24));
+		~Arena();
+
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+
+		void *allocate(size_t bytes);
+		void release() { --live_; }
+
+		/// Rewind the arena; all blocks have to be deallocated before
+		void reset();
+
+		size_t used() const { return used_; }
+		size_t live() const { return live_; }
+
+	private:
+		vector<pair<char *, size_t>> chunks_;
+		size_t chunk_;
+		size_t offset_;
+		size_t used_;
+		size_t live_;
+	};
+
+	/// Route all allocations of the calling thread to "arena" during the lifetime of this object
+	class ArenaScope {
+	public:
+		explicit ArenaScope(Arena& arena);
+		~ArenaScope();
+
+		ArenaScope(const ArenaScope&) = delete;
+		ArenaScope& operator=(const ArenaScope&) = delete;
+
+	private:
+		Arena *previous_;
+	};
+}
+
+#endif //ALLOCATOR_H
@@ -0,0 +1,99 @@
+#ifndef LAKERNELS_H
+#define LAKERNELS_H
+#include "stdafx.h"
+
+/**
+ * \brief Native C++ versions of the LA_lib.f kernels.
+ *
+ * The index conventions follow LA_lib.f: tensors are addressed as psi(b, a, c)
+ * with b = before, a = active and c = after. In contrast to the Fortran
+ * routines, the active dimensions of in- and output may differ.
+ *
+ * With GCC on x86-64 every kernel is compiled for x86-64-v4 (AVX-512),
+ * x86-64-v3 (AVX2/FMA) and baseline x86-64. The best version for the
+ * executing CPU is selected when the library is loaded.
+ *
+ * matvec, tmatvec and rhomat with square matrices of dimension 2, 3 or 4
+ * (spins, qubits) run on kernels with a compile-time active dimension,
+ * where the matrix is kept in registers and the loops over it are unrolled.
+ */
+namespace LAKernels {
+	typedef complex<double> cd;
+
+	/// Largest active dimension with a fixed-size kernel
+	constexpr size_t maxFixedDim = 4;
+
+	/// True if square (a, a) matrices run on a fixed-size kernel
+	inline bool hasFixedKernel(size_t a) { return a >= 2 && a <= maxFixedDim; }
+
+	/// mulpsi(i, k, j) (+)= matrix(k, l) * psi(i, l, j), matrix is (aC, aB)
+	void matvec(cd *mulpsi, const cd *psi, const cd *matrix,
+		size_t aC, size_t aB, size_t b, size_t c, bool add);
+	void matvec(double *mulpsi, const double *psi, const double *matrix,
+		size_t aC, size_t aB, size_t b, size_t c, bool add);
+
+	/// mulpsi(i, k, j) (+)= matrix(l, k) * psi(i, l, j), matrix is (aB, aC)
+	void tmatvec(cd *mulpsi, const cd *psi, const cd *matrix,
+		size_t aC, size_t aB, size_t b, size_t c, bool add);
+	void tmatvec(double *mulpsi, const double *psi, const double *matrix,
+		size_t aC, size_t aB, size_t b, size_t c, bool add);
+
+	/// matrix(j, i) (+)= conj(bra(n, j, m)) * ket(n, i, m), matrix is (a1, a2)
+	void rhomat(cd *matrix, const cd *bra, const cd *ket,
+		size_t a1, size_t a2, size_t b, size_t c, bool add);
+	void rhomat(double *matrix, const double *bra, const double *ket,
+		size_t a1, size_t a2, size_t b, size_t c, bool add);
+
+	/// mulpsi(k, j) = diag(k) * psi(k, j), psi is (a, c); mulpsi may alias psi
+	void diagmat(cd *mulpsi, const cd *psi, const cd *diag, size_t a, size_t c);
+	void diagmat(double *mulpsi, const double *psi, const double *diag, size_t a, size_t c);
+
+	/**
+	 * mulpsi(k, j) = sum_l matrix(k, l) * psi(l, j), matrix is (aC, aB) in
+	 * compressed sparse row format: the entries of row k are val[p] in
+	 * column col[p] for rowPtr[k] <= p < rowPtr[k + 1].
+	 */
+	void csrmat(cd *mulpsi, const cd *psi, const size_t *rowPtr, const size_t *col,
+		const cd *val, size_t aC, size_t aB, size_t c);
+	void csrmat(double *mulpsi, const double *psi, const size_t *rowPtr, const size_t *col,
+		const double *val, size_t aC, size_t aB, size_t c);
+
+	/**
+	 * Whole-array BLAS-1 kernels. The arrays are processed in chunks; large
+	 * arrays are split over OpenMP threads. Reductions (vdot, vnrm2) add the
+	 * chunk results serially in chunk order, so they do not depend on the
+	 * number of threads.
+	 */
+	/// y = alpha * y
+	void vscal(cd *y, cd alpha, size_t n);
+	void vscal(double *y, double alpha, size_t n);
+
+	/// y += alpha * x
+	void vaxpy(cd *y, const cd *x, cd alpha, size_t n);
+	void vaxpy(double *y, const double *x, double alpha, size_t n);
+
+	/// y = alpha * x + beta * y
+	void vaxpby(cd *y, const cd *x, cd alpha, cd beta, size_t n);
+	void vaxpby(double *y, const double *x, double alpha, double beta, size_t n);
+
+	/// y += alpha * x + beta * z
+	void vaxpbz(cd *y, const cd *x, cd alpha, const cd *z, cd beta, size_t n);
+	void vaxpbz(double *y, const double *x, double alpha, const double *z, double beta, size_t n);
+
+	/// y = alpha * x + beta * z, y may alias x or z
+	void vlincomb(cd *y, const cd *x, cd alpha, const cd *z, cd beta, size_t n);
+	void vlincomb(double *y, const double *x, double alpha, const double *z, double beta, size_t n);
+
+	/// sum_i conj(x(i)) * y(i)
+	cd vdot(const cd *x, const cd *y, size_t n);
+	double vdot(const double *x, const double *y, size_t n);
+
+	/// sqrt(sum_i |x(i)|^2)
+	double vnrm2(const cd *x, size_t n);
+	double vnrm2(const double *x, size_t n);
+
+	/// Name of the instruction set the kernels dispatch to on this CPU
+	string activeISA();
+}
+
+#endif //LAKERNELS_H
@@ -2,6 +2,7 @@
 #include "stdafx.h"
 #include <Eigen/Dense>
 #include "Vector.h"
+#include "Allocator.h"
 
 
 template<typename T>
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Matrix.h"
+#include "LAKernels.h"
 
 //////////////////////////////////////////////////////////////////////
 // Constructors
@@ -12,7 +13,7 @@ Matrix<T>::Matrix()
 template<typename T>
 Matrix<T>::Matrix(size_t dim1, size_t dim2)
 	:dim1_(dim1), dim2_(dim2),
-	 coeffs_(new T[dim1 * dim2]) {
+	 coeffs_(Memory::allocate<T>(dim1 * dim2)) {
 	assert(dim1 > 0);
 	assert(dim2 > 0);
 	Zero();
@@ -49,7 +50,16 @@ Matrix<T>::Matrix(Matrix&& old) noexcept
 // Copy Assignment Operator
 template<typename T>
 Matrix<T>& Matrix<T>::operator=(const Matrix& other) {
-	//@TODO: copy dims??
+	if (this == &other) { return *this; }
+	/// Reuse the storage if the sizes match
+	if (coeffs_ != nullptr && dim1_ * dim2_ == other.dim1_ * other.dim2_) {
+		dim1_ = other.dim1_;
+		dim2_ = other.dim2_;
+		for (size_t i = 0; i < dim1_ * dim2_; i++) {
+			coeffs_[i] = other.coeffs_[i];
+		}
+		return *this;
+	}
 	Matrix tmp(other);
 	*this = move(tmp);
 	return *this;
@@ -61,7 +71,7 @@ Matrix<T>& Matrix<T>::operator=(Matrix&& other) noexcept {
 	//@TODO: copy dims??// seems to be done, but maybe check again
 	dim1_ = other.dim1_;
 	dim2_ = other.dim2_;
-	delete[] coeffs_;
+	Memory::deallocate(coeffs_);
 	coeffs_ = other.coeffs_;
 	other.coeffs_ = nullptr;
 	return *this;
@@ -69,7 +79,7 @@ Matrix<T>& Matrix<T>::operator=(Matrix&& other) noexcept {
 
 template<typename T>
 Matrix<T>::~Matrix() {
-	delete[] coeffs_;
+	Memory::deallocate(coeffs_);
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -415,15 +425,6 @@ Vector<T> multATB(const Matrix<U>& A, const Vector<T>& B) {
 	return C;
 }
 
-extern "C" {
-// subroutine matvec (mulpsi, psi, matrix, a, b, c, add)
-// subroutine rhomat (bra,ket,matrix,a,b,c)
-void tmatvec_(double *C, double *B, double *mat,
-	int *a, int *b, int *c, int *add);
-void trmatvec_(double *C, double *B, double *mat,
-	int *a, int *b, int *c, int *add);
-}
-
 template<typename T>
 Matrix<T> multAB(const Matrix<T>& A, const Matrix<T>& B) {
 	assert(A.Dim2() == B.Dim1());
@@ -434,30 +435,16 @@ Matrix<T> multAB(const Matrix<T>& A, const Matrix<T>& B) {
 //  mulpsi(i,j,k) = psi(i,l,k) * matrix(l,j)
 //        C(i, j) =   A(i,l,1) *      B(l,j);
 //		               (b,a,c) ->(A.Dim1(), A.Dim2(), 1)
-	int b = A.Dim1();
-	int a = A.Dim2();
-	int c = 1;
-	int add = false;
-
-	if (is_same<T, cd>::value && (B.Dim1() == B.Dim2())) {
-		tmatvec_((double *) &C[0], (double *) &A[0], (double *) &B[0],
-			&a, &b, &c, &add);
-	} else if (is_same<T, d>::value && (B.Dim1() == B.Dim2())) {
-		trmatvec_((double *) &C[0], (double *) &A[0], (double *) &B[0],
-			&a, &b, &c, &add);
-	} else {
-		auto Ae = Eigen::Map<Eigen::Matrix<T,Eigen::Dynamic, Eigen::Dynamic>>((T*) A.Coeffs(), A.Dim1(), A.Dim2());
-		auto Be = Eigen::Map<Eigen::Matrix<T,Eigen::Dynamic, Eigen::Dynamic>>((T*) B.Coeffs(), B.Dim1(), B.Dim2());
-		auto Ce = Eigen::Map<Eigen::Matrix<T,Eigen::Dynamic, Eigen::Dynamic>>((T*) C.Coeffs(), C.Dim1(), C.Dim2());
-		Ce = Ae * Be;
-/*		for (size_t j = 0; j < B.Dim2(); j++) {
-			for (size_t i = 0; i < A.Dim1(); i++) {
-				for (size_t k = 0; k < A.Dim2(); k++) {
-					C(i, j) += A(i, k) * B(k, j);
-				}
-			}
-		}*/
+	if constexpr(is_same<T, cd>::value || is_same<T, d>::value) {
+		if (B.Dim1() == B.Dim2()) {
+			LAKernels::tmatvec(&C[0], &A[0], &B[0], B.Dim2(), B.Dim1(), A.Dim1(), 1, false);
+			return C;
+		}
 	}
+	auto Ae = Eigen::Map<Eigen::Matrix<T,Eigen::Dynamic, Eigen::Dynamic>>((T*) A.Coeffs(), A.Dim1(), A.Dim2());
+	auto Be = Eigen::Map<Eigen::Matrix<T,Eigen::Dynamic, Eigen::Dynamic>>((T*) B.Coeffs(), B.Dim1(), B.Dim2());
+	auto Ce = Eigen::Map<Eigen::Matrix<T,Eigen::Dynamic, Eigen::Dynamic>>((T*) C.Coeffs(), C.Dim1(), C.Dim2());
+	Ce = Ae * Be;
 	return C;
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 #include "TensorShape.h"
 #include "Core/Matrix.h"
+#include "Core/Allocator.h"
 
 /**
  * \defgroup Core
@@ -34,14 +35,17 @@ public:
 	//////////////////////////////////////////////////////////
 
 	// Standard Constructor
-	Tensor() : coeffs_(new T[1]) {}
+	Tensor() : coeffs_(Memory::allocate<T>(1)), ownership_(true) {}
 
 	Tensor(const initializer_list<size_t>& dim, bool InitZero = true);
 
 	// Constructor with TensorDim
 	explicit Tensor(const TensorShape& dim, bool InitZero = true);
 
-	// Construct from external memory
+	// Construct from external memory. With ownership, ptr has to come from new T[]; the
+	// coefficients are moved to allocator memory and ptr is deleted.
+	// Without ownership, the Tensor is a view: assigning a Tensor of the same shape
+	// copies into the external memory instead of replacing it.
 	explicit Tensor(const TensorShape& dim, T* ptr, bool ownership = true, bool InitZero = true);
 
 	explicit Tensor(istream& is);
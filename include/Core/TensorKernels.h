@@ -0,0 +1,248 @@
+#ifndef TENSORKERNELS_H
+#define TENSORKERNELS_H
+#include "stdafx.h"
+#include <Eigen/Dense>
+#ifdef QUTREE_USE_CBLAS
+#include <cblas.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * \brief Low level GEMM kernels that back the mode-products of the Tensor class.
+ *
+ * Every mode-k product C(i, j, k) = sum_l op(A)(j, l) * B(i, l, k) is mapped onto
+ * column-major GEMM calls. If before == 1 the whole product is a single GEMM,
+ * otherwise one GEMM per "after"-slice is performed. The GEMM itself is executed
+ * by Eigen or, if QuTree is configured with USE_CBLAS, by the system CBLAS.
+ */
+namespace TensorKernels {
+
+	/// Operation applied to a GEMM operand
+	enum class Op {
+		N, ///< A
+		T, ///< A^T
+		C, ///< A^H
+		R, ///< conj(A)
+	};
+
+	namespace detail {
+		template<typename T>
+		using EigenMatrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+
+		template<typename T>
+		using ConstMap = Eigen::Map<const EigenMatrix<T>, 0, Eigen::OuterStride<>>;
+
+		template<typename T>
+		using Map = Eigen::Map<EigenMatrix<T>, 0, Eigen::OuterStride<>>;
+
+		/// Call f with op(A) as an Eigen expression
+		template<class M, class F>
+		void withOp(Op op, const M& A, F f) {
+			switch (op) {
+				case Op::N: f(A);
+					break;
+				case Op::T: f(A.transpose());
+					break;
+				case Op::C: f(A.adjoint());
+					break;
+				case Op::R: f(A.conjugate());
+					break;
+			}
+		}
+
+		template<typename T>
+		void gemmEigen(Op opA, Op opB, size_t m, size_t n, size_t k, T alpha,
+			const T *A, size_t lda, const T *B, size_t ldb, T beta, T *C, size_t ldc) {
+			bool transA = (opA == Op::T || opA == Op::C);
+			bool transB = (opB == Op::T || opB == Op::C);
+			ConstMap<T> Am(A, transA ? k : m, transA ? m : k, Eigen::OuterStride<>(lda));
+			ConstMap<T> Bm(B, transB ? n : k, transB ? k : n, Eigen::OuterStride<>(ldb));
+			Map<T> Cm(C, m, n, Eigen::OuterStride<>(ldc));
+			withOp(opA, Am, [&](const auto& a) {
+				withOp(opB, Bm, [&](const auto& b) {
+					if (beta == T(0.)) {
+						Cm.noalias() = alpha * (a * b);
+					} else {
+						if (beta != T(1.)) { Cm *= beta; }
+						Cm.noalias() += alpha * (a * b);
+					}
+				});
+			});
+		}
+
+#ifdef QUTREE_USE_CBLAS
+		inline CBLAS_TRANSPOSE cblasOp(Op op) {
+			switch (op) {
+				case Op::T: return CblasTrans;
+				case Op::C: return CblasConjTrans;
+				default: return CblasNoTrans;
+			}
+		}
+
+		inline void gemmBlas(Op opA, Op opB, size_t m, size_t n, size_t k, double alpha,
+			const double *A, size_t lda, const double *B, size_t ldb, double beta, double *C, size_t ldc) {
+			cblas_dgemm(CblasColMajor, cblasOp(opA), cblasOp(opB), m, n, k,
+				alpha, A, lda, B, ldb, beta, C, ldc);
+		}
+
+		inline void gemmBlas(Op opA, Op opB, size_t m, size_t n, size_t k, complex<double> alpha,
+			const complex<double> *A, size_t lda, const complex<double> *B, size_t ldb,
+			complex<double> beta, complex<double> *C, size_t ldc) {
+			/// CBLAS has no conjugate-without-transpose; conjugate a copy of the operand.
+			vector<complex<double>> Aconj, Bconj;
+			if (opA == Op::R) {
+				Aconj.resize(lda * k);
+				for (size_t i = 0; i < Aconj.size(); ++i) { Aconj[i] = conj(A[i]); }
+				A = Aconj.data();
+			}
+			if (opB == Op::R) {
+				Bconj.resize(ldb * n);
+				for (size_t i = 0; i < Bconj.size(); ++i) { Bconj[i] = conj(B[i]); }
+				B = Bconj.data();
+			}
+			cblas_zgemm(CblasColMajor, cblasOp(opA), cblasOp(opB), m, n, k,
+				&alpha, A, lda, B, ldb, &beta, C, ldc);
+		}
+#endif
+	}
+
+	/**
+	 * \brief Decide whether a product with a (dim1, dim2) matrix should run on GEMM.
+	 *
+	 * Small matrices are faster on the loop kernels in LAKernels.h. Eigen compiled
+	 * without AVX is slower than the (runtime-dispatched) loop kernels for all
+	 * sizes that are typical for tensor trees, so GEMM is only used for very large
+	 * matrices in that case. Configure with QuTree_NATIVE_ARCH or USE_CBLAS.
+	 */
+	inline bool useGEMM(size_t dim1, size_t dim2) {
+#if defined(QUTREE_USE_CBLAS) || defined(EIGEN_VECTORIZE_AVX)
+		constexpr size_t minSize = 64;
+#else
+		constexpr size_t minSize = 1 << 16;
+#endif
+		return (dim1 * dim2 >= minSize);
+	}
+
+	/**
+	 * \brief Column-major GEMM: C(m, n) = alpha * op(A)(m, k) * op(B)(k, n) + beta * C
+	 *
+	 * If beta == 0, C is not read and may be uninitialized.
+	 */
+	template<typename T>
+	void gemm(Op opA, Op opB, size_t m, size_t n, size_t k, T alpha,
+		const T *A, size_t lda, const T *B, size_t ldb, T beta, T *C, size_t ldc) {
+		if (m == 0 || n == 0) { return; }
+#ifdef QUTREE_USE_CBLAS
+		if constexpr(is_same<T, double>::value || is_same<T, complex<double>>::value) {
+			detail::gemmBlas(opA, opB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+			return;
+		}
+#endif
+		detail::gemmEigen(opA, opB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+	}
+
+	/**
+	 * \brief Mode-product C(i, j, k) (+)= sum_l op(A)(j, l) * B(i, l, k)
+	 *
+	 * A is stored column-major with shape (activeC, activeB) for op = N and
+	 * (activeB, activeC) for op = T, C. Tensors are addressed by the superindex
+	 * (before, active, after).
+	 */
+	template<typename T>
+	void matrixTensor(T *C, const T *A, const T *B, Op op,
+		size_t before, size_t activeC, size_t activeB, size_t after, bool zero) {
+		assert(op != Op::R);
+		T beta = zero ? T(0.) : T(1.);
+		size_t lda = (op == Op::N) ? activeC : activeB;
+		if (before == 1) {
+			/// C(j, k) = op(A)(j, l) * B(l, k)
+			gemm(op, Op::N, activeC, after, activeB, T(1.), A, lda,
+				B, activeB, beta, C, activeC);
+		} else {
+			/// C_k(i, j) = B_k(i, l) * op(A)^T(l, j)
+			Op opT = Op::T;
+			if (op == Op::T) { opT = Op::N; }
+			else if (op == Op::C) { opT = Op::R; }
+			size_t strideB = before * activeB;
+			size_t strideC = before * activeC;
+#pragma omp parallel for if(after > 1)
+			for (size_t k = 0; k < after; ++k) {
+				gemm(Op::N, opT, before, activeC, activeB, T(1.), B + k * strideB, before,
+					A, lda, beta, C + k * strideC, before);
+			}
+		}
+	}
+
+	/**
+	 * \brief Contraction over all but one index: S(i, j) (+)= sum_{l, n} conj(A(l, i, n)) * B(l, j, n)
+	 *
+	 * For before == 1 this is one GEMM, otherwise a GEMM per "behind"-slice that
+	 * is reduced into S. Large reductions are split over OpenMP threads with one
+	 * partial result per thread, summed in a fixed order so results do not depend
+	 * on scheduling. The thread count is only set for this parallel region and
+	 * never changed globally.
+	 */
+	template<typename T>
+	void contraction(T *S, const T *A, const T *B,
+		size_t before, size_t active1, size_t active2, size_t behind, bool zero) {
+		T beta = zero ? T(0.) : T(1.);
+		if (before == 1) {
+			/// S(i, j) = conj(A(i, n)) * B(j, n)
+			gemm(Op::R, Op::T, active1, active2, behind, T(1.), A, active1,
+				B, active2, beta, S, active1);
+			return;
+		}
+
+		size_t strideA = before * active1;
+		size_t strideB = before * active2;
+		size_t nthreads = 1;
+#ifdef _OPENMP
+		/// Only split if every thread gets a few GEMMs worth of work
+		constexpr size_t effort = 1 << 15;
+		size_t work = before * active1 * active2 * behind;
+		if (!omp_in_parallel() && behind > 1 && work >= effort) {
+			nthreads = min((size_t) omp_get_max_threads(), behind);
+		}
+#endif
+		if (nthreads == 1) {
+			for (size_t n = 0; n < behind; ++n) {
+				gemm(Op::C, Op::N, active1, active2, before, T(1.), A + n * strideA, before,
+					B + n * strideB, before, (n == 0) ? beta : T(1.), S, active1);
+			}
+			return;
+		}
+
+		/// Thread-private partial sums
+		size_t dimS = active1 * active2;
+		vector<T> partial(nthreads * dimS);
+#pragma omp parallel num_threads(nthreads)
+		{
+#ifdef _OPENMP
+			size_t t = omp_get_thread_num();
+			size_t team = omp_get_num_threads();
+#else
+			size_t t = 0;
+			size_t team = 1;
+#endif
+			size_t chunk = (behind + team - 1) / team;
+			size_t first = min(t * chunk, behind);
+			size_t last = min(first + chunk, behind);
+			T *St = &partial[t * dimS];
+			for (size_t n = first; n < last; ++n) {
+				gemm(Op::C, Op::N, active1, active2, before, T(1.), A + n * strideA, before,
+					B + n * strideB, before, (n == first) ? T(0.) : T(1.), St, active1);
+			}
+		}
+		for (size_t i = 0; i < dimS; ++i) {
+			T sum = zero ? T(0.) : S[i];
+			for (size_t t = 0; t < nthreads; ++t) {
+				sum += partial[t * dimS + i];
+			}
+			S[i] = sum;
+		}
+	}
+}
+
+#endif //TENSORKERNELS_H
@@ -8,6 +8,9 @@ namespace Tensor_Extension {
 
 	tuple<Matrixcd, Matrixcd, Vectord> SVD(const Matrixcd& A);
 
+	/// Number of singular values above rtol * sigma(0), at least 1 (sigma sorted descending)
+	size_t NumericalRank(const Vectord& sigma, double rtol = 1e-12);
+
 	template<typename T>
 	Matrix<T> Map(const Tensor<T>& A);
 
@@ -74,6 +74,14 @@ namespace Tensor_Extension {
 		return tuple<Matrixcd, Matrixcd, Vectord>(U, V, sigma);
 	}
 
+	size_t NumericalRank(const Vectord& sigma, double rtol) {
+		size_t r = 0;
+		for (size_t i = 0; i < sigma.Dim(); ++i) {
+			if (sigma(i) > rtol * sigma(0)) { r++; }
+		}
+		return max(r, (size_t) 1);
+	}
+
 	template<typename T>
 	Matrix<T> Map(const Tensor<T>& A) {
 		const TensorShape& tdim = A.shape();
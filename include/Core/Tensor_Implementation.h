@@ -2,8 +2,13 @@
 #include "Tensor.h"
 #include "TensorShape.h"
 #include "stdafx.h"
+#include "TensorKernels.h"
+#include "LAKernels.h"
 //#include <omp.h> //TODO: have this here by default?
 
+/// OpenMP has no built-in reductions for complex numbers
+#pragma omp declare reduction(+ : complex<double> : omp_out += omp_in) initializer(omp_priv = complex<double>(0., 0.))
+
 template<typename T>
 Tensor<T>::Tensor(const initializer_list<size_t>& dims, bool InitZero)
 	:Tensor(TensorShape(dims), InitZero) {}
@@ -11,12 +16,18 @@ Tensor<T>::Tensor(const initializer_list<size_t>& dims, bool InitZero)
 template<typename T>
 Tensor<T>::Tensor(const TensorShape& dim, T *ptr, bool ownership, bool InitZero)
 	:shape_(dim), coeffs_(ptr), ownership_(ownership) {
+	if (ownership_) {
+		/// Adopted memory comes from new[], the destructor frees allocator blocks
+		coeffs_ = Memory::allocate<T>(dim.totalDimension());
+		if (!InitZero) { copy(ptr, ptr + dim.totalDimension(), coeffs_); }
+		delete[] ptr;
+	}
 	if (InitZero) { Zero(); }
 }
 
 template<typename T>
 Tensor<T>::Tensor(const TensorShape& dim, const bool InitZero)
-	:shape_(dim), coeffs_(new T[dim.totalDimension()]), ownership_(true) {
+	:shape_(dim), coeffs_(Memory::allocate<T>(dim.totalDimension())), ownership_(true) {
 	if (InitZero) { Zero(); }
 }
 
@@ -62,6 +73,13 @@ Tensor<T>::Tensor(Tensor&& old) noexcept
 // Copy Assignment Operator
 template<typename T>
 Tensor<T>& Tensor<T>::operator=(const Tensor& old) {
+	/// Views write into their memory if the shape matches
+	if (!ownership_ && coeffs_ != nullptr && shape_ == old.shape_) {
+		if (coeffs_ != old.coeffs_) {
+			copy(old.coeffs_, old.coeffs_ + shape_.totalDimension(), coeffs_);
+		}
+		return *this;
+	}
 	Tensor tmp(old);
 	*this = move(tmp);
 	return *this;
@@ -70,7 +88,13 @@ Tensor<T>& Tensor<T>::operator=(const Tensor& old) {
 // Move Assignment Operator
 template<typename T>
 Tensor<T>& Tensor<T>::operator=(Tensor&& old) noexcept {
-	delete[] coeffs_;
+	if (!ownership_ && coeffs_ != nullptr && shape_ == old.shape_) {
+		if (coeffs_ != old.coeffs_) {
+			copy(old.coeffs_, old.coeffs_ + shape_.totalDimension(), coeffs_);
+		}
+		return *this;
+	}
+	if (ownership_) { Memory::deallocate(coeffs_); }
 	shape_ = old.shape_;
 	coeffs_ = old.coeffs_;
 	ownership_ = old.ownership_;
@@ -81,7 +105,7 @@ Tensor<T>& Tensor<T>::operator=(Tensor&& old) noexcept {
 
 template<typename T>
 Tensor<T>::~Tensor() {
-	if (ownership_) { delete[] coeffs_; }
+	if (ownership_) { Memory::deallocate(coeffs_); }
 }
 
 //////////////////////////////////////////////////////////
@@ -234,11 +258,8 @@ void Tensor<T>::Write(ostream& os) const {
 	int32_t size = sizeof(T);
 	os.write((char *) &size, sizeof(size));
 
-	// Write the Coefficients
-	for (size_t i = 0; i < shape_.totalDimension(); i++) {
-		T Coeff_now = operator()(i);
-		os.write((char *) &Coeff_now, size);
-	}
+	// Write the Coefficients in one block
+	os.write((const char *) coeffs_, shape_.totalDimension() * sizeof(T));
 	os.flush();
 }
 
@@ -269,13 +290,8 @@ void Tensor<T>::Read(istream& is) {
 	is.read((char *) &size, sizeof(size));
 	assert(size == sizeof(T));
 
-	// Read the coefficients
-
-	for (size_t i = 0; i < shape_.totalDimension(); i++) {
-		T Coeff_now;
-		is.read((char *) &Coeff_now, size);
-		operator()(i) = Coeff_now;
-	}
+	// Read the coefficients in one block
+	is.read((char *) coeffs_, shape_.totalDimension() * sizeof(T));
 }
 
 template<typename T>
@@ -291,26 +307,20 @@ void Tensor<T>::Read(const string& filename) {
 template<typename T>
 Tensor<T>& Tensor<T>::operator+=(const Tensor& A) {
 	assert(A.shape().totalDimension() == shape().totalDimension());
-	for (size_t i = 0; i < A.shape().totalDimension(); i++) {
-		(*this)(i) += A(i);
-	}
+	LAKernels::vaxpy(coeffs_, A.coeffs_, (T) 1., shape().totalDimension());
 	return *this;
 }
 
 template<typename T>
 Tensor<T>& Tensor<T>::operator-=(const Tensor& A) {
 	assert(A.shape().totalDimension() == shape().totalDimension());
-	for (size_t i = 0; i < A.shape().totalDimension(); i++) {
-		(*this)(i) -= A(i);
-	}
+	LAKernels::vaxpy(coeffs_, A.coeffs_, (T) -1., shape().totalDimension());
 	return *this;
 }
 
 template<typename T>
 Tensor<T>& Tensor<T>::operator*=(T a) {
-	for (size_t i = 0; i < shape().totalDimension(); i++) {
-		operator()(i) = a * operator()(i);
-	}
+	LAKernels::vscal(coeffs_, a, shape().totalDimension());
 	return *this;
 }
 
@@ -481,72 +491,19 @@ T SingleDotProd(const Tensor<T>& A, const Tensor<T>& B, size_t n, size_t m) {
 	return result;
 }
 
-extern "C" {
-// subroutine matvec (mulpsi, psi, matrix, a, b, c, add)
-// subroutine rhomat (bra,ket,matrix,a,b,c)
-void matvec_(double* C, double* B, double* mat,
-	int* a, int* b, int* c, int* add);
-void rmatvec_(double* C, double* B, double* mat,
-	int* a, int* b, int* c, int* add);
-void rhomat_(double* Bra, double* Ket, double* M,
-	int* a, int* b, int* c);
-}
-
 template<typename T>
 void TensorContraction(Matrix<T>& S, const Tensor<T>& A, const Tensor<T>& B,
 	size_t before, size_t active1, size_t active2, size_t behind) {
-
-	int a = active1;
-	int b = before;
-	int c = behind;
-
-	rhomat_((double*) &A[0], (double*) &B[0], (double*) &S[0],
-		&a, &b, &c);
-
-	/*
-	// Variables for precalculation of indices
-	size_t actbef1 = active1 * before;
-	size_t actbef2 = active2 * before;
-	size_t Sidx = 0;
-	size_t Aidx = 0;
-	size_t Bidx = 0;
-	size_t ipreidx = 0;
-	size_t jpreidx = 0;
-	size_t npreidx1 = 0;
-	size_t npreidx2 = 0;
-	 */
-
-	// Avoid unnecessary thread launches
-	/*
-	const char* threads = getenv("OMP_NUM_THREADS");
-	if (threads) {
-	    if (after < atoi(threads)) {
-            omp_set_num_threads(after);
-	    }
-	}
-	*/
-	/*
-#pragma omp parallel for private(npreidx1, npreidx2, jpreidx, Sidx, ipreidx, Aidx, Bidx)
-	for (size_t n = 0; n < behind; n++) {
-		npreidx1 = n * actbef1;
-		npreidx2 = n * actbef2;
-		for (size_t j = 0; j < active2; j++) {
-			jpreidx = npreidx2 + j * before;
-			for (size_t i = 0; i < active1; i++) {
-				// S(i, j)
-				Sidx = j * active1 + i;
-				ipreidx = npreidx1 + i * before;
-				for (size_t l = 0; l < before; l++) {
-					// A(l, i, n)
-					Aidx = ipreidx + l;
-					// B(l, j, n)
-					Bidx = jpreidx + l;
-					S[Sidx] += conj(A[Aidx]) * B[Bidx];
-				}
-			}
+	/// S(i, j) += conj(A(l, i, n)) * B(l, j, n)
+	assert(S.Dim1() == active1);
+	assert(S.Dim2() == active2);
+	if constexpr(is_same<T, complex<double>>::value || is_same<T, double>::value) {
+		if (!TensorKernels::useGEMM(active1, active2)) {
+			LAKernels::rhomat(&S[0], &A[0], &B[0], active1, active2, before, behind, true);
+			return;
 		}
 	}
-	*/
+	TensorKernels::contraction(&S[0], &A[0], &B[0], before, active1, active2, behind, false);
 }
 
 template<typename T>
@@ -580,149 +537,65 @@ void Contraction(Matrix<T>& S, const Tensor<T>& A, const Tensor<T>& B, size_t k,
 }
 
 template<typename T, typename U>
-void MatrixTensor(Tensor<T>& C, const Matrix<U>& A, const Tensor<T>& B,
+void ModeProduct(Tensor<T>& C, const Matrix<U>& A, const Tensor<T>& B, TensorKernels::Op op,
 	size_t before, size_t activeC, size_t activeB, size_t after, bool zero) {
-	// Null the result tensor if flag is set to "true"
-	int add = !zero;
-	int a = activeB;
-	int b = before;
-	int c = after;
-	typedef complex<double> cd;
-	typedef double d;
-
-	if constexpr(is_same<U, cd>::value && is_same<T, cd>::value) {
-		matvec_((double*)&C[0], (double*)&B[0], (double*)&A[0],
-		&a, &b, &c, &add);
-	} else if constexpr(is_same<U, d>::value && is_same<T, d>::value) {
-		rmatvec_((double*)&C[0], (double*)&B[0], (double*)&A[0],
-			&a, &b, &c, &add);
-	} else {
-		if (zero) { C.Zero(); }
-
-		// Variables to Precompute index values
-		size_t actbefB = activeB * before;
-		size_t actbefC = activeC * before;
-		size_t Aidx = 0;
-		size_t Bidx = 0;
-		size_t Cidx = 0;
-		size_t kpreidxB = 0;
-		size_t kpreidxC = 0;
-		size_t lpreidx = 0;
-		size_t jpreidx = 0;
-		size_t lactive = 0;
-		// Avoid unnecessary thread launches
-		// TODO: this requires #inclue <omp.h>
-		/*
-		const char* threads = getenv("OMP_NUM_THREADS");
-		if (threads) {
-			if (after < atoi(threads)) {
-				omp_set_num_threads(after);
+	assert(C.shape().totalDimension() >= before * activeC * after);
+	assert(B.shape().totalDimension() >= before * activeB * after);
+	if constexpr(is_same<U, T>::value && (is_same<T, complex<double>>::value || is_same<T, double>::value)) {
+		if (op != TensorKernels::Op::C && !TensorKernels::useGEMM(activeC, activeB)) {
+			if (op == TensorKernels::Op::N) {
+				LAKernels::matvec(&C[0], &B[0], A.Coeffs(), activeC, activeB, before, after, !zero);
+			} else {
+				LAKernels::tmatvec(&C[0], &B[0], A.Coeffs(), activeC, activeB, before, after, !zero);
 			}
+			return;
 		}
-		 */
-		if (before == 1) {
-#pragma omp parallel for private(kpreidxB, kpreidxC, Bidx, Cidx, Aidx)
-			for (size_t k = 0; k < after; ++k) {
-				kpreidxB = k * actbefB;
-				kpreidxC = k * actbefC;
-				for (size_t l = 0; l < activeB; ++l) {
-					Bidx = l + kpreidxB;
-					for (size_t j = 0; j < activeC; ++j) {
-						Cidx = j + kpreidxC;
-						Aidx = l * activeB + j; //TODO: why is this declared twice?
-						Aidx = l * activeC + j;
-//					assert(Cidx < C.shape().totalDimension());
-//					assert(Bidx < B.shape().totalDimension());
-//					assert(Aidx < A.Dim1()*A.Dim2());
-						/// C(1, j, k) += A(j, l) * B(1, l, k)
-						C[Cidx] += A[Aidx] * B[Bidx];
-					}
-				}
-			}
-		} else {
-#pragma omp parallel for private(Aidx, Bidx, Cidx, kpreidxB, kpreidxC, lpreidx, lactive, jpreidx)
-			for (size_t k = 0; k < after; ++k) {
-				kpreidxB = k * actbefB;
-				kpreidxC = k * actbefC;
-				for (size_t l = 0; l < activeB; ++l) {
-					lpreidx = l * before + kpreidxB;
-					lactive = l * activeC;
-					for (size_t j = 0; j < activeC; ++j) {
-						Aidx = lactive + j;
-						jpreidx = j * before + kpreidxC;
-						for (size_t i = 0; i < before; ++i) {
-							Cidx = jpreidx + i;
-							Bidx = lpreidx + i;
-//						assert(Cidx < C.shape().totalDimension());
-//						assert(Bidx < B.shape().totalDimension());
-//						assert(Aidx < A.Dim1()*A.Dim2());
-							/// C(i, j, k) += A(j, l) * B(i, l, k)
-							C[Cidx] += A[Aidx] * B[Bidx];
-						}
-					}
-				}
+		if (op == TensorKernels::Op::C && activeC == activeB && LAKernels::hasFixedKernel(activeC)) {
+			/// conj(A)^T on the fixed-size kernel instead of a tiny GEMM
+			if constexpr(is_same<T, double>::value) {
+				LAKernels::tmatvec(&C[0], &B[0], A.Coeffs(), activeC, activeB, before, after, !zero);
+			} else {
+				T Aconj[LAKernels::maxFixedDim * LAKernels::maxFixedDim];
+				for (size_t i = 0; i < activeC * activeB; ++i) { Aconj[i] = conj(A[i]); }
+				LAKernels::tmatvec(&C[0], &B[0], Aconj, activeC, activeB, before, after, !zero);
 			}
+			return;
 		}
 	}
+	if constexpr(is_same<U, T>::value) {
+		TensorKernels::matrixTensor(&C[0], A.Coeffs(), &B[0], op,
+			before, activeC, activeB, after, zero);
+	} else {
+		/// Promote A to the scalar type of the tensors, e.g. real matrices on complex tensors
+		vector<T> Acast(A.Dim1() * A.Dim2());
+		for (size_t i = 0; i < Acast.size(); ++i) { Acast[i] = A[i]; }
+		TensorKernels::matrixTensor(&C[0], Acast.data(), &B[0], op,
+			before, activeC, activeB, after, zero);
+	}
+}
+
+template<typename T, typename U>
+void MatrixTensor(Tensor<T>& C, const Matrix<U>& A, const Tensor<T>& B,
+	size_t before, size_t activeC, size_t activeB, size_t after, bool zero) {
+	/// C(i, j, k) (+)= A(j, l) * B(i, l, k)
+	assert(A.Dim1() == activeC);
+	assert(A.Dim2() == activeB);
+	ModeProduct(C, A, B, TensorKernels::Op::N, before, activeC, activeB, after, zero);
 }
 
 template<typename T, typename U>
 void TMatrixTensor(Tensor<T>& C, const Matrix<U>& A, const Tensor<T>& B,
 	size_t before, size_t activeC, size_t activeB, size_t after, bool zero) {
-	// Null the result tensor if flag is set to "true"
-	if (zero) { C.Zero(); }
-
-	size_t actbefB = activeB * before;
-	size_t actbefC = activeC * before;
-	size_t Cidx = 0;
-	size_t Bidx = 0;
-	size_t Aidx = 0;
-	size_t kpreidxB = 0;
-	size_t kpreidxC = 0;
-	size_t Bpreidx = 0;
-	size_t Cpreidx = 0;
-
-	if (before == 1) {
-//#pragma omp parallel for
-		for (size_t k = 0; k < after; ++k) {
-			kpreidxB = k * actbefB;
-			kpreidxC = k * actbefC;
-			for (size_t l = 0; l < activeB; ++l) {
-				Bidx = l + kpreidxB;
-				for (size_t j = 0; j < activeC; ++j) {
-					Cidx = j + kpreidxC;
-					Aidx = j * activeB + l;
-					C[Cidx] += conj(A[Aidx]) * B[Bidx];
-//					C[Cidx] += conj(A[l, j]) * B[Bidx];
-				}
-			}
-		}
-	} else {
-//#pragma omp parallel for
-		for (size_t k = 0; k < after; ++k) {
-			kpreidxB = k * actbefB;
-			kpreidxC = k * actbefC;
-			for (size_t l = 0; l < activeB; ++l) {
-				Bpreidx = l * before + kpreidxB;
-				for (size_t j = 0; j < activeC; ++j) {
-					Aidx = j * activeB + l;
-					Cpreidx = j * before + kpreidxC;
-					for (size_t i = 0; i < before; ++i) {
-						Cidx = Cpreidx + i;
-						Bidx = Bpreidx + i;
-						C[Cidx] += conj(A[Aidx]) * B[Bidx];
-//						C[Cidx] += conj(A[l, j]) * B[Bidx];
-					}
-				}
-			}
-		}
-	}
+	/// C(i, j, k) (+)= conj(A(l, j)) * B(i, l, k)
+	assert(A.Dim1() == activeB);
+	assert(A.Dim2() == activeC);
+	ModeProduct(C, A, B, TensorKernels::Op::C, before, activeC, activeB, after, zero);
 }
 
 template<typename T, typename U>
 void MatrixTensor(Tensor<T>& C, const Matrix<U>& A, const Tensor<T>& B, size_t mode, bool zero) {
-	TensorShape tdim(B.shape());
-	TensorShape tdimC(C.shape());
+	const TensorShape& tdim(B.shape());
+	const TensorShape& tdimC(C.shape());
 
 	size_t after = tdim.after(mode);
 	size_t before = tdim.before(mode);
@@ -738,69 +611,52 @@ void MatrixTensor(Tensor<T>& C, const Matrix<U>& A, const Tensor<T>& B, size_t m
 
 template<typename T, typename U>
 Tensor<T> MatrixTensor(const Matrix<U>& A, const Tensor<T>& B, size_t mode) {
-	const TensorShape& tdim(B.shape());
-	assert(mode < tdim.order());
+	const TensorShape& tdimB(B.shape());
+	assert(mode < tdimB.order());
+	assert(A.Dim2() == tdimB[mode]);
 
-	if (A.Dim1() == A.Dim2()) {
-		Tensor<T> C(tdim);
-		size_t after = tdim.after(mode);
-		size_t active = tdim[mode];
-		size_t before = tdim.before(mode);
-		MatrixTensor(C, A, B, before, active, active, after, false);
-		return C;
-	} else {
-		TensorShape tdim(B.shape());
-		size_t active1 = A.Dim1();
-		size_t active2 = A.Dim2();
-		tdim = replaceDimension(tdim, mode, active1);
-		Tensor<T> C(tdim);
-		size_t after = tdim.after(mode);
-		size_t before = tdim.before(mode);
-		assert(active1 == C.shape()[mode]);
-		assert(active2 == B.shape()[mode]);
-		cout << "non-quadratic mattensor implemented but tested only once so far.\n";
-		MatrixTensor(C, A, B, before, active1, active2, after, false);
-		return C;
-	}
+	TensorShape tdim = replaceDimension(tdimB, mode, A.Dim1());
+	Tensor<T> C(tdim, false);
+	size_t after = tdim.after(mode);
+	size_t before = tdim.before(mode);
+	MatrixTensor(C, A, B, before, A.Dim1(), A.Dim2(), after, true);
+	return C;
 }
 
 template<typename T, typename U>
 void TensorMatrix(Tensor<T>& C, const Tensor<T>& B, const Matrix<U>& A, size_t mode, bool zero) {
-	TensorMatrix(C, B, A.Transpose(), mode, zero);
+	/// C(i, j, k) (+)= B(i, l, k) * A(l, j)
+	const TensorShape& tdimB(B.shape());
+	const TensorShape& tdimC(C.shape());
+	assert(mode < tdimB.order());
+	assert(A.Dim1() == tdimB[mode]);
+	assert(A.Dim2() == tdimC[mode]);
+
+	size_t after = tdimB.after(mode);
+	size_t before = tdimB.before(mode);
+	ModeProduct(C, A, B, TensorKernels::Op::T, before, A.Dim2(), A.Dim1(), after, zero);
 }
 
 template<typename T, typename U>
 Tensor<T> TensorMatrix(const Tensor<T>& B, const Matrix<U>& A, size_t mode) {
-	return MatrixTensor(A.Transpose(), B, mode);
+	TensorShape tdim = replaceDimension(B.shape(), mode, A.Dim2());
+	Tensor<T> C(tdim, false);
+	TensorMatrix(C, B, A, mode, true);
+	return C;
 }
 
 template<typename T, typename U>
 Tensor<T> multATB(const Matrix<U>& A, const Tensor<T>& B, size_t mode) {
-	const TensorShape& tdim(B.shape());
-	assert(mode < tdim.order());
-	assert(mode >= 0);
-	assert(A.Dim1() == B.shape()[mode]);
-
-	if (A.Dim1() == A.Dim2()) {
-		Tensor<T> C(tdim);
-		size_t after = tdim.after(mode);
-		size_t active = tdim[mode];
-		size_t before = tdim.before(mode);
-		TMatrixTensor(C, A, B, before, active, active, after, false);
-		return C;
-	} else {
-		size_t activeC = A.Dim2();
-		size_t activeB = A.Dim1();
-		TensorShape tdim(B.shape());
-		tdim = replaceDimension(tdim, mode, A.Dim2());
-		size_t after = tdim.after(mode);
-		size_t before = tdim.before(mode);
-		Tensor<T> C(tdim);
-		cout << "non-quadratic mattensor implemented but not tested, yet.\n";
-		TMatrixTensor(C, A, B, before, activeC, activeB, after, false);
-		getchar();
-		return C;
-	}
+	const TensorShape& tdimB(B.shape());
+	assert(mode < tdimB.order());
+	assert(A.Dim1() == tdimB[mode]);
+
+	TensorShape tdim = replaceDimension(tdimB, mode, A.Dim2());
+	Tensor<T> C(tdim, false);
+	size_t after = tdim.after(mode);
+	size_t before = tdim.before(mode);
+	TMatrixTensor(C, A, B, before, A.Dim2(), A.Dim1(), after, true);
+	return C;
 }
 
 template<typename T, typename U>
@@ -817,7 +673,7 @@ void multStateAB(Tensor<T>& C, const Matrix<U>& A, const Tensor<T>& B, bool zero
 	assert(A.Dim1() == active2);
 	assert(before == tdimC.lastBefore());
 
-	MatrixTensor(C, A, B, before, active1, active2, after, zero);
+	MatrixTensor(C, A, B, before, active2, active1, after, zero);
 }
 
 template<typename T, typename U>
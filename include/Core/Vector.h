@@ -1,6 +1,7 @@
 #pragma once
 #include "stdafx.h"
 #include "Eigen/Dense"
+#include "Allocator.h"
 
 template<typename T>
 class Vector {
@@ -90,6 +91,8 @@ public:
 	// Setter & Getter
 	inline size_t Dim() const { return dim_; }
 
+	T *Coeffs() const { return coeffs_; }
+
 protected:
 	T *coeffs_;
 	size_t dim_;
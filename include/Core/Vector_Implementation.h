@@ -8,7 +8,7 @@
 // Constructor
 template<typename T>
 Vector<T>::Vector(size_t dim)
-	:dim_(dim), coeffs_(new T[dim]) {
+	:dim_(dim), coeffs_(Memory::allocate<T>(dim)) {
 	assert(dim > 0);
 	Zero();
 }
@@ -51,7 +51,7 @@ Vector<T>& Vector<T>::operator=(const Vector<T>& other) {
 // Move Assignment Operator
 template<typename T>
 Vector<T>& Vector<T>::operator=(Vector<T>&& other) noexcept {
-	delete[] coeffs_;
+	Memory::deallocate(coeffs_);
 	coeffs_ = other.coeffs_;
 	other.coeffs_ = nullptr;
 	dim_ = other.dim_;
@@ -61,7 +61,7 @@ Vector<T>& Vector<T>::operator=(Vector<T>&& other) noexcept {
 // Destructos
 template<typename T>
 Vector<T>::~Vector() {
-	delete[] coeffs_;
+	Memory::deallocate(coeffs_);
 }
 
 //////////////////////////////////////////////////////////////////////
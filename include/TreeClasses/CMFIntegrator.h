@@ -0,0 +1,114 @@
+#ifndef CMFINTEGRATOR_H
+#define CMFINTEGRATOR_H
+#include "TreeClasses/SOPMatrixTrees.h"
+#include "TreeClasses/MatrixTree.h"
+#include "TreeClasses/TensorTree.h"
+#include "Util/BS_integrator.h"
+#include "Util/ShortIterativeLanczos.h"
+
+class CMFIntegrator
+/**
+ * \class CMFIntegrator
+ * \ingroup Tree
+ * \brief Constant-mean-field (CMF) integrator for the MCTDH equations of motion.
+ *
+ * The representation matrices of the Hamiltonian (SOPMatrixTrees), the density
+ * matrices and the mean fields (hole matrices) are built once per half macro
+ * step and kept constant while the tensors are propagated. With frozen mean
+ * fields, the tensors of different nodes decouple:
+ *  - top node:    i dA/dt = sum_l c_l h_l A, linear and hermitian, propagated
+ *                 with a ShortIterativeLanczos integrator,
+ *  - lower nodes: i dA/dt = (1 - P) rho^-1 sum_l c_l <h_l>_hole h_l A,
+ *                 propagated with one BS_integrator per node.
+ * Terms that do not act below a node only contribute a matrix on the last
+ * index there and are removed by the projector.
+ *
+ * A macro step tau uses the second-order CMF scheme: the mean fields at t are
+ * used to predict Psi(t + tau/2). The mean fields of the prediction propagate
+ * Psi(t) to t + tau (midpoint rule). Then the mean fields at t + tau propagate
+ * Psi(t + tau) back to t + tau/2. Both half steps carry the same O(tau^2) error
+ * of freezing the mean fields, so their difference is an O(tau^3) estimate
+ * that controls tau. The mean fields at t + tau are reused in the next step,
+ * i.e. two mean-field evaluations per accepted step. The lower-layer tensors
+ * are assumed to be orthonormal.
+ *
+ * Usage:
+ * CMFIntegrator cmf(H, tree, par);
+ * cmf.Integrate(Psi, t, t_end, dt);
+ * */
+{
+public:
+	struct Parameters {
+		double tolerance{1e-6};      ///< Maximum error per macro step
+		double innerTolerance{1e-9}; ///< Tolerance of the top-node and lower-layer integrators
+		double maxStep{1.};
+		double minStep{1e-8};
+		double eps_rho{1e-8};        ///< Regularization of the inverse density matrices
+	};
+
+	CMFIntegrator(const SOPcd& H, const Tree& tree, Parameters par);
+
+	~CMFIntegrator() = default;
+
+	/// The top-node integrator refers to this object
+	CMFIntegrator(const CMFIntegrator&) = delete;
+
+	CMFIntegrator& operator=(const CMFIntegrator&) = delete;
+
+	/**
+	 * \brief Build the mean fields and perform one accepted macro step, starting with step size dt.
+	 * @param Psi wavefunction, propagated in place
+	 * @param dt trial step size
+	 * @return step size that was taken (<= dt)
+	 */
+	double Step(TensorTreecd& Psi, double dt);
+
+	/// Propagate Psi from t to t_end. dt is the initial step size and returns the predicted next one.
+	void Integrate(TensorTreecd& Psi, double& t, double t_end, double& dt);
+
+	/// Build the SOP matrices, density matrices and mean fields for Psi
+	void MeanFields(const TensorTreecd& Psi);
+
+	/// dA/dt at "node" for the current mean fields
+	Tensorcd Derivative(const Tensorcd& Phi, const Node& node) const;
+
+	/// Step size predicted for the next macro step
+	double NextStep() const { return next_; }
+
+	/// Number of mean-field evaluations
+	size_t nMeanFields() const { return nMeanFields_; }
+
+	size_t nSteps() const { return nSteps_; }
+
+private:
+	typedef BS_integrator<const CMFIntegrator, Tensorcd, complex<double>> LayerIntegrator;
+
+	/// Macro step that starts from the current mean fields, which have to belong to Psi
+	double MacroStep(TensorTreecd& Psi, double dt);
+
+	/// Propagate all tensors by dt (dt < 0: backwards) with the current (frozen) mean fields
+	void Propagate(TensorTreecd& Psi, double dt);
+
+	/// H A at the top node
+	void ApplyTop(Tensorcd& HA, const Tensorcd& A) const;
+
+	const SOPcd& H_;
+	const Tree& tree_;
+	Parameters par_;
+
+	MatrixTreescd mats_;
+	MatrixTreecd rho_;
+	MatrixTreecd rhoinv_;
+
+	ShortIterativeLanczos<Tensorcd> top_;
+	vector<LayerIntegrator> layers_;
+	vector<double> dt_layers_; ///< Inner step sizes, kept across macro steps
+	double dt_top_;
+	double sign_{1.}; ///< -1 during backward propagation
+
+	double next_{0.};
+	size_t nMeanFields_{0};
+	size_t nSteps_{0};
+};
+
+#endif //CMFINTEGRATOR_H
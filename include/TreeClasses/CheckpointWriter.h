@@ -0,0 +1,96 @@
+#ifndef CHECKPOINTWRITER_H
+#define CHECKPOINTWRITER_H
+#include "TreeClasses/TensorTreeCheckpoint.h"
+#include "Util/Compression.h"
+#include <thread>
+#include <atomic>
+
+/**
+ * \brief Self-describing restart files: tree and wavefunction in one file.
+ *
+ * File layout (little-endian):
+ *  - 64-byte header: magic "QTREERST", version, scalar type, codec, number
+ *    of nodes and blocks, size of the tree text, offset of the tables,
+ *  - the tree as written by Tree::Write, followed by the leaf parameters,
+ *  - the coefficients of all nodes, cut into blocks of at most blockSize
+ *    bytes, every block compressed on its own (or stored, if it does not
+ *    shrink),
+ *  - the tables at the end of the file: shape and CRC-32 of every node,
+ *    raw size, stored size and codec of every block.
+ * Blocks are compressed in parallel (OpenMP) in batches and appended in
+ * order, so the memory overhead is a few blocks per thread.
+ */
+namespace Checkpoint {
+	struct RestartParameters {
+		Compression::Codec codec{Compression::Default()};
+		size_t blockSize{1 << 22}; ///< Bytes per compressed block
+	};
+
+	/// Write tree and Psi to filename; returns the file size in bytes
+	template<typename T>
+	size_t WriteRestart(const TensorTree<T>& Psi, const Tree& tree, const string& filename,
+		const RestartParameters& par = RestartParameters());
+
+	/// Read tree and Psi (contiguous) from a restart file and check the CRCs
+	template<typename T>
+	void ReadRestart(Tree& tree, TensorTree<T>& Psi, const string& filename);
+}
+
+template<typename T>
+class CheckpointWriter
+	/**
+	 * \class CheckpointWriter
+	 * \ingroup Tree
+	 * \brief Writes restart files in the background.
+	 *
+	 * Write() copies Psi and returns; compression and I/O run in a background
+	 * thread while the propagation continues. A new Write() (and the
+	 * destructor) first waits for the previous one. The file is written to
+	 * "filename.tmp" and renamed when it is complete, so an interrupted run
+	 * always leaves the previous checkpoint intact.
+	 *
+	 * Usage:
+	 * CheckpointWriter<complex<double>> writer;
+	 * for (...) { propagate(Psi); writer.Write(Psi, tree, "restart.dat"); }
+	 * writer.Wait();
+	 */
+{
+public:
+	explicit CheckpointWriter(Checkpoint::RestartParameters par = Checkpoint::RestartParameters(),
+		bool async = true)
+		: par_(par), async_(async) {}
+
+	~CheckpointWriter() { Wait(); }
+
+	CheckpointWriter(const CheckpointWriter&) = delete;
+
+	CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+	/// Start writing a snapshot of Psi
+	void Write(const TensorTree<T>& Psi, const Tree& tree, const string& filename);
+
+	/// Block until the last checkpoint is on disk
+	void Wait();
+
+	/// True while a checkpoint is written
+	bool Busy() const { return busy_; }
+
+	/// Size of the last completed checkpoint in bytes
+	size_t Bytes() const { return bytes_; }
+
+	size_t nWritten() const { return nWritten_; }
+
+private:
+	void Run(const string& filename);
+
+	Checkpoint::RestartParameters par_;
+	bool async_;
+	TensorTree<T> snapshot_;
+	Tree tree_;
+	thread worker_;
+	atomic<bool> busy_{false};
+	atomic<size_t> bytes_{0};
+	atomic<size_t> nWritten_{0};
+};
+
+#endif //CHECKPOINTWRITER_H
@@ -6,6 +6,7 @@
 #define MATRIXTREEFUNCTIONS_H
 #include "TreeClasses/TensorTree.h"
 #include "TreeClasses/MatrixTree.h"
+#include "TreeClasses/TreeWorkspace.h"
 
 namespace TreeFunctions {
 
@@ -18,6 +19,24 @@ namespace TreeFunctions {
 	template<typename T>
 	MatrixTree<T> DotProduct(const TensorTree<T>& Psi, const TensorTree<T>& Chi, const Tree& tree);
 
+	/**
+	 * \brief Overlaps of all pairs of N states in one sweep.
+	 *
+	 * The tensors of the states are stacked along the last index, so S[node]
+	 * is a (N n x N n) matrix whose block (a, b) is the overlap matrix
+	 * <Psi_a|Psi_b> at node. Bottom-layer blocks are computed by a single
+	 * product of the stacked tensors. In upper nodes, the first child matrix is
+	 * applied to all bras at once; only the remaining children are applied per
+	 * pair. S is hermitian and only blocks a <= b are computed. All states need
+	 * the shapes of tree.
+	 */
+	template<typename T>
+	void DotProduct(MatrixTree<T>& S, const vector<TensorTree<T>>& Psis, const Tree& tree);
+
+	/// Gram matrix <Psi_a|Psi_b> of N states (N nStates x N nStates)
+	template<typename T>
+	Matrix<T> GramMatrix(const vector<TensorTree<T>>& Psis, const Tree& tree);
+
 	template<typename T>
 //	void ContractionLocal(MatrixTree<T>& Rho, const Tensor<T>& Bra, Tensor<T> Ket,
 //		const MatrixTree<T>& S, const Node& node);
@@ -38,6 +57,31 @@ namespace TreeFunctions {
 	template<typename T>
 	MatrixTree<T> Contraction(const TensorTree<T>& Psi, const Tree& tree, bool orthogonal);
 
+////////////////////////////////////////////////////////////////////////
+/// Allocation-free sweeps; intermediates are kept in a TreeWorkspace
+////////////////////////////////////////////////////////////////////////
+
+	template<typename T>
+	void DotProductLocal(MatrixTree<T>& S, const Tensor<T>& Bra, const Tensor<T>& Ket,
+		const Node& node, TreeWorkspace<T>& work);
+
+	template<typename T>
+	void DotProduct(MatrixTree<T>& S, const TensorTree<T>& Bra, const TensorTree<T>& Ket,
+		const Tree& tree, TreeWorkspace<T>& work);
+
+	template<typename T>
+	void ContractionLocal(MatrixTree<T>& Rho, const Tensor<T>& Bra, const Tensor<T>& Ket,
+		const Node& node, const MatrixTree<T> *S_opt, TreeWorkspace<T>& work);
+
+	template<typename T>
+	void Contraction(MatrixTree<T>& Rho, const TensorTree<T>& Bra, const TensorTree<T>& Ket,
+		const MatrixTree<T>& S, const Tree& tree, TreeWorkspace<T>& work);
+
+	/// Contraction for orthonormal basis sets (S = 1)
+	template<typename T>
+	void Contraction(MatrixTree<T>& Rho, const TensorTree<T>& Bra, const TensorTree<T>& Ket,
+		const Tree& tree, TreeWorkspace<T>& work);
+
 }
 
 #endif //MATRIXTREEFUNCTIONS_H
@@ -5,6 +5,7 @@
 #ifndef MATRIXTREE_IMPLEMENTATION_H
 #define MATRIXTREE_IMPLEMENTATION_H
 #include "MatrixTreeFunctions.h"
+#include "TreeClasses/TreeSweep.h"
 
 namespace TreeFunctions {
 ////////////////////////////////////////////////////////////////////////
@@ -26,9 +27,9 @@ namespace TreeFunctions {
 
 	template<typename T>
 	void DotProduct(MatrixTree<T>& S, const TensorTree<T>& Psi, const TensorTree<T>& Chi, const Tree& tree) {
-		for (const Node& node : tree) {
+		TreeSweep::BottomUp(tree, [&](const Node& node) {
 			DotProductLocal(S, Psi[node], Chi[node], node);
-		}
+		});
 	}
 
 	template<typename T>
@@ -38,6 +39,101 @@ namespace TreeFunctions {
 		return S;
 	}
 
+////////////////////////////////////////////////////////////////////////
+/// DotProduct for many states in one sweep
+////////////////////////////////////////////////////////////////////////
+
+	template<typename T>
+	Tensor<T> StackStates(const vector<TensorTree<T>>& Psis, const Node& node) {
+		const TensorShape& shape = node.shape();
+		size_t n = shape.totalDimension();
+		TensorShape stacked(shape);
+		stacked.setDimension(Psis.size() * shape.lastDimension(), shape.lastIdx());
+		Tensor<T> Phi(stacked, false);
+		for (size_t a = 0; a < Psis.size(); ++a) {
+			const Tensor<T>& A = Psis[a][node];
+			assert(A.shape() == shape);
+			copy(&A[0], &A[0] + n, &Phi[a * n]);
+		}
+		return Phi;
+	}
+
+	template<typename T>
+	void DotProductLocal(MatrixTree<T>& S, const vector<TensorTree<T>>& Psis, const Node& node) {
+		size_t N = Psis.size();
+		size_t n = node.shape().lastDimension();
+		Matrix<T>& s = S[node];
+		if ((s.Dim1() != N * n) || (s.Dim2() != N * n)) { s = Matrix<T>(N * n, N * n); }
+
+		size_t last = node.shape().lastIdx();
+		if (node.isBottomlayer()) {
+			Tensor<T> Phi = StackStates(Psis, node);
+			Contraction(s, Phi, Phi, last);
+			return;
+		}
+
+		/// The first child is applied to all bras at once, the others per pair
+		const Node& child0 = node.child(0);
+		size_t n0 = child0.shape().lastDimension();
+		const Matrix<T>& S0 = S[child0];
+		size_t rest = node.shape().totalDimension() / n0;
+#pragma omp parallel for schedule(dynamic)
+		for (size_t b = 0; b < N; ++b) {
+			const Tensor<T>& Ket = Psis[b][node];
+			Matrix<T> S0b(N * n0, n0);
+			for (size_t j = 0; j < n0; ++j) {
+				for (size_t i = 0; i < N * n0; ++i) {
+					S0b(i, j) = S0(i, b * n0 + j);
+				}
+			}
+			Tensor<T> X = MatrixTensor(S0b, Ket, 0);
+
+			/// S is hermitian, only a <= b is computed
+			Tensor<T> Y(node.shape(), false);
+			for (size_t a = 0; a <= b; ++a) {
+				for (size_t r = 0; r < rest; ++r) {
+					for (size_t i = 0; i < n0; ++i) {
+						Y[r * n0 + i] = X[r * N * n0 + a * n0 + i];
+					}
+				}
+				for (size_t k = 1; k < node.nChildren(); ++k) {
+					const Node& child = node.child(k);
+					const Matrix<T>& Sk = S[child];
+					size_t nk = child.shape().lastDimension();
+					Matrix<T> Sab(nk, nk);
+					for (size_t j = 0; j < nk; ++j) {
+						for (size_t i = 0; i < nk; ++i) {
+							Sab(i, j) = Sk(a * nk + i, b * nk + j);
+						}
+					}
+					Y = MatrixTensor(Sab, Y, k);
+				}
+				Matrix<T> sab = Contraction(Psis[a][node], Y, last);
+				Matrix<T> sba = sab.Adjoint();
+				for (size_t j = 0; j < n; ++j) {
+					for (size_t i = 0; i < n; ++i) {
+						s(a * n + i, b * n + j) = sab(i, j);
+						s(b * n + j, a * n + i) = sba(j, i);
+					}
+				}
+			}
+		}
+	}
+
+	template<typename T>
+	void DotProduct(MatrixTree<T>& S, const vector<TensorTree<T>>& Psis, const Tree& tree) {
+		TreeSweep::BottomUp(tree, [&](const Node& node) {
+			DotProductLocal(S, Psis, node);
+		});
+	}
+
+	template<typename T>
+	Matrix<T> GramMatrix(const vector<TensorTree<T>>& Psis, const Tree& tree) {
+		MatrixTree<T> S(tree);
+		DotProduct(S, Psis, tree);
+		return S[tree.TopNode()];
+	}
+
 ////////////////////////////////////////////////////////////////////////
 /// General Contraction for Tensor Trees
 ////////////////////////////////////////////////////////////////////////
@@ -76,16 +172,14 @@ namespace TreeFunctions {
 		assert(Psi.size() == tree.nNodes());
 		assert(Chi.size() == tree.nNodes());
 
-		// @TODO: Use reverse iterator
-		for (auto it = tree.rbegin(); it != tree.rend(); it++) {
-			const Node& node = *it;
+		TreeSweep::TopDown(tree, [&](const Node& node) {
 			if (!node.isToplayer()) {
 				const Node& parent = node.parent();
 				ContractionLocal(Rho, Psi[parent], Chi[parent], node, S_opt);
 			} else {
 				Rho[node] = IdentityMatrix<T>(node.shape().lastDimension());
 			}
-		}
+		});
 	}
 
 	template<typename T>
@@ -119,6 +213,95 @@ namespace TreeFunctions {
 		return Rho;
 	}
 
+////////////////////////////////////////////////////////////////////////
+/// Allocation-free sweeps
+////////////////////////////////////////////////////////////////////////
+
+	template<typename T>
+	void DotProductLocal(MatrixTree<T>& S, const Tensor<T>& Bra, const Tensor<T>& Ket,
+		const Node& node, TreeWorkspace<T>& work) {
+		const Tensor<T> *Phi = &Ket;
+		if (!node.isBottomlayer()) {
+			for (int k = 0; k < node.nChildren(); k++) {
+				const Node& child = node.child(k);
+				Tensor<T>& SPhi = work.Buffer(node, k % 2);
+				MatrixTensor(SPhi, S[child], *Phi, k, true);
+				Phi = &SPhi;
+			}
+		}
+		size_t last = node.shape().lastIdx();
+		Contraction(S[node], Bra, *Phi, last, true);
+	}
+
+	template<typename T>
+	void DotProduct(MatrixTree<T>& S, const TensorTree<T>& Bra, const TensorTree<T>& Ket,
+		const Tree& tree, TreeWorkspace<T>& work) {
+		assert(work.size() == tree.nNodes());
+		TreeSweep::BottomUp(tree, [&](const Node& node) {
+			DotProductLocal(S, Bra[node], Ket[node], node, work);
+		});
+	}
+
+	template<typename T>
+	void ContractionLocal(MatrixTree<T>& Rho, const Tensor<T>& Bra, const Tensor<T>& Ket,
+		const Node& node, const MatrixTree<T> *S_opt, TreeWorkspace<T>& work) {
+		assert(!node.isToplayer());
+
+		const Node& parent = node.parent();
+		auto child_idx = (size_t) node.childIdx();
+
+		const Tensor<T> *Phi = &Ket;
+		size_t buf = 0;
+		/// Optional Overlap matrix
+		if (S_opt != nullptr) {
+			const MatrixTree<T>& S = *S_opt;
+			for (size_t k = 0; k < parent.nChildren(); ++k) {
+				if (k != child_idx) {
+					const Node& child = parent.child(k);
+					Tensor<T>& SPhi = work.HoleBuffer(node, buf);
+					MatrixTensor(SPhi, S[child], *Phi, k, true);
+					Phi = &SPhi;
+					buf = 1 - buf;
+				}
+			}
+		}
+
+		Tensor<T>& RhoPhi = work.HoleBuffer(node, buf);
+		multStateAB(RhoPhi, Rho[parent], *Phi, true);
+
+		Contraction(Rho[node], Bra, RhoPhi, child_idx, true);
+	}
+
+	template<typename T>
+	void Contraction(MatrixTree<T>& Rho, const TensorTree<T>& Bra, const TensorTree<T>& Ket,
+		const Tree& tree, const MatrixTree<T> *S_opt, TreeWorkspace<T>& work) {
+		assert(Rho.size() == tree.nNodes());
+		assert(work.size() == tree.nNodes());
+		TreeSweep::TopDown(tree, [&](const Node& node) {
+			if (!node.isToplayer()) {
+				const Node& parent = node.parent();
+				ContractionLocal(Rho, Bra[parent], Ket[parent], node, S_opt, work);
+			} else {
+				Matrix<T>& I = Rho[node];
+				I.Zero();
+				for (size_t i = 0; i < I.Dim1(); ++i) { I(i, i) = 1.; }
+			}
+		});
+	}
+
+	template<typename T>
+	void Contraction(MatrixTree<T>& Rho, const TensorTree<T>& Bra, const TensorTree<T>& Ket,
+		const MatrixTree<T>& S, const Tree& tree, TreeWorkspace<T>& work) {
+		Contraction(Rho, Bra, Ket, tree, &S, work);
+	}
+
+	template<typename T>
+	void Contraction(MatrixTree<T>& Rho, const TensorTree<T>& Bra, const TensorTree<T>& Ket,
+		const Tree& tree, TreeWorkspace<T>& work) {
+		const MatrixTree<T> *null = nullptr;
+		Contraction(Rho, Bra, Ket, tree, null, work);
+	}
+
 }
 
 #endif //MATRIXTREE_IMPLEMENTATION_H
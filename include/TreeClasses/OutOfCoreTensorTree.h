@@ -0,0 +1,156 @@
+#ifndef OUTOFCORETENSORTREE_H
+#define OUTOFCORETENSORTREE_H
+#include "TreeClasses/TensorTreeCheckpoint.h"
+#include "TreeClasses/MatrixTree.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
+
+template<typename T>
+class OutOfCoreTensorTree
+	/**
+	 * \class OutOfCoreTensorTree
+	 * \ingroup Tree
+	 * \brief TensorTree whose node tensors live in a checkpoint file.
+	 *
+	 * The tensors are kept in a file in the Checkpoint format and are read
+	 * (pread) on demand into an LRU cache of at most cacheBytes. Modified
+	 * tensors are written back (pwrite) when they are evicted, on Flush() and
+	 * in the destructor. Prefetch() queues nodes for a background thread, so
+	 * the I/O of the next nodes in a sweep overlaps with the work on the
+	 * current one.
+	 *
+	 * The file is opened read-only. It is reopened for writing, and its CRC
+	 * flag is cleared, only when the first modified tensor is written back,
+	 * so read-only files can be used as long as no tensor is written.
+	 *
+	 * Read() returns a shared pointer: an evicted tensor stays valid as long
+	 * as it is used, the cache only drops its own reference. Tensors are
+	 * replaced as a whole by Write(); readers that hold the old tensor keep
+	 * seeing the old coefficients. All member functions are thread-safe.
+	 *
+	 * Usage:
+	 * OutOfCoreTensorTree<complex<double>> Psi(tree, "psi.ooc", 1 << 30);
+	 * Psi.Write(node, Phi);
+	 * auto Phi = Psi.Read(node);
+	 * MatrixTreecd S = TreeFunctions::DotProduct(Psi, Psi, tree);
+	 */
+{
+public:
+	/// Open a checkpoint file (Checkpoint::Write or a previous OutOfCoreTensorTree)
+	OutOfCoreTensorTree(const string& filename, size_t cacheBytes);
+
+	/// Create a file with zero tensors for every node of tree
+	OutOfCoreTensorTree(const Tree& tree, const string& filename, size_t cacheBytes);
+
+	/// Create a file that holds Psi
+	OutOfCoreTensorTree(const TensorTree<T>& Psi, const string& filename, size_t cacheBytes);
+
+	/// Writes back all modified tensors
+	~OutOfCoreTensorTree();
+
+	OutOfCoreTensorTree(const OutOfCoreTensorTree&) = delete;
+
+	OutOfCoreTensorTree& operator=(const OutOfCoreTensorTree&) = delete;
+
+	/// Tensor at node, read from the file if it is not cached
+	shared_ptr<const Tensor<T>> Read(const Node& node) const;
+
+	/// Replace the tensor at node, written to the file on eviction or Flush()
+	void Write(const Node& node, const Tensor<T>& Phi);
+
+	/// Start reading the tensor at node in the background
+	void Prefetch(const Node& node) const;
+
+	/// Write back all modified tensors
+	void Flush();
+
+	/// Copy of the whole tree in memory
+	TensorTree<T> Load() const;
+
+	size_t size() const { return index_.shapes.size(); }
+
+	const TensorShape& shape(const Node& node) const { return index_.shapes[node.Address()]; }
+
+	/// Capacity and current size of the cache in bytes
+	size_t CacheBytes() const { return cacheBytes_; }
+
+	size_t CachedBytes() const;
+
+	size_t nHits() const { return nHits_; }
+
+	size_t nMisses() const { return nMisses_; }
+
+	size_t nPrefetched() const { return nPrefetched_; }
+
+private:
+	struct Entry {
+		shared_ptr<Tensor<T>> tensor;
+		bool dirty{false};
+		bool loading{true};
+		typename list<size_t>::iterator lru;
+	};
+
+	void Open(const string& filename);
+
+	/// Open the file for writing and invalidate its CRCs (lock is held)
+	void OpenForWriting() const;
+
+	/// Load node n into the cache (lock is held on entry and exit)
+	shared_ptr<Tensor<T>> Fetch(size_t n, unique_lock<mutex>& lock, bool prefetch) const;
+
+	void Touch(size_t n, Entry& entry) const;
+
+	/// Drop least recently used tensors until the cache fits
+	void Evict() const;
+
+	void ReadTensor(size_t n, Tensor<T>& Phi) const;
+
+	void WriteTensor(size_t n, const Tensor<T>& Phi) const;
+
+	void Worker() const;
+
+	Checkpoint::Index index_;
+	string filename_;
+	int fd_{-1};
+	mutable int wfd_{-1};
+	size_t cacheBytes_;
+
+	mutable mutex mutex_;
+	mutable condition_variable loaded_;
+	mutable map<size_t, Entry> cache_;
+	mutable list<size_t> lru_; ///< Most recently used in front
+	mutable size_t cached_{0};
+
+	mutable deque<size_t> queue_;
+	mutable condition_variable queued_;
+	mutable thread worker_;
+	mutable bool stop_{false};
+
+	mutable atomic<size_t> nHits_{0};
+	mutable atomic<size_t> nMisses_{0};
+	mutable atomic<size_t> nPrefetched_{0};
+};
+
+namespace TreeFunctions {
+	/// DotProduct with Bra and Ket on disk. The next "lookahead" nodes are prefetched.
+	template<typename T>
+	void DotProduct(MatrixTree<T>& S, const OutOfCoreTensorTree<T>& Bra,
+		const OutOfCoreTensorTree<T>& Ket, const Tree& tree, size_t lookahead = 2);
+
+	template<typename T>
+	MatrixTree<T> DotProduct(const OutOfCoreTensorTree<T>& Bra,
+		const OutOfCoreTensorTree<T>& Ket, const Tree& tree, size_t lookahead = 2);
+
+	/// Contraction (density matrices) with Bra and Ket on disk and optional overlaps S
+	template<typename T>
+	void Contraction(MatrixTree<T>& Rho, const OutOfCoreTensorTree<T>& Bra,
+		const OutOfCoreTensorTree<T>& Ket, const Tree& tree,
+		const MatrixTree<T> *S_opt = nullptr, size_t lookahead = 2);
+}
+
+#endif //OUTOFCORETENSORTREE_H
@@ -0,0 +1,92 @@
+#ifndef RANKADAPTATION_H
+#define RANKADAPTATION_H
+#include "TreeClasses/SpectralDecompositionTree.h"
+#include "TreeClasses/TensorTree.h"
+
+namespace TreeFunctions {
+/**
+ * \brief Adaptive ranks (number of single-particle functions) for a TensorTree.
+ *
+ * The natural populations of every edge are the eigenvalues of the density
+ * matrix from Contraction(Psi, tree, true). Each edge whose rank changes is
+ * rotated to its natural functions and resized such that
+ *  - all functions are kept except the weakest ones whose summed population
+ *    is below tolerance * trace(rho) (truncation),
+ *  - "spare" functions with (nearly) zero population are kept on top. An edge
+ *    without any negligible function is starved and grows by new orthonormal
+ *    functions with zero coefficients, which leaves the state unchanged.
+ * The rank of an edge is bounded by minRank, maxRank and by the dimensions of
+ * the tensors on both sides of the edge.
+ *
+ * The shapes of the nodes in the tree and of the tensors in Psi are updated
+ * together; everything else that depends on the shapes (MatrixTrees,
+ * SparseMatrixTrees, ...) has to be rebuilt afterwards. Edges that keep their
+ * rank are not touched, so Psi is unchanged if no rank changes. Psi has to be
+ * orthonormal in all but the top node.
+ *
+ * Usage:
+ * RankParameters par;
+ * par.tolerance = 1e-8;
+ * if (TreeFunctions::AdaptRanks(Psi, tree, par)) { mats = ...; }
+ */
+	struct RankParameters {
+		double tolerance{1e-8}; ///< Discarded population per edge, relative to the trace
+		size_t spare{1};        ///< Number of unoccupied functions kept per edge
+		size_t minRank{1};
+		size_t maxRank{1000};
+	};
+
+	/**
+	 * \brief Grow or truncate every edge of Psi.
+	 * @param Psi orthonormal TensorTree, adjusted in place
+	 * @param tree tree of Psi, node shapes are adjusted in place
+	 * @param par target truncation error and rank bounds
+	 * @return true if any rank (and thereby Psi) changed
+	 */
+	template<typename T>
+	bool AdaptRanks(TensorTree<T>& Psi, Tree& tree, const RankParameters& par);
+
+	/// Same as above for precomputed natural populations (e.g. from the density matrices of Psi)
+	template<typename T>
+	bool AdaptRanks(TensorTree<T>& Psi, Tree& tree, const SpectralDecompositionTree<T>& X,
+		const RankParameters& par);
+
+	/// Number of natural functions on an edge to reach the target truncation error
+	size_t TargetRank(const Vectord& p, const RankParameters& par);
+
+	struct TruncationParameters {
+		double eps{1e-8};     ///< Bound for |Psi - Psi'| / |Psi|
+		size_t minRank{1};
+		size_t maxRank{1000};
+	};
+
+	template<typename T>
+	struct TruncatedTree {
+		Tree tree;                ///< Tree with the reduced edge dimensions
+		TensorTree<T> Psi;        ///< Compressed wavefunction on tree
+		vector<double> discarded; ///< Discarded weight per edge, indexed by the address of the lower node
+		double error{0.};         ///< |Psi - Psi'|, sqrt of the summed discarded weights
+	};
+
+	/**
+	 * \brief Compress a TensorTree by a hierarchical SVD (root-to-leaf truncation).
+	 *
+	 * Psi is first orthonormalized bottom-up (Gram-Schmidt, the overlaps are
+	 * pushed into the parents), which leaves the state unchanged. Then the edges
+	 * are truncated from the top node to the leaves. At every edge, the
+	 * populations (squared singular values) are computed from the already
+	 * truncated upper part and the weakest natural functions are discarded as
+	 * long as their weight stays below eps^2 |Psi|^2 / nEdges. This guarantees
+	 * |Psi - Psi'| <= sqrt(sum of discarded weights) <= eps |Psi|. maxRank takes
+	 * precedence over eps; in this case the bound is the reported error.
+	 *
+	 * Usage:
+	 * auto x = TreeFunctions::Truncate(Psi, tree, par);
+	 * x.Psi.Write("psi.dat");
+	 */
+	template<typename T>
+	TruncatedTree<T> Truncate(const TensorTree<T>& Psi, const Tree& tree,
+		const TruncationParameters& par);
+}
+
+#endif //RANKADAPTATION_H
@@ -0,0 +1,55 @@
+#ifndef SOPSUBTREECACHE_H
+#define SOPSUBTREECACHE_H
+#include "TreeShape/Tree.h"
+#include "TreeOperators/SumOfProductsOperator.h"
+
+template<typename T>
+class SOPSubtreeCache
+/**
+ * \class SOPSubtreeCache
+ * \ingroup Tree
+ * \brief Finds the representation matrices that are identical across SOP terms.
+ *
+ * The matrix of a term at a node only depends on the part of the MLO that
+ * acts below the node, i.e. on the ordered list of (leaf, LeafOperator) pairs
+ * in the subtree. Terms with the same list at a node form a group. Per sweep,
+ * the matrix of a group is built once, for its owner term, and copied to the
+ * other terms of the group. LeafOperators are compared by pointer, so terms
+ * have to share the same shared_ptr to be recognized as identical.
+ *
+ * The groups depend only on the SOP and the tree and are built once.
+ * */
+{
+public:
+	struct Group {
+		size_t owner;          ///< Term for which the matrix is computed
+		vector<size_t> shared; ///< Terms that receive a copy
+	};
+
+	SOPSubtreeCache() = default;
+
+	SOPSubtreeCache(const SOP<T>& sop, const Tree& tree);
+
+	~SOPSubtreeCache() = default;
+
+	void Initialize(const SOP<T>& sop, const Tree& tree);
+
+	/// Groups of identical matrices at "node"
+	const vector<Group>& Groups(const Node& node) const {
+		assert(node.Address() < groups_.size());
+		return groups_[node.Address()];
+	}
+
+	/// Number of representation matrices of all terms (without top nodes)
+	size_t nMatrices() const;
+
+	/// Number of matrices that are actually computed per sweep
+	size_t nDistinct() const;
+
+	void print(ostream& os = cout) const;
+
+private:
+	vector<vector<Group>> groups_;
+};
+
+#endif //SOPSUBTREECACHE_H
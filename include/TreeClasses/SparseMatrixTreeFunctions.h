@@ -7,6 +7,8 @@
 #include "TreeClasses/SparseMatrixTree.h"
 #include "TreeClasses/SOPMatrixTrees.h"
 #include "TreeClasses/MatrixTree.h"
+#include "TreeClasses/TreeWorkspace.h"
+#include "TreeClasses/SOPSubtreeCache.h"
 
 namespace TreeFunctions {
 /**
@@ -122,6 +124,104 @@ namespace TreeFunctions {
 	void Contraction(MatrixTree<T>& Rho, const TensorTree<T>& Psi,
 		const SparseTree& stree, bool orthogonal = true);
 
+////////////////////////////////////////////////////////////////////////
+/// Allocation-free sweeps; intermediates are kept in a TreeWorkspace
+////////////////////////////////////////////////////////////////////////
+
+	template<typename T>
+	void RepresentLayer(SparseMatrixTree<T>& mats, const Tensor<T>& Bra,
+		const Tensor<T>& Ket, const MLO<T>& M, const Node& node, TreeWorkspace<T>& work);
+
+	template<typename T>
+	void Represent(SparseMatrixTree<T>& hmat, const MLO<T>& M,
+		const TensorTree<T>& Bra, const TensorTree<T>& Ket,
+		const Tree& tree, TreeWorkspace<T>& work);
+
+	template <typename T>
+	void Represent(SparseMatrixTrees<T>& Mats, const SOP<T>& sop,
+		const TensorTree<T>& Bra, const TensorTree<T>& Ket,
+		const Tree& tree, TreeWorkspace<T>& work);
+
+	template <typename T>
+	void Represent(SOPMatrixTrees<T>& mats, const SOP<T>& sop,
+		const TensorTree<T>& Bra, const TensorTree<T>& Ket,
+		const Tree& tree, TreeWorkspace<T>& work);
+
+	template<typename T>
+	void Contraction(SparseMatrixTree<T>& holes, const TensorTree<T>& Bra,
+		const TensorTree<T>& Ket, const SparseMatrixTree<T>& mats,
+		const Tree& tree, TreeWorkspace<T>& work);
+
+	template<typename T>
+	void Contraction(SparseMatrixTree<T>& holes, const TensorTree<T>& Bra,
+		const TensorTree<T>& Ket, const SparseMatrixTree<T>& mats,
+		const MatrixTree<T>& rho, const Tree& tree, TreeWorkspace<T>& work);
+
+	template <typename T>
+	void Contraction(SparseMatrixTrees<T>& holes, const SparseMatrixTrees<T>& mats,
+		const TensorTree<T>& Bra, const TensorTree<T>& Ket,
+		const Tree& tree, TreeWorkspace<T>& work);
+
+	template <typename T>
+	void Contraction(SparseMatrixTrees<T>& holes, const TensorTree<T>& Bra,
+		const TensorTree<T>& Ket, const SparseMatrixTrees<T>& mats,
+		const MatrixTree<T>& rho, const Tree& tree, TreeWorkspace<T>& work);
+
+////////////////////////////////////////////////////////////////////////
+/// Parallel SOP sweeps
+////////////////////////////////////////////////////////////////////////
+/**
+ * The terms of the SOP are distributed over min(work.size(), omp_get_max_threads())
+ * threads; thread t uses work[t]. Terms are assigned greedily by their cost,
+ * estimated from the tensor sizes of the active nodes of each SparseTree.
+ * Every term is still evaluated by one thread only, so the results are identical
+ * to the serial versions.
+ *
+ * Usage:
+ * TreeWorkspacescd work(omp_get_max_threads(), TreeWorkspacecd(tree));
+ * Represent(mats, H, Psi, Psi, tree, work);
+ */
+
+	template <typename T>
+	void Represent(SparseMatrixTrees<T>& Mats, const SOP<T>& sop,
+		const TensorTree<T>& Bra, const TensorTree<T>& Ket,
+		const Tree& tree, TreeWorkspaces<T>& work);
+
+	template <typename T>
+	void Represent(SOPMatrixTrees<T>& mats, const SOP<T>& sop,
+		const TensorTree<T>& Bra, const TensorTree<T>& Ket,
+		const Tree& tree, TreeWorkspaces<T>& work);
+
+	template <typename T>
+	void Contraction(SparseMatrixTrees<T>& holes, const SparseMatrixTrees<T>& mats,
+		const TensorTree<T>& Bra, const TensorTree<T>& Ket,
+		const Tree& tree, TreeWorkspaces<T>& work);
+
+	template <typename T>
+	void Contraction(SparseMatrixTrees<T>& holes, const TensorTree<T>& Bra,
+		const TensorTree<T>& Ket, const SparseMatrixTrees<T>& mats,
+		const MatrixTree<T>& rho, const Tree& tree, TreeWorkspaces<T>& work);
+
+////////////////////////////////////////////////////////////////////////
+/// SOP sweeps with shared subtrees
+////////////////////////////////////////////////////////////////////////
+/**
+ * Builds every distinct matrix of the SOP representation once (see
+ * SOPSubtreeCache) and copies it to all terms that share it. Mats have to
+ * be constructed with tail = true (the default). The distinct matrices at
+ * each node are computed in parallel, one workspace per thread.
+ */
+
+	template <typename T>
+	void Represent(SparseMatrixTrees<T>& Mats, const SOP<T>& sop,
+		const TensorTree<T>& Bra, const TensorTree<T>& Ket, const SOPSubtreeCache<T>& cache,
+		const Tree& tree, TreeWorkspaces<T>& work);
+
+	template <typename T>
+	void Represent(SOPMatrixTrees<T>& mats, const SOP<T>& sop,
+		const TensorTree<T>& Bra, const TensorTree<T>& Ket, const SOPSubtreeCache<T>& cache,
+		const Tree& tree, TreeWorkspaces<T>& work);
+
 ////////////////////////////////////////////////////////////////////////
 /// Apply MatrixTree
 ////////////////////////////////////////////////////////////////////////
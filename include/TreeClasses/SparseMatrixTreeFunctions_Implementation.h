@@ -6,6 +6,7 @@
 #define SPARSEMATRIXTREEFUNCTIONS_IMPLEMENTATION_H
 #include "TreeClasses/SparseMatrixTreeFunctions.h"
 #include "TreeClasses/MatrixTreeFunctions.h"
+#include "TreeClasses/TreeSweep.h"
 
 namespace TreeFunctions {
 ////////////////////////////////////////////////////////////////////////
@@ -50,12 +51,11 @@ namespace TreeFunctions {
 		const Tree& tree) {
 		assert(Bra.size() == Ket.size());
 		const SparseTree& active = hmat.Active();
-		for (size_t n = 0; n < active.size(); ++n) {
-			const Node& node = active.MCTDHNode(n);
+		TreeSweep::BottomUp(active, [&](const Node& node) {
 			if (!node.isToplayer()) {
 				RepresentLayer(hmat, Bra[node], Ket[node], M, node);
 			}
-		}
+		});
 	}
 
 	template<typename T>
@@ -128,10 +128,7 @@ namespace TreeFunctions {
 	void Contraction(SparseMatrixTree<T>& holes, const TensorTree<T>& Bra, const TensorTree<T>& Ket,
 		const SparseMatrixTree<T>& mats, const SparseTree& marker, const Tree& tree) {
 
-		// Swipe top-down_ but exclude topnode
-		int sub_topnode = marker.size() - 1;
-		for (int n = sub_topnode; n >= 0; --n) {
-			const Node& node = marker.MCTDHNode(n);
+		TreeSweep::TopDown(marker, [&](const Node& node) {
 			if (!node.isToplayer()) {
 				assert(holes.Active(node));
 
@@ -151,7 +148,7 @@ namespace TreeFunctions {
 			} else {
 				holes[node] = IdentityMatrix<T>(node.shape().lastDimension());
 			}
-		}
+		});
 	}
 
 	template<typename T>
@@ -159,10 +156,7 @@ namespace TreeFunctions {
 		const SparseMatrixTree<T>& mats, const MatrixTree<T>& rho,
 		const SparseTree& marker, const Tree& tree) {
 
-		// Swipe top-down_ but exclude topnode
-		int sub_topnode = marker.size() - 1;
-		for (int n = sub_topnode; n >= 0; --n) {
-			const Node& node = marker.MCTDHNode(n);
+		TreeSweep::TopDown(marker, [&](const Node& node) {
 			if (!node.isToplayer()) {
 				assert(holes.Active(node));
 
@@ -179,7 +173,7 @@ namespace TreeFunctions {
 			} else {
 				holes[node] = IdentityMatrix<T>(node.shape().lastDimension());
 			}
-		}
+		});
 	}
 
 	template<typename T>
@@ -248,6 +242,320 @@ namespace TreeFunctions {
 		}
 	}
 
+////////////////////////////////////////////////////////////////////////
+/// Allocation-free sweeps
+////////////////////////////////////////////////////////////////////////
+
+	template<typename T>
+	void RepresentLayer(SparseMatrixTree<T>& mats, const Tensor<T>& Bra,
+		const Tensor<T>& Ket, const MLO<T>& M, const Node& node, TreeWorkspace<T>& work) {
+		if (!mats.Active(node)) { return; }
+
+		const Tensor<T> *hKet = &Ket;
+		if (node.isBottomlayer()) {
+			hKet = &M.ApplyBottomLayer(Ket, work.Buffer(node, 0),
+				work.Buffer(node, 1), node.getLeaf());
+		} else {
+			size_t buf = 0;
+			for (size_t l = 0; l < node.nChildren(); l++) {
+				const Node& child = node.child(l);
+				if (!mats.Active(child)) { continue; }
+				Tensor<T>& hPhi = work.Buffer(node, buf);
+				MatrixTensor(hPhi, mats[child], *hKet, child.childIdx(), true);
+				hKet = &hPhi;
+				buf = 1 - buf;
+			}
+		}
+		Contraction(mats[node], Bra, *hKet, node.shape().lastIdx(), true);
+	}
+
+	template<typename T>
+	void Represent(SparseMatrixTree<T>& hmat, const MLO<T>& M,
+		const TensorTree<T>& Bra, const TensorTree<T>& Ket,
+		const Tree& tree, TreeWorkspace<T>& work) {
+		assert(Bra.size() == Ket.size());
+		assert(work.size() == tree.nNodes());
+		const SparseTree& active = hmat.Active();
+		TreeSweep::BottomUp(active, [&](const Node& node) {
+			if (!node.isToplayer()) {
+				RepresentLayer(hmat, Bra[node], Ket[node], M, node, work);
+			}
+		});
+	}
+
+	template<typename T>
+	void Represent(SparseMatrixTrees<T>& Mats, const SOP<T>& sop,
+		const TensorTree<T>& Bra, const TensorTree<T>& Ket,
+		const Tree& tree, TreeWorkspace<T>& work) {
+		assert(Mats.size() == sop.size());
+		for (size_t l = 0; l < sop.size(); ++l) {
+			Represent(Mats[l], sop[l], Bra, Ket, tree, work);
+		}
+	}
+
+	template<typename T>
+	void Represent(SOPMatrixTrees<T>& mats, const SOP<T>& sop,
+		const TensorTree<T>& Bra, const TensorTree<T>& Ket,
+		const Tree& tree, TreeWorkspace<T>& work) {
+		Represent(mats.matrices_, sop, Bra, Ket, tree, work);
+		Contraction(mats.contractions_, mats.matrices_, Bra, Ket, tree, work);
+	}
+
+	/// Hole sweep for one SparseMatrixTree. If rho is nullptr, inactive parents are an error.
+	template<typename T>
+	void ContractionLocal(SparseMatrixTree<T>& holes, const TensorTree<T>& Bra,
+		const TensorTree<T>& Ket, const SparseMatrixTree<T>& mats,
+		const MatrixTree<T> *rho, const Node& node, TreeWorkspace<T>& work) {
+		const SparseTree& marker = holes.Active();
+		const Node& parent = node.parent();
+		size_t drop = node.childIdx();
+
+		/// Apply the operator to all active siblings
+		const Tensor<T> *hKet = &Ket[parent];
+		size_t buf = 0;
+		for (size_t k = 0; k < parent.nChildren(); ++k) {
+			const Node& child = parent.child(k);
+			size_t childidx = child.childIdx();
+			if ((childidx == drop) || (!mats.Active(child))) { continue; }
+			Tensor<T>& hPhi = work.HoleBuffer(node, buf);
+			MatrixTensor(hPhi, mats[child], *hKet, childidx, true);
+			hKet = &hPhi;
+			buf = 1 - buf;
+		}
+
+		/// Apply the mean-field of the parent
+		const Matrix<T> *hole = nullptr;
+		if (rho == nullptr) {
+			if (!parent.isToplayer() && !marker.Active(parent)) {
+				cerr << "Error in Contraction of operator representation:\n";
+				cerr << "Missing active node at parent.\n";
+				exit(1);
+			}
+			if (marker.Active(parent)) { hole = &holes[parent]; }
+		} else if (!parent.isToplayer()) {
+			hole = marker.Active(parent) ? &holes[parent] : &(*rho)[parent];
+		}
+		if (hole != nullptr) {
+			Tensor<T>& hPhi = work.HoleBuffer(node, buf);
+			multStateAB(hPhi, *hole, *hKet, true);
+			hKet = &hPhi;
+		}
+		Contraction(holes[node], Bra[parent], *hKet, drop, true);
+	}
+
+	template<typename T>
+	void Contraction(SparseMatrixTree<T>& holes, const TensorTree<T>& Bra,
+		const TensorTree<T>& Ket, const SparseMatrixTree<T>& mats,
+		const MatrixTree<T> *rho, const Tree& tree, TreeWorkspace<T>& work) {
+		assert(work.size() == tree.nNodes());
+		const SparseTree& marker = holes.Active();
+		TreeSweep::TopDown(marker, [&](const Node& node) {
+			if (!node.isToplayer()) {
+				ContractionLocal(holes, Bra, Ket, mats, rho, node, work);
+			} else {
+				Matrix<T>& I = holes[node];
+				I.Zero();
+				for (size_t i = 0; i < I.Dim1(); ++i) { I(i, i) = 1.; }
+			}
+		});
+	}
+
+	template<typename T>
+	void Contraction(SparseMatrixTree<T>& holes, const TensorTree<T>& Bra,
+		const TensorTree<T>& Ket, const SparseMatrixTree<T>& mats,
+		const Tree& tree, TreeWorkspace<T>& work) {
+		const MatrixTree<T> *null = nullptr;
+		Contraction(holes, Bra, Ket, mats, null, tree, work);
+	}
+
+	template<typename T>
+	void Contraction(SparseMatrixTree<T>& holes, const TensorTree<T>& Bra,
+		const TensorTree<T>& Ket, const SparseMatrixTree<T>& mats,
+		const MatrixTree<T>& rho, const Tree& tree, TreeWorkspace<T>& work) {
+		Contraction(holes, Bra, Ket, mats, &rho, tree, work);
+	}
+
+	template<typename T>
+	void Contraction(SparseMatrixTrees<T>& holes, const SparseMatrixTrees<T>& mats,
+		const TensorTree<T>& Bra, const TensorTree<T>& Ket,
+		const Tree& tree, TreeWorkspace<T>& work) {
+		assert(holes.size() == mats.size());
+		for (size_t l = 0; l < holes.size(); ++l) {
+			Contraction(holes[l], Bra, Ket, mats[l], tree, work);
+		}
+	}
+
+	template<typename T>
+	void Contraction(SparseMatrixTrees<T>& holes, const TensorTree<T>& Bra,
+		const TensorTree<T>& Ket, const SparseMatrixTrees<T>& mats,
+		const MatrixTree<T>& rho, const Tree& tree, TreeWorkspace<T>& work) {
+		assert(holes.size() == mats.size());
+		for (size_t l = 0; l < holes.size(); ++l) {
+			Contraction(holes[l], Bra, Ket, mats[l], rho, tree, work);
+		}
+	}
+
+////////////////////////////////////////////////////////////////////////
+/// Parallel SOP sweeps
+////////////////////////////////////////////////////////////////////////
+
+	/// Split the terms into nbins lists of similar cost (longest-processing-time first)
+	template<typename T>
+	vector<vector<size_t>> BalanceTerms(const SparseMatrixTrees<T>& mats, size_t nbins) {
+		vector<pair<size_t, size_t>> costs;
+		for (size_t l = 0; l < mats.size(); ++l) {
+			size_t cost = 0;
+			for (const Node *node : mats[l].Active()) {
+				cost += node->shape().totalDimension();
+			}
+			costs.emplace_back(cost, l);
+		}
+		stable_sort(costs.begin(), costs.end(),
+			[](const pair<size_t, size_t>& a, const pair<size_t, size_t>& b) {
+				return a.first > b.first;
+			});
+
+		vector<vector<size_t>> bins(nbins);
+		vector<size_t> load(nbins, 0);
+		for (const auto& cost : costs) {
+			size_t t = min_element(load.begin(), load.end()) - load.begin();
+			bins[t].push_back(cost.second);
+			load[t] += cost.first;
+		}
+		for (auto& bin : bins) {
+			sort(bin.begin(), bin.end());
+		}
+		return bins;
+	}
+
+	/// Call f(l, workspace) for every term l, distributed over threads
+	template<typename T, class F>
+	void ForEachTerm(const SparseMatrixTrees<T>& mats, TreeWorkspaces<T>& work, F f) {
+		assert(!work.empty());
+		size_t nthreads = 1;
+#ifdef _OPENMP
+		if (!omp_in_parallel()) {
+			nthreads = min(work.size(), (size_t) omp_get_max_threads());
+			nthreads = min(nthreads, mats.size());
+		}
+#endif
+		if (nthreads <= 1) {
+			for (size_t l = 0; l < mats.size(); ++l) {
+				f(l, work.front());
+			}
+			return;
+		}
+
+		vector<vector<size_t>> bins = BalanceTerms(mats, nthreads);
+#pragma omp parallel num_threads(nthreads)
+		{
+#ifdef _OPENMP
+			size_t t = omp_get_thread_num();
+			size_t team = omp_get_num_threads();
+#else
+			size_t t = 0;
+			size_t team = 1;
+#endif
+			for (size_t b = t; b < bins.size(); b += team) {
+				for (size_t l : bins[b]) {
+					f(l, work[t]);
+				}
+			}
+		}
+	}
+
+	template<typename T>
+	void Represent(SparseMatrixTrees<T>& Mats, const SOP<T>& sop,
+		const TensorTree<T>& Bra, const TensorTree<T>& Ket,
+		const Tree& tree, TreeWorkspaces<T>& work) {
+		assert(Mats.size() == sop.size());
+		ForEachTerm(Mats, work, [&](size_t l, TreeWorkspace<T>& w) {
+			Represent(Mats[l], sop[l], Bra, Ket, tree, w);
+		});
+	}
+
+	template<typename T>
+	void Represent(SOPMatrixTrees<T>& mats, const SOP<T>& sop,
+		const TensorTree<T>& Bra, const TensorTree<T>& Ket,
+		const Tree& tree, TreeWorkspaces<T>& work) {
+		assert(mats.size() == sop.size());
+		/// Each term's hole sweep only depends on its own matrices
+		ForEachTerm(mats.matrices_, work, [&](size_t l, TreeWorkspace<T>& w) {
+			Represent(mats.matrices_[l], sop[l], Bra, Ket, tree, w);
+			Contraction(mats.contractions_[l], Bra, Ket, mats.matrices_[l], tree, w);
+		});
+	}
+
+	template<typename T>
+	void Contraction(SparseMatrixTrees<T>& holes, const SparseMatrixTrees<T>& mats,
+		const TensorTree<T>& Bra, const TensorTree<T>& Ket,
+		const Tree& tree, TreeWorkspaces<T>& work) {
+		assert(holes.size() == mats.size());
+		ForEachTerm(holes, work, [&](size_t l, TreeWorkspace<T>& w) {
+			Contraction(holes[l], Bra, Ket, mats[l], tree, w);
+		});
+	}
+
+	template<typename T>
+	void Contraction(SparseMatrixTrees<T>& holes, const TensorTree<T>& Bra,
+		const TensorTree<T>& Ket, const SparseMatrixTrees<T>& mats,
+		const MatrixTree<T>& rho, const Tree& tree, TreeWorkspaces<T>& work) {
+		assert(holes.size() == mats.size());
+		ForEachTerm(holes, work, [&](size_t l, TreeWorkspace<T>& w) {
+			Contraction(holes[l], Bra, Ket, mats[l], rho, tree, w);
+		});
+	}
+
+////////////////////////////////////////////////////////////////////////
+/// SOP sweeps with shared subtrees
+////////////////////////////////////////////////////////////////////////
+
+	template<typename T>
+	void Represent(SparseMatrixTrees<T>& Mats, const SOP<T>& sop,
+		const TensorTree<T>& Bra, const TensorTree<T>& Ket, const SOPSubtreeCache<T>& cache,
+		const Tree& tree, TreeWorkspaces<T>& work) {
+		assert(Mats.size() == sop.size());
+		assert(!work.empty());
+#ifdef _OPENMP
+		size_t nthreads = 1;
+		if (!omp_in_parallel()) {
+			nthreads = min(work.size(), (size_t) omp_get_max_threads());
+		}
+#pragma omp parallel num_threads(nthreads)
+#endif
+		{
+#ifdef _OPENMP
+			size_t t = omp_get_thread_num();
+#else
+			size_t t = 0;
+#endif
+			/// Bottom-up over all nodes; a node needs the matrices of its children in all terms
+			for (const Node& node : tree) {
+				if (node.isToplayer()) { continue; }
+				const auto& groups = cache.Groups(node);
+#pragma omp for schedule(dynamic)
+				for (size_t g = 0; g < groups.size(); ++g) {
+					const auto& group = groups[g];
+					SparseMatrixTree<T>& owner = Mats[group.owner];
+					assert(owner.Active(node));
+					RepresentLayer(owner, Bra[node], Ket[node], sop[group.owner], node, work[t]);
+					for (size_t l : group.shared) {
+						assert(Mats[l].Active(node));
+						Mats[l][node] = owner[node];
+					}
+				}
+			}
+		}
+	}
+
+	template<typename T>
+	void Represent(SOPMatrixTrees<T>& mats, const SOP<T>& sop,
+		const TensorTree<T>& Bra, const TensorTree<T>& Ket, const SOPSubtreeCache<T>& cache,
+		const Tree& tree, TreeWorkspaces<T>& work) {
+		Represent(mats.matrices_, sop, Bra, Ket, cache, tree, work);
+		Contraction(mats.contractions_, mats.matrices_, Bra, Ket, tree, work);
+	}
+
 ////////////////////////////////////////////////////////////////////////
 /// Apply SparseMatrixTree to tensor tree
 ////////////////////////////////////////////////////////////////////////
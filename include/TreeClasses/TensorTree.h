@@ -28,6 +28,14 @@ class TensorTree:
 	 * TensorTreecd Psi(tree);
 	 * Psi.Write("filename.dat");
 	 * TensorTreecd Chi("filename.dat");
+	 *
+	 * Optionally, all node tensors are stored in one contiguous slab
+	 * (InitializeContiguous or MakeContiguous). The tensors are then views into
+	 * the slab; each one starts at a 64-byte aligned offset. Copies of the tree
+	 * are a single block copy and the arithmetic operators (and the Krylov
+	 * traits) work on the whole slab at once. Assigning a tensor of the same
+	 * shape to a node writes into the slab; assigning a different shape moves
+	 * this node out of the slab and the tree is no longer Contiguous().
 	 */
 {
 public:
@@ -50,9 +58,40 @@ public:
 	/// Default destructor
 	~TensorTree() = default;
 
+	/// Copy constructor, a contiguous tree is copied as one block
+	TensorTree(const TensorTree& other);
+
+	TensorTree(TensorTree&& other) noexcept = default;
+
+	TensorTree& operator=(const TensorTree& other);
+
+	TensorTree& operator=(TensorTree&& other) noexcept = default;
+
 	/// Create Tensors for all nodes
 	virtual void Initialize(const Tree& tree);
 
+	/// Create Tensors for all nodes in one contiguous slab
+	void InitializeContiguous(const Tree& tree);
+
+	/// Create zero Tensors of the given shapes (one per node) in one contiguous slab
+	void InitializeContiguous(const vector<TensorShape>& shapes);
+
+	/// Move all tensors into one contiguous slab, the coefficients are kept
+	void MakeContiguous();
+
+	/// True if all tensors are views into the slab
+	bool Contiguous() const;
+
+	/// True if both trees are contiguous with identical tensor shapes
+	bool SameLayout(const TensorTree<T>& other) const;
+
+	/// Slab of a contiguous tree (includes the zero padding between tensors)
+	T *data() { return slab_.get(); }
+
+	const T *data() const { return slab_.get(); }
+
+	size_t dataSize() const { return slabSize_; }
+
 	/// Generate TTs
 	void FillRandom(mt19937& gen, const Tree& tree, bool delta_lowest = true);
 
@@ -72,19 +111,9 @@ public:
 	////////////////////////////////////////////////////////////////////////
 	/// Arithmetic operators
 	////////////////////////////////////////////////////////////////////////
-	TensorTree& operator+=(const TensorTree<T>& R) {
-		for (size_t n = 0; n < attributes_.size(); ++n) {
-			attributes_[n] += R.attributes_[n];
-		}
-		return *this;
-	}
+	TensorTree& operator+=(const TensorTree<T>& R);
 
-	TensorTree& operator-=(const TensorTree<T>& R) {
-		for (size_t n = 0; n < attributes_.size(); ++n) {
-			attributes_[n] -= R.attributes_[n];
-		}
-		return *this;
-	}
+	TensorTree& operator-=(const TensorTree<T>& R);
 
 	TensorTree operator+(const TensorTree<T>& R) {
 		TensorTree<T> S(*this);
@@ -98,17 +127,9 @@ public:
 		return S;
 	}
 
-	void operator*=(T c) {
-		for (auto& A : *this) {
-			A *= c;
-		}
-	}
+	void operator*=(T c);
 
-	void operator/=(T c) {
-		for (auto& A : *this) {
-			A /= c;
-		}
-	}
+	void operator/=(T c);
 
 	TensorTree operator*(T c) {
 		TensorTree<T> S(*this);
@@ -126,6 +147,20 @@ protected:
 	void FillBottom(Tensor<T>& Phi, const Node& node);
 	void FillUpper(Tensor<T>& Phi, std::mt19937& gen,
 		const Node& node, bool delta_lowest = true);
+
+	struct SlabDeleter {
+		void operator()(T *ptr) const { Memory::deallocate(ptr); }
+	};
+
+	/// Allocate a zero slab for tensors of the given shapes and create views into it
+	void AllocateSlab(const vector<TensorShape>& shapes);
+
+	/// Drop the slab; the tensors have to be removed before
+	void ReleaseSlab();
+
+	unique_ptr<T, SlabDeleter> slab_;
+	size_t slabSize_{0};
+	vector<size_t> offsets_;
 };
 
 typedef TensorTree<complex<double>> TensorTreecd;
@@ -138,6 +173,42 @@ void Orthogonal(TensorTree<T>& Psi, const Tree& tree);
 template <typename T>
 void Orthonormal(TensorTree<T>& Psi, const Tree& tree);
 
+namespace TreeFunctions {
+	/**
+	 * Whole-tree BLAS-1 operations (LAKernels). Contiguous trees with the same
+	 * layout are processed as one array, otherwise node by node. None of them
+	 * allocates, except LinearCombination into a tree of a different layout.
+	 */
+	/// x = alpha * x
+	template <typename T>
+	void Scal(TensorTree<T>& x, T alpha);
+
+	/// y += alpha * x
+	template <typename T>
+	void Axpy(TensorTree<T>& y, T alpha, const TensorTree<T>& x);
+
+	/// y = alpha * x + beta * y
+	template <typename T>
+	void Axpby(TensorTree<T>& y, T alpha, const TensorTree<T>& x, T beta);
+
+	/// y += alpha * x + beta * z
+	template <typename T>
+	void Axpbz(TensorTree<T>& y, T alpha, const TensorTree<T>& x, T beta, const TensorTree<T>& z);
+
+	/// y = alpha * x + beta * z, e.g. the Runge-Kutta stage y = Psi + k / 2 into a reused y
+	template <typename T>
+	void LinearCombination(TensorTree<T>& y, T alpha, const TensorTree<T>& x,
+		T beta, const TensorTree<T>& z);
+
+	/// sum over all nodes of <x_n|y_n>
+	template <typename T>
+	T Dot(const TensorTree<T>& x, const TensorTree<T>& y);
+
+	/// sqrt(Dot(x, x))
+	template <typename T>
+	double Nrm2(const TensorTree<T>& x);
+}
+
 template<typename T>
 ostream& operator<<(ostream& os, const TensorTree<T>& t);
 template<typename T>
@@ -0,0 +1,109 @@
+#ifndef TENSORTREECHECKPOINT_H
+#define TENSORTREECHECKPOINT_H
+#include "TreeClasses/TensorTree.h"
+
+/**
+ * \brief Binary checkpoint format for TensorTrees.
+ *
+ * All numbers are little-endian. The file consists of
+ *  - a 64-byte header: magic "QTREECKP", version, scalar type, flags,
+ *    number of nodes, size of the index, offset and size of the data block,
+ *  - the index: per node the byte offset of its tensor in the data block,
+ *    a CRC-32 of the coefficients (0 if the file has no CRCs), the order
+ *    and the dimensions of the tensor,
+ *  - the data block, which starts at a 64-byte aligned file offset. Every
+ *    tensor starts at a 64-byte aligned offset within the block.
+ * The data block has the layout of a contiguous TensorTree slab. Contiguous
+ * trees are therefore written and read with a single write/read, and a
+ * memory-mapped file can be used directly (MappedTensorTree).
+ *
+ * Usage:
+ * Checkpoint::Write(Psi, "psi.ckp");
+ * TensorTreecd Chi;
+ * Checkpoint::Read(Chi, "psi.ckp");
+ */
+namespace Checkpoint {
+	/// Current version of the format. Files of newer versions are rejected.
+	constexpr uint32_t version = 1;
+
+	/// Header and index of a checkpoint file
+	struct Index {
+		uint32_t version{0};
+		uint32_t scalar{0};          ///< 1: double, 2: complex<double>
+		bool crc{false};             ///< True if the index holds CRC-32s
+		uint64_t dataOffset{0};      ///< File offset of the data block
+		uint64_t dataSize{0};        ///< Size of the data block in bytes
+		vector<TensorShape> shapes;
+		vector<uint64_t> offsets;    ///< Byte offsets of the tensors in the data block
+		vector<uint32_t> crcs;
+	};
+
+	/// CRC-32 (IEEE 802.3) of size bytes, continuing from crc
+	uint32_t CRC32(const void *data, size_t size, uint32_t crc = 0);
+
+	/// Read header and index; the stream is left at the end of the index
+	Index ReadIndex(istream& is);
+
+	/// Check the scalar type and that the tensors fit aligned into the data block
+	template<typename T>
+	void CheckIndex(const Index& idx);
+
+	/// Write Psi in the checkpoint format, optionally with a CRC-32 per node
+	template<typename T>
+	void Write(const TensorTree<T>& Psi, ostream& os, bool crc = true);
+
+	template<typename T>
+	void Write(const TensorTree<T>& Psi, const string& filename, bool crc = true);
+
+	/// Create a file without CRCs for zero tensors of the given shapes (sparse on most file systems)
+	template<typename T>
+	Index Create(const vector<TensorShape>& shapes, const string& filename);
+
+	/// Read into a contiguous Psi. With verify, the CRCs (if present) are checked.
+	template<typename T>
+	void Read(TensorTree<T>& Psi, istream& is, bool verify = true);
+
+	template<typename T>
+	void Read(TensorTree<T>& Psi, const string& filename, bool verify = true);
+}
+
+template<typename T>
+class MappedTensorTree
+	/**
+	 * \class MappedTensorTree
+	 * \ingroup Tree
+	 * \brief Memory-mapped checkpoint file.
+	 *
+	 * The tensors of Psi() are views into the mapping, nothing is copied on
+	 * construction. Pages are loaded when they are first touched. The mapping
+	 * is private: Psi() can be modified, but changes are not written to the
+	 * file. Psi() is only valid as long as the MappedTensorTree exists.
+	 *
+	 * Usage:
+	 * MappedTensorTree<complex<double>> map("psi.ckp");
+	 * const TensorTreecd& Psi = map.Psi();
+	 */
+{
+public:
+	explicit MappedTensorTree(const string& filename, bool verify = false);
+
+	~MappedTensorTree();
+
+	MappedTensorTree(const MappedTensorTree&) = delete;
+
+	MappedTensorTree& operator=(const MappedTensorTree&) = delete;
+
+	TensorTree<T>& Psi() { return Psi_; }
+
+	const TensorTree<T>& Psi() const { return Psi_; }
+
+	const Checkpoint::Index& Index() const { return index_; }
+
+private:
+	void *map_{nullptr};
+	size_t size_{0};
+	Checkpoint::Index index_;
+	TensorTree<T> Psi_;
+};
+
+#endif //TENSORTREECHECKPOINT_H
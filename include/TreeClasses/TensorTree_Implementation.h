@@ -3,6 +3,7 @@
 //
 #include "TensorTree.h"
 #include "Core/Tensor_Extension.h"
+#include "Core/LAKernels.h"
 
 template<typename T>
 TensorTree<T>::TensorTree(const Tree& tree) {
@@ -27,9 +28,115 @@ TensorTree<T>::TensorTree(std::mt19937& gen, const Tree& tree, bool delta_lowest
 	FillRandom(gen, tree, delta_lowest);
 }
 
+template<typename T>
+TensorTree<T>::TensorTree(const TensorTree& other) {
+	*this = other;
+}
+
+template<typename T>
+TensorTree<T>& TensorTree<T>::operator=(const TensorTree& other) {
+	if (this == &other) { return *this; }
+	if (other.Contiguous()) {
+		if (!SameLayout(other)) {
+			vector<TensorShape> shapes;
+			for (const Tensor<T>& Phi : other.attributes_) {
+				shapes.push_back(Phi.shape());
+			}
+			attributes_.clear();
+			AllocateSlab(shapes);
+		}
+		copy(other.data(), other.data() + slabSize_, data());
+	} else {
+		attributes_.clear();
+		ReleaseSlab();
+		attributes_ = other.attributes_;
+	}
+	return *this;
+}
+
+template<typename T>
+void TensorTree<T>::AllocateSlab(const vector<TensorShape>& shapes) {
+	ReleaseSlab();
+	/// Every tensor starts at an aligned offset
+	size_t align = max(Memory::alignment / sizeof(T), (size_t) 1);
+	offsets_.clear();
+	slabSize_ = 0;
+	for (const TensorShape& shape : shapes) {
+		offsets_.push_back(slabSize_);
+		slabSize_ += (shape.totalDimension() + align - 1) / align * align;
+	}
+	slab_.reset(Memory::allocate<T>(max(slabSize_, (size_t) 1)));
+	fill(slab_.get(), slab_.get() + slabSize_, T(0.));
+	attributes_.clear();
+	for (size_t n = 0; n < shapes.size(); ++n) {
+		attributes_.emplace_back(Tensor<T>(shapes[n], slab_.get() + offsets_[n], false, false));
+	}
+}
+
+template<typename T>
+void TensorTree<T>::ReleaseSlab() {
+	slab_.reset();
+	slabSize_ = 0;
+	offsets_.clear();
+}
+
+template<typename T>
+void TensorTree<T>::InitializeContiguous(const Tree& tree) {
+	vector<TensorShape> shapes;
+	for (const Node& node : tree) {
+		shapes.push_back(node.shape());
+	}
+	InitializeContiguous(shapes);
+}
+
+template<typename T>
+void TensorTree<T>::InitializeContiguous(const vector<TensorShape>& shapes) {
+	attributes_.clear();
+	AllocateSlab(shapes);
+}
+
+template<typename T>
+void TensorTree<T>::MakeContiguous() {
+	if (Contiguous()) { return; }
+	vector<Tensor<T>> old(move(attributes_));
+	vector<TensorShape> shapes;
+	for (const Tensor<T>& Phi : old) {
+		shapes.push_back(Phi.shape());
+	}
+	/// The old tensors may be views into the old slab, so it is released last
+	auto oldslab = move(slab_);
+	AllocateSlab(shapes);
+	for (size_t n = 0; n < old.size(); ++n) {
+		attributes_[n] = old[n];
+	}
+}
+
+template<typename T>
+bool TensorTree<T>::Contiguous() const {
+	if (!slab_ || offsets_.size() != attributes_.size()) { return false; }
+	for (size_t n = 0; n < attributes_.size(); ++n) {
+		const Tensor<T>& Phi = attributes_[n];
+		if (&Phi[0] != slab_.get() + offsets_[n]) { return false; }
+		size_t end = (n + 1 < offsets_.size()) ? offsets_[n + 1] : slabSize_;
+		if (offsets_[n] + Phi.shape().totalDimension() > end) { return false; }
+	}
+	return true;
+}
+
+template<typename T>
+bool TensorTree<T>::SameLayout(const TensorTree<T>& other) const {
+	if (!Contiguous() || !other.Contiguous()) { return false; }
+	if (offsets_ != other.offsets_ || slabSize_ != other.slabSize_) { return false; }
+	for (size_t n = 0; n < attributes_.size(); ++n) {
+		if (attributes_[n].shape() != other.attributes_[n].shape()) { return false; }
+	}
+	return true;
+}
+
 template<typename T>
 void TensorTree<T>::Initialize(const Tree& tree) {
 	attributes_.clear();
+	ReleaseSlab();
 	for (const Node& node : tree) {
 		attributes_.emplace_back(Tensor<T>(node.shape()));
 	}
@@ -120,11 +227,14 @@ void TensorTree<T>::Read(istream& is) {
 	is.read((char *) &nnodes, sizeof(nnodes));
 
 	// Read all Tensors
+	bool contiguous = Contiguous();
 	attributes_.clear();
+	ReleaseSlab();
 	for (int i = 0; i < nnodes; i++) {
 		Tensor<T> Phi(is);
 		attributes_.emplace_back(Phi);
 	}
+	if (contiguous) { MakeContiguous(); }
 }
 
 template<typename T>
@@ -173,6 +283,145 @@ void Orthonormal(TensorTree<T>& Psi, const Tree& tree) {
 	}
 }
 
+////////////////////////////////////////////////////////////////////////
+/// Arithmetic operators
+////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+TensorTree<T>& TensorTree<T>::operator+=(const TensorTree<T>& R) {
+	TreeFunctions::Axpy(*this, (T) 1., R);
+	return *this;
+}
+
+template<typename T>
+TensorTree<T>& TensorTree<T>::operator-=(const TensorTree<T>& R) {
+	TreeFunctions::Axpy(*this, (T) -1., R);
+	return *this;
+}
+
+template<typename T>
+void TensorTree<T>::operator*=(T c) {
+	TreeFunctions::Scal(*this, c);
+}
+
+template<typename T>
+void TensorTree<T>::operator/=(T c) {
+	TreeFunctions::Scal(*this, (T) 1. / c);
+}
+
+namespace TreeFunctions {
+	template<typename T>
+	void Scal(TensorTree<T>& x, T alpha) {
+		if (x.Contiguous()) {
+			LAKernels::vscal(x.data(), alpha, x.dataSize());
+			return;
+		}
+		for (Tensor<T>& A : x) {
+			LAKernels::vscal(&A[0], alpha, A.shape().totalDimension());
+		}
+	}
+
+	template<typename T>
+	void Axpy(TensorTree<T>& y, T alpha, const TensorTree<T>& x) {
+		assert(y.size() == x.size());
+		if (y.SameLayout(x)) {
+			LAKernels::vaxpy(y.data(), x.data(), alpha, y.dataSize());
+			return;
+		}
+		for (size_t n = 0; n < y.size(); ++n) {
+			Tensor<T>& Y = y.begin()[n];
+			const Tensor<T>& X = x.begin()[n];
+			assert(Y.shape().totalDimension() == X.shape().totalDimension());
+			LAKernels::vaxpy(&Y[0], &X[0], alpha, Y.shape().totalDimension());
+		}
+	}
+
+	template<typename T>
+	void Axpby(TensorTree<T>& y, T alpha, const TensorTree<T>& x, T beta) {
+		assert(y.size() == x.size());
+		if (y.SameLayout(x)) {
+			LAKernels::vaxpby(y.data(), x.data(), alpha, beta, y.dataSize());
+			return;
+		}
+		for (size_t n = 0; n < y.size(); ++n) {
+			Tensor<T>& Y = y.begin()[n];
+			const Tensor<T>& X = x.begin()[n];
+			assert(Y.shape().totalDimension() == X.shape().totalDimension());
+			LAKernels::vaxpby(&Y[0], &X[0], alpha, beta, Y.shape().totalDimension());
+		}
+	}
+
+	template<typename T>
+	void Axpbz(TensorTree<T>& y, T alpha, const TensorTree<T>& x, T beta, const TensorTree<T>& z) {
+		assert(y.size() == x.size() && y.size() == z.size());
+		if (y.SameLayout(x) && y.SameLayout(z)) {
+			LAKernels::vaxpbz(y.data(), x.data(), alpha, z.data(), beta, y.dataSize());
+			return;
+		}
+		for (size_t n = 0; n < y.size(); ++n) {
+			Tensor<T>& Y = y.begin()[n];
+			const Tensor<T>& X = x.begin()[n];
+			const Tensor<T>& Z = z.begin()[n];
+			assert(Y.shape().totalDimension() == X.shape().totalDimension());
+			assert(Y.shape().totalDimension() == Z.shape().totalDimension());
+			LAKernels::vaxpbz(&Y[0], &X[0], alpha, &Z[0], beta, Y.shape().totalDimension());
+		}
+	}
+
+	template<typename T>
+	void LinearCombination(TensorTree<T>& y, T alpha, const TensorTree<T>& x,
+		T beta, const TensorTree<T>& z) {
+		assert(x.size() == z.size());
+		if (&y != &x && &y != &z) {
+			/// Reuse the memory of y if the shapes fit
+			bool fits = (y.size() == x.size());
+			for (size_t n = 0; fits && n < y.size(); ++n) {
+				fits = (y.begin()[n].shape() == x.begin()[n].shape());
+			}
+			if (!fits) { y = x; }
+		}
+		if (y.SameLayout(x) && y.SameLayout(z)) {
+			LAKernels::vlincomb(y.data(), x.data(), alpha, z.data(), beta, y.dataSize());
+			return;
+		}
+		for (size_t n = 0; n < y.size(); ++n) {
+			Tensor<T>& Y = y.begin()[n];
+			const Tensor<T>& X = x.begin()[n];
+			const Tensor<T>& Z = z.begin()[n];
+			assert(Y.shape().totalDimension() == Z.shape().totalDimension());
+			LAKernels::vlincomb(&Y[0], &X[0], alpha, &Z[0], beta, Y.shape().totalDimension());
+		}
+	}
+
+	template<typename T>
+	T Dot(const TensorTree<T>& x, const TensorTree<T>& y) {
+		assert(x.size() == y.size());
+		if (x.SameLayout(y)) {
+			return LAKernels::vdot(x.data(), y.data(), x.dataSize());
+		}
+		T s = 0.;
+		for (size_t n = 0; n < x.size(); ++n) {
+			const Tensor<T>& X = x.begin()[n];
+			const Tensor<T>& Y = y.begin()[n];
+			assert(X.shape().totalDimension() == Y.shape().totalDimension());
+			s += LAKernels::vdot(&X[0], &Y[0], X.shape().totalDimension());
+		}
+		return s;
+	}
+
+	template<typename T>
+	double Nrm2(const TensorTree<T>& x) {
+		if (x.Contiguous()) {
+			return LAKernels::vnrm2(x.data(), x.dataSize());
+		}
+		double s = 0.;
+		for (const Tensor<T>& A : x) {
+			s += pow(LAKernels::vnrm2(&A[0], A.shape().totalDimension()), 2);
+		}
+		return sqrt(s);
+	}
+}
+
 template<typename T>
 ostream& operator<<(ostream& os, const TensorTree<T>& t) {
 	t.Write(os);
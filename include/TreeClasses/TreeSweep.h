@@ -0,0 +1,168 @@
+#ifndef TREESWEEP_H
+#define TREESWEEP_H
+#include "TreeShape/Tree.h"
+#include "TreeClasses/SparseTree.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * \namespace TreeSweep
+ * \ingroup Tree
+ * \brief Dependency-driven traversal of a Tree.
+ *
+ * BottomUp calls f(node) after f has returned for all children of node,
+ * TopDown calls f(node) after f has returned for its parent. Sibling
+ * subtrees are independent and are processed as concurrent OpenMP tasks.
+ * f has to write only to data that belongs to "node"; then the result does
+ * not depend on the schedule. Outside of OpenMP, with a single thread, or
+ * if called from inside a parallel region, the tree is traversed serially
+ * in the usual (reverse) order of the Tree iterators.
+ * The SparseTree overloads only visit the active nodes of a SparseTree;
+ * a node only depends on its active children (parent, respectively), so
+ * disconnected parts of a SparseTree are independent as well.
+ *
+ * Usage:
+ * TreeSweep::BottomUp(tree, [&](const Node& node) { DotProductLocal(S, Bra[node], Ket[node], node); });
+ */
+namespace TreeSweep {
+
+	namespace detail {
+#ifdef _OPENMP
+		inline bool runParallel(size_t nNodes) {
+			return (nNodes > 2) && (omp_get_max_threads() > 1) && !omp_in_parallel();
+		}
+#else
+		inline bool runParallel(size_t) {
+			return false;
+		}
+#endif
+
+		/// Visits all nodes for which active(node) holds; their children are
+		/// assumed to be active only if the parent is.
+		template<class F, class A>
+		void BottomUpTask(const Node& node, F& f, const A& active) {
+			/// The last active child is processed by the current task
+			const Node *last = nullptr;
+			int nChildren = node.isBottomlayer() ? 0 : node.nChildren();
+			for (int k = 0; k < nChildren; ++k) {
+				const Node *child = &node.child(k);
+				if (!active(*child)) { continue; }
+				if (last != nullptr) {
+#pragma omp task firstprivate(last) shared(f, active)
+					BottomUpTask(*last, f, active);
+				}
+				last = child;
+			}
+			if (last != nullptr) { BottomUpTask(*last, f, active); }
+#pragma omp taskwait
+			f(node);
+		}
+
+		template<class F, class A>
+		void TopDownTask(const Node& node, F& f, const A& active) {
+			f(node);
+			const Node *last = nullptr;
+			int nChildren = node.isBottomlayer() ? 0 : node.nChildren();
+			for (int k = 0; k < nChildren; ++k) {
+				const Node *child = &node.child(k);
+				if (!active(*child)) { continue; }
+				if (last != nullptr) {
+#pragma omp task firstprivate(last) shared(f, active)
+					TopDownTask(*last, f, active);
+				}
+				last = child;
+			}
+			if (last != nullptr) { TopDownTask(*last, f, active); }
+		}
+
+		struct AllNodes {
+			bool operator()(const Node&) const { return true; }
+		};
+
+		struct SparseNodes {
+			bool operator()(const Node& node) const { return stree.Active(node); }
+			const SparseTree& stree;
+		};
+
+		/// Active nodes without an active parent
+		inline bool isRoot(const Node& node, const SparseTree& stree) {
+			return node.isToplayer() || !stree.Active(node.parent());
+		}
+	}
+
+	/// Call f(node) for every node in the tree, children before parents
+	template<class F>
+	void BottomUp(const Tree& tree, F f) {
+		if (detail::runParallel(tree.nNodes())) {
+			detail::AllNodes active;
+#pragma omp parallel
+#pragma omp single
+			detail::BottomUpTask(tree.TopNode(), f, active);
+		} else {
+			for (const Node& node : tree) {
+				f(node);
+			}
+		}
+	}
+
+	/// Call f(node) for every node in the tree, parents before children
+	template<class F>
+	void TopDown(const Tree& tree, F f) {
+		if (detail::runParallel(tree.nNodes())) {
+			detail::AllNodes active;
+#pragma omp parallel
+#pragma omp single
+			detail::TopDownTask(tree.TopNode(), f, active);
+		} else {
+			for (auto it = tree.rbegin(); it != tree.rend(); it++) {
+				const Node& node = *it;
+				f(node);
+			}
+		}
+	}
+
+	/// Call f(node) for every active node, children before parents
+	template<class F>
+	void BottomUp(const SparseTree& stree, F f) {
+		if (stree.size() == 0) { return; }
+		if (detail::runParallel(stree.size())) {
+			detail::SparseNodes active{stree};
+#pragma omp parallel
+#pragma omp single
+			for (size_t n = 0; n < stree.size(); ++n) {
+				const Node *root = &stree.MCTDHNode(n);
+				if (!detail::isRoot(*root, stree)) { continue; }
+#pragma omp task firstprivate(root) shared(f, active)
+				detail::BottomUpTask(*root, f, active);
+			}
+		} else {
+			for (size_t n = 0; n < stree.size(); ++n) {
+				f(stree.MCTDHNode(n));
+			}
+		}
+	}
+
+	/// Call f(node) for every active node, parents before children
+	template<class F>
+	void TopDown(const SparseTree& stree, F f) {
+		if (stree.size() == 0) { return; }
+		if (detail::runParallel(stree.size())) {
+			detail::SparseNodes active{stree};
+#pragma omp parallel
+#pragma omp single
+			for (size_t n = 0; n < stree.size(); ++n) {
+				const Node *root = &stree.MCTDHNode(n);
+				if (!detail::isRoot(*root, stree)) { continue; }
+#pragma omp task firstprivate(root) shared(f, active)
+				detail::TopDownTask(*root, f, active);
+			}
+		} else {
+			for (int n = stree.size() - 1; n >= 0; --n) {
+				f(stree.MCTDHNode(n));
+			}
+		}
+	}
+}
+
+#endif //TREESWEEP_H
@@ -0,0 +1,67 @@
+#ifndef TREEWORKSPACE_H
+#define TREEWORKSPACE_H
+#include "TreeShape/Tree.h"
+#include <array>
+
+template<typename T>
+class TreeWorkspace
+/**
+ * \class TreeWorkspace
+ * \ingroup Tree
+ * \brief Preallocated scratch tensors for tree sweeps.
+ *
+ * Every node owns two buffers with the shape of the node and, except for
+ * the top node, two buffers with the shape of its parent. Bottom-up sweeps
+ * (DotProduct, Represent) ping-pong between the node buffers, top-down sweeps
+ * (Contraction) between the hole buffers. After construction the workspace
+ * overloads in TreeFunctions do not allocate, so one workspace should be kept
+ * alive and reused for all sweeps over the same tree.
+ *
+ * Usage:
+ * TreeWorkspace<cd> work(tree);
+ * for (...) { TreeFunctions::DotProduct(S, Psi, Chi, tree, work); }
+ * */
+{
+public:
+	TreeWorkspace() = default;
+
+	explicit TreeWorkspace(const Tree& tree);
+
+	~TreeWorkspace() = default;
+
+	/// Allocate all buffers for the shapes in "tree"
+	void Initialize(const Tree& tree);
+
+	/// Buffer i (0 or 1) with the shape of "node"
+	Tensor<T>& Buffer(const Node& node, size_t i) {
+		assert(node.Address() < buffers_.size());
+		assert(i < 2);
+		return buffers_[node.Address()][i];
+	}
+
+	/// Buffer i (0 or 1) with the shape of the parent of "node"
+	Tensor<T>& HoleBuffer(const Node& node, size_t i) {
+		assert(!node.isToplayer());
+		assert(node.Address() < holes_.size());
+		assert(i < 2);
+		return holes_[node.Address()][i];
+	}
+
+	size_t size() const { return buffers_.size(); }
+
+private:
+	vector<array<Tensor<T>, 2>> buffers_;
+	vector<array<Tensor<T>, 2>> holes_;
+};
+
+typedef TreeWorkspace<complex<double>> TreeWorkspacecd;
+typedef TreeWorkspace<double> TreeWorkspaced;
+
+/// One workspace per thread for the parallel SOP sweeps
+template<typename T>
+using TreeWorkspaces = vector<TreeWorkspace<T>>;
+
+typedef TreeWorkspaces<complex<double>> TreeWorkspacescd;
+typedef TreeWorkspaces<double> TreeWorkspacesd;
+
+#endif //TREEWORKSPACE_H
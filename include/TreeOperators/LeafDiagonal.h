@@ -0,0 +1,47 @@
+#ifndef LEAFDIAGONAL_H
+#define LEAFDIAGONAL_H
+#include "LeafOperator.h"
+#include "Core/Matrix.h"
+
+template<typename T>
+class LeafDiagonal: public LeafOperator<T>
+	/**
+	 * \class LeafDiagonal
+	 * \ingroup Operators
+	 * \brief LeafOperator that is diagonal in the primitive basis.
+	 *
+	 * Potentials, x and x^2 are diagonal in a DVR. Applying the operator
+	 * scales every row of the bottom-layer tensor, O(dim) per column instead
+	 * of O(dim^2) for the equivalent LeafMatrix.
+	 *
+	 * Usage:
+	 * Vectorcd v(dim);  // potential on the grid points
+	 * MLOcd M(LeafDiagonalcd(v), leaf.Mode());
+	 */
+{
+public:
+	LeafDiagonal() = default;
+
+	explicit LeafDiagonal(Vector<T> d);
+
+	~LeafDiagonal() = default;
+
+	virtual void Apply(const LeafInterface& grid, Tensor<T>& hAcoeff,
+		const Tensor<T>& Acoeff) const override;
+
+	const Vector<T>& diag() const { return d_; }
+
+	size_t Dim() const { return d_.Dim(); }
+
+	/// Dense matrix with diag() on the diagonal
+	Matrix<T> Dense() const;
+
+private:
+	Vector<T> d_;
+};
+
+typedef LeafDiagonal<complex<double>> LeafDiagonalcd;
+
+typedef LeafDiagonal<double> LeafDiagonald;
+
+#endif //LEAFDIAGONAL_H
@@ -0,0 +1,72 @@
+#ifndef LEAFSPARSEMATRIX_H
+#define LEAFSPARSEMATRIX_H
+#include "LeafOperator.h"
+#include "Core/Matrix.h"
+
+template<typename T>
+class LeafSparseMatrix: public LeafOperator<T>
+	/**
+	 * \class LeafSparseMatrix
+	 * \ingroup Operators
+	 * \brief LeafOperator from a sparse matrix in compressed sparse row format.
+	 *
+	 * Spin ladder operators and creation/annihilation operators have a few
+	 * entries per row. Applying the operator costs O(nnz) per column of the
+	 * bottom-layer tensor instead of O(dim1 * dim2).
+	 *
+	 * The entries of row i are val()[p] in column col()[p] for
+	 * rowPtr()[i] <= p < rowPtr()[i + 1].
+	 *
+	 * Usage:
+	 * LeafSparseMatrixcd a(A);  // drops the zeros of a Matrixcd
+	 * MLOcd M(a, leaf.Mode());
+	 */
+{
+public:
+	LeafSparseMatrix() = default;
+
+	/// Keep the entries of h with |h(i, j)| > eps
+	explicit LeafSparseMatrix(const Matrix<T>& h, double eps = 0.);
+
+	LeafSparseMatrix(size_t dim1, size_t dim2, vector<size_t> rowPtr,
+		vector<size_t> col, vector<T> val);
+
+	~LeafSparseMatrix() = default;
+
+	virtual void Apply(const LeafInterface& grid, Tensor<T>& hAcoeff,
+		const Tensor<T>& Acoeff) const override;
+
+	/// Number of stored entries
+	size_t nnz() const { return val_.size(); }
+
+	size_t Dim1() const { return dim1_; }
+
+	size_t Dim2() const { return dim2_; }
+
+	const vector<size_t>& rowPtr() const { return rowPtr_; }
+
+	const vector<size_t>& col() const { return col_; }
+
+	const vector<T>& val() const { return val_; }
+
+	Matrix<T> Dense() const;
+
+	/// diag(d) * this
+	void ScaleRows(const Vector<T>& d);
+
+	/// this * diag(d)
+	void ScaleColumns(const Vector<T>& d);
+
+private:
+	size_t dim1_{0};
+	size_t dim2_{0};
+	vector<size_t> rowPtr_{0};
+	vector<size_t> col_;
+	vector<T> val_;
+};
+
+typedef LeafSparseMatrix<complex<double>> LeafSparseMatrixcd;
+
+typedef LeafSparseMatrix<double> LeafSparseMatrixd;
+
+#endif //LEAFSPARSEMATRIX_H
@@ -5,6 +5,8 @@
 #include "LeafOperator.h"
 #include "LeafFunction.h"
 #include "LeafMatrix.h"
+#include "LeafDiagonal.h"
+#include "LeafSparseMatrix.h"
 #include "PotentialOperator.h"
 
 template <typename T>
@@ -33,7 +35,8 @@ public:
 	/// Default destructor
 	~MultiLeafOperator() = default;
 
-	MultiLeafOperator(const shared_ptr<LeafOperator<T>>& h, size_t leaf_id) {
+	MultiLeafOperator(const shared_ptr<LeafOperator<T>>& h, size_t leaf_id)
+		: MultiLeafOperator() {
 		push_back(h, leaf_id);
 	}
 
@@ -48,6 +51,18 @@ public:
 		push_back(h, leaf_id, adjoint);
 	}
 
+	/// Construct a MLO from a single diagonal SPO
+	MultiLeafOperator(const LeafDiagonal<T>& h, size_t leaf_id)
+		: MultiLeafOperator() {
+		push_back(h, leaf_id);
+	}
+
+	/// Construct a MLO from a single sparse SPO
+	MultiLeafOperator(const LeafSparseMatrix<T>& h, size_t leaf_id)
+		: MultiLeafOperator() {
+		push_back(h, leaf_id);
+	}
+
 	/// Construct a MLO from a single RefSPO
 	MultiLeafOperator(const LeafFunction<T>& h, size_t leaf_id)
 		: MultiLeafOperator() {
@@ -68,10 +83,21 @@ public:
 	Tensor<T> ApplyBottomLayer(Tensor<T> Acoeffs,
 		const vector<int>& list, const LeafInterface& grid) const;
 
+	/**
+	 * \brief Apply the MLO at a bottom-layer node without allocating.
+	 *
+	 * work1 and work2 need the shape of Phi and are used as ping-pong buffers.
+	 * Returns the tensor that holds the result (Phi if no SPO acts on the leaf).
+	 */
+	const Tensor<T>& ApplyBottomLayer(const Tensor<T>& Phi, Tensor<T>& work1,
+		Tensor<T>& work2, const Leaf& leaf) const;
+
 	/// Push back a SPO to the MLO
 	void push_back(shared_ptr<LeafOperator<T>> h, size_t mode_x) {
 		leafOperators_.push_back(h);
 		targetLeaves_.push_back(mode_x);
+		compiled_ = false;
+		steps_.clear();
 	}
 
 	void push_back(const LeafMatrix<T>& h, size_t mode) {
@@ -86,6 +112,14 @@ public:
 		}
 	}
 
+	void push_back(const LeafDiagonal<T>& h, size_t mode) {
+		push_back(make_shared<LeafDiagonal<T>>(h), mode);
+	}
+
+	void push_back(const LeafSparseMatrix<T>& h, size_t mode) {
+		push_back(make_shared<LeafSparseMatrix<T>>(h), mode);
+	}
+
 	/// Push back a RefSPO to the MLO
 	void push_back(const LeafFunction<T>& h, size_t mode) {
 		push_back(make_shared<LeafFunction<T>>(h), mode);
@@ -132,6 +166,33 @@ public:
 		return (targetLeaves_[part] == mode_x);
 	}
 
+	/**
+	 * \brief Precompute the application of the MLO at every leaf of tree.
+	 *
+	 * The SPOs of every leaf are collected once. Runs of consecutive
+	 * LeafMatrix, LeafDiagonal and LeafSparseMatrix factors and LeafFunctions
+	 * that are diagonal on the leaf (probed on the primitive basis) are
+	 * fused: only diagonal factors give a single scaling pass, a sparse
+	 * matrix absorbs the diagonals next to it and stays sparse, otherwise one
+	 * matrix (h3 * h2 * h1) is applied. Other SPOs are applied one after
+	 * another, as before. ApplyBottomLayer and ApplyReference use the
+	 * compiled form until push_back is called. Leaves whose dimension differs
+	 * from the compiled one are applied without the compiled form.
+	 *
+	 * The compiled form holds copies of the SPOs. Changing a SPO through
+	 * operator()(i) (or through a shared_ptr that is also held elsewhere)
+	 * requires calling Compile again.
+	 */
+	void Compile(const Tree& tree);
+
+	bool Compiled() const { return compiled_; }
+
+	/// Number of passes over the bottom-layer tensor at leaf "mode_x" after Compile
+	size_t nCompiledSteps(size_t mode_x) const {
+		assert(compiled_);
+		return (mode_x < steps_.size()) ? steps_[mode_x].size() : 0;
+	}
+
 	/// Apply a MLO to a wavefunction.
 	void ApplyReference(TensorTree<T>& Psi, const Tree& tree) const;
 
@@ -179,6 +240,24 @@ public:
 	}
 
 protected:
+	/// One pass of a compiled leaf: a fused matrix, a diagonal, or a SPO that is called (e.g. sparse)
+	struct LeafStep {
+		Matrix<T> h;
+		Vector<T> diag;
+		shared_ptr<LeafOperator<T>> spo;
+		bool diagonal{false};
+	};
+
+	/// True if leaf is applied with the compiled steps
+	bool UseCompiled(const Leaf& leaf) const {
+		return compiled_ && leaf.Mode() < compiledDims_.size()
+			&& compiledDims_[leaf.Mode()] == leaf.Dim();
+	}
+
+	/// Apply the compiled steps; in and the result may be work1 or work2
+	const Tensor<T>& ApplySteps(const vector<LeafStep>& steps, const LeafInterface& grid,
+		const Tensor<T>& Phi, Tensor<T>& work1, Tensor<T>& work2) const;
+
 	/// These are the SPOs
 	vector<shared_ptr<LeafOperator<T>>> leafOperators_;
 	/// These are the modes the SPOs act on
@@ -187,6 +266,11 @@ protected:
 	PotentialOperator v_;
 	/// Is there a PotentialOperator?
 	bool hasV_;
+	/// Compiled SPOs per leaf mode
+	bool compiled_{false};
+	vector<vector<LeafStep>> steps_;
+	/// Leaf dimensions the steps were compiled for (0: not compiled)
+	vector<size_t> compiledDims_;
 };
 
 template <typename T>
@@ -58,6 +58,13 @@ public:
 		coeff_.push_back(coeff);
 	}
 
+	/// Compile all MLOs for the leaves of tree (see MultiLeafOperator::Compile)
+	void Compile(const Tree& tree) {
+		for (MLO<T>& M : mpos_) {
+			M.Compile(tree);
+		}
+	}
+
 	complex<double> Coeff(size_t i) const {
 		assert(i < coeff_.size());
 		return coeff_[i];
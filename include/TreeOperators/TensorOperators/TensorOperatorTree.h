@@ -15,6 +15,7 @@ public:
 	TensorOperatorTree() = default;
 	explicit TensorOperatorTree(const Tree& tree);
 	TensorOperatorTree(const MLOcd& M, const Tree& tree);
+	/// Exact representation of a SOP, see TreeFunctions::Compress for truncation
 	TensorOperatorTree(const SOPcd& S, const Tree& tree);
 
 	~TensorOperatorTree() = default;
@@ -17,6 +17,25 @@ namespace TreeFunctions {
 	MatrixListTree Contraction(const TensorTreecd& Psi, const TensorOperatorTree& H,
 		MatrixListTree& Hrep, const Tree& tree);
 
+	/// Bring all nodes except the top node into orthonormal form (bottom-up SVD)
+	void Orthonormalize(TensorOperatorTree& H, const Tree& tree);
+
+	/**
+	 * \brief Truncate the operator ranks of H to a given accuracy.
+	 *
+	 * H is orthonormalized and every edge is projected onto the dominant
+	 * left singular vectors of the operator matricized at that edge
+	 * (hierarchical SVD, singular values from Tensor_Extension::SVD). At every
+	 * edge, singular values are discarded as long as their squared sum stays
+	 * below (eps * |H|)^2, where |H| is the Frobenius norm of the operator.
+	 * The error of the compressed operator is therefore bounded by
+	 * sqrt(nEdges) * eps * |H|.
+	 */
+	void Compress(TensorOperatorTree& H, const Tree& tree, double eps);
+
+	/// Build a TensorOperatorTree of minimal rank for the SOP within accuracy eps
+	TensorOperatorTree Compress(const SOPcd& S, const Tree& tree, double eps);
+
 }
 
 #endif //TENSOROPERATORTREEFUNCTIONS_H
@@ -3,6 +3,7 @@
 #include "Core/Matrix.h"
 #include "Core/Vector.h"
 #include "Core/Tensor.h"
+#include "Util/FFT.h"
 
 class FFTGrid :
 	public LeafInterface
@@ -29,9 +30,18 @@ public:
 
 protected:
 	
+	/// Phase exp(-i (x_i - x0) p0) / sqrt(dim) and FFT in place, mode 0
+	void Forward(Tensorcd& A) const;
+
+	/// Inverse of Forward
+	void Backward(Tensorcd& A) const;
+
 	Vectord x_;
 	Vectord p_;
-	Matrixcd trafo_;
+	Vectorcd phase_;
+
+	/// Transform of a single column, created in Initialize
+	FFTPlan plan_;
 
 	double x0_, x1_, wfr0_, wfomega_;
 
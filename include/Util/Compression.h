@@ -0,0 +1,44 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+#include "Core/stdafx.h"
+
+/**
+ * \brief Fast lossless compression of coefficient blocks (used for checkpoints).
+ *
+ * Codecs:
+ *  - none:    bytes are stored as they are,
+ *  - builtin: byte shuffle (all first bytes of the elements, then all second
+ *             bytes, ...) followed by an LZ77 compressor with LZ4-style
+ *             sequences. Always available. The shuffle groups the slowly
+ *             varying sign/exponent bytes of doubles, which makes them
+ *             compressible.
+ *  - zstd:    zstd level 1 (CMake option QuTree_ZSTD),
+ *  - lz4:     LZ4 (CMake option QuTree_LZ4).
+ * zstd and lz4 are applied after the same byte shuffle.
+ */
+namespace Compression {
+	enum class Codec : uint32_t {
+		none = 0, builtin = 1, zstd = 2, lz4 = 3
+	};
+
+	/// True if the library was built with the codec
+	bool Available(Codec codec);
+
+	/// Fastest available codec with a good ratio: zstd, then lz4, then builtin
+	Codec Default();
+
+	string Name(Codec codec);
+
+	/**
+	 * \brief Compress size bytes of data.
+	 * @param elementSize size of one number for the byte shuffle (1: no shuffle)
+	 * @return compressed bytes, decompress with the same codec and elementSize
+	 */
+	vector<char> Compress(const void *data, size_t size, Codec codec, size_t elementSize = 1);
+
+	/// Decompress into out, which has to hold exactly outSize bytes
+	void Decompress(const char *in, size_t inSize, void *out, size_t outSize,
+		Codec codec, size_t elementSize = 1);
+}
+
+#endif //COMPRESSION_H
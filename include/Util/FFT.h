@@ -1,7 +1,78 @@
 #pragma once
 #include "Core/Tensor.h"
 
+class FFTPlan
+	/**
+	 * \class FFTPlan
+	 * \brief Planned, batched, in-place FFT.
+	 *
+	 * A plan fixes the size n and the layout of a batch: howmany vectors,
+	 * element j of vector v at data[v * dist + j * stride]. The size dependent
+	 * part (factorization, twiddle factors, Bluestein chirp) is computed once
+	 * per size and shared by all plans of that size.
+	 *
+	 * Sizes are factorized into radix 4, 2, 3, 5, 7 (and 11, 13) and
+	 * transformed with the self-sorting Stockham algorithm, so no bit reversal
+	 * is needed. Sizes with larger prime factors use Bluestein's algorithm
+	 * with a power-of-two convolution. Interleaved batches (stride == howmany,
+	 * dist == 1), as found along the inner modes of a tensor, are transformed
+	 * together: the butterflies then run over contiguous memory and vectorize.
+	 *
+	 * Transforms are not normalized; sign = -1 is the forward transform
+	 * sum_j exp(-2 pi i jk / n) x_j. Execute() is const and uses thread-local
+	 * work space, so a plan can be used by several threads at once.
+	 *
+	 * Usage:
+	 * FFTPlan plan(A.shape(), 0);
+	 * plan.Execute(A, -1);
+	 */
+{
+public:
+	FFTPlan() = default;
+
+	/// howmany vectors of length n; dist = 0 means n * stride
+	explicit FFTPlan(size_t n, size_t howmany = 1, size_t stride = 1, size_t dist = 0);
+
+	/// All vectors along mode of a tensor with this shape
+	FFTPlan(const TensorShape& shape, size_t mode);
+
+	/// Transform the planned batch in place
+	void Execute(complex<double> *data, int sign) const;
+
+	void Execute(Tensorcd& A, int sign) const;
+
+	size_t size() const { return n_; }
+
+	/// Number of vectors that are transformed by Execute()
+	size_t nVectors() const { return howmany_ * nBlocks_; }
+
+	const vector<size_t>& factors() const;
+
+	/// True if the size has prime factors that need Bluestein's algorithm
+	bool Bluestein() const;
+
+	struct Kernel;
+
+private:
+	void Transform(complex<double> *data, int sign) const;
+
+	shared_ptr<const Kernel> kernel_;
+	size_t n_{0};
+	size_t howmany_{0};
+	size_t stride_{1};
+	size_t dist_{0};
+	size_t nBlocks_{1};
+	size_t blockDist_{0};
+};
+
 class FFT
+	/**
+	 * \class FFT
+	 * \brief Normalized FFT of all columns of a Tensor.
+	 *
+	 * The columns of length lastBefore() are transformed and normalized with
+	 * 1 / sqrt(n). Plans are cheap to create, so no state is kept.
+	 */
 {
 public:
 
@@ -10,23 +81,13 @@ public:
 
 	Tensorcd forwardFFT(const Tensorcd& in){return generalFFT(in, -1);}
 	Tensorcd backwardFFT(const Tensorcd& in){return generalFFT(in, 1);}
-	
-protected:
-	//fouriertransforms a Tensor statewise
-	Tensorcd generalFFT(const Tensorcd& in, const int sign);
-	Tensorcd factor2FFT(const Tensorcd& in, const int sign);
-	Tensorcd dft(const Tensorcd& in, const int sign);
-	
-	//rearanges the complex number of each vector
-	//The state_ indeces lable the vectors
-	Tensorcd reverseOrder(const Tensorcd& in);
 
-	//execute the fft
-	void danielsonLanczosAlgorithm(Tensorcd& in, const int sign);
+	/// In place versions of forwardFFT and backwardFFT
+	void forward(Tensorcd& A) { transform(A, -1); }
+	void backward(Tensorcd& A) { transform(A, 1); }
 
-	//calculates the next bigger potens of two
-	size_t getGoodSize(size_t size);
+protected:
+	Tensorcd generalFFT(const Tensorcd& in, const int sign);
 
-	//perform prime factorization
-	vector<size_t> primeFactorization(size_t number) const;
+	void transform(Tensorcd& A, const int sign);
 };
@@ -0,0 +1,168 @@
+#ifndef KRYLOVSPACE_H
+#define KRYLOVSPACE_H
+#include "Core/Tensor.h"
+#include "Core/LAKernels.h"
+#include "TreeClasses/TensorTree.h"
+#include <fstream>
+
+/**
+ * \defgroup Krylov
+ * \brief Krylov subspace methods (Lanczos) for general vector types.
+ *
+ * The Krylov methods only access vectors through KrylovTraits<Vec>, so any
+ * type can be used once the traits are specialized. Specializations are
+ * provided for Tensor<T> and TensorTree<T>. A TensorTree is treated as the
+ * direct sum of its node tensors, i.e. as the vector of all coefficients.
+ */
+
+template<class Vec>
+struct KrylovTraits;
+
+namespace Krylov {
+	inline double Conj(double x) { return x; }
+
+	inline complex<double> Conj(complex<double> x) { return conj(x); }
+}
+
+template<typename T>
+struct KrylovTraits<Tensor<T>> {
+	typedef T value_type;
+
+	static T Dot(const Tensor<T>& a, const Tensor<T>& b) {
+		assert(a.shape().totalDimension() == b.shape().totalDimension());
+		return LAKernels::vdot(&a[0], &b[0], a.shape().totalDimension());
+	}
+
+	static void Axpy(Tensor<T>& y, T alpha, const Tensor<T>& x) {
+		assert(y.shape().totalDimension() == x.shape().totalDimension());
+		LAKernels::vaxpy(&y[0], &x[0], alpha, y.shape().totalDimension());
+	}
+
+	static void Scale(Tensor<T>& x, T alpha) { x *= alpha; }
+
+	/// Raw coefficients only, the shape is known from the vector read into
+	static void Write(const Tensor<T>& x, ostream& os) {
+		os.write((const char *) &x[0], x.shape().totalDimension() * sizeof(T));
+	}
+
+	static void Read(Tensor<T>& x, istream& is) {
+		is.read((char *) &x[0], x.shape().totalDimension() * sizeof(T));
+	}
+};
+
+template<typename T>
+struct KrylovTraits<TensorTree<T>> {
+	typedef T value_type;
+
+	static T Dot(const TensorTree<T>& a, const TensorTree<T>& b) { return TreeFunctions::Dot(a, b); }
+
+	static void Axpy(TensorTree<T>& y, T alpha, const TensorTree<T>& x) { TreeFunctions::Axpy(y, alpha, x); }
+
+	static void Scale(TensorTree<T>& x, T alpha) { TreeFunctions::Scal(x, alpha); }
+
+	static void Write(const TensorTree<T>& x, ostream& os) {
+		for (const Tensor<T>& Phi : x) {
+			KrylovTraits<Tensor<T>>::Write(Phi, os);
+		}
+	}
+
+	static void Read(TensorTree<T>& x, istream& is) {
+		for (Tensor<T>& Phi : x) {
+			KrylovTraits<Tensor<T>>::Read(Phi, is);
+		}
+	}
+};
+
+template<class Vec>
+class KrylovStorage
+/**
+ * \class KrylovStorage
+ * \ingroup Krylov
+ * \brief Storage for the basis vectors of a Krylov space.
+ *
+ * By default the vectors are kept in memory. If a filename is given, the
+ * vectors are written to this file instead (out-of-core) and only the vector
+ * that is currently accessed is held in memory. All vectors must have the
+ * same shape.
+ *
+ * Usage:
+ * KrylovStorage<Tensorcd> V("krylov.tmp");
+ * V.push_back(v);
+ * const Tensorcd& w = V.Get(0, buffer);
+ * */
+{
+public:
+	typedef KrylovTraits<Vec> Traits;
+
+	KrylovStorage() = default;
+
+	explicit KrylovStorage(const string& filename)
+		: filename_(filename) {
+		if (!filename_.empty()) {
+			file_.open(filename_, ios::in | ios::out | ios::binary | ios::trunc);
+			if (!file_.is_open()) {
+				cerr << "Cannot open Krylov storage file " << filename_ << endl;
+				exit(1);
+			}
+		}
+	}
+
+	~KrylovStorage() {
+		if (file_.is_open()) {
+			file_.close();
+			remove(filename_.c_str());
+		}
+	}
+
+	KrylovStorage(const KrylovStorage&) = delete;
+
+	KrylovStorage& operator=(const KrylovStorage&) = delete;
+
+	bool OutOfCore() const { return !filename_.empty(); }
+
+	size_t size() const { return n_; }
+
+	void clear() {
+		n_ = 0;
+		vectors_.clear();
+	}
+
+	/// Store v as vector i (i <= size())
+	void Set(size_t i, const Vec& v) {
+		assert(i <= n_);
+		if (OutOfCore()) {
+			file_.seekp(Offset(i));
+			Traits::Write(v, file_);
+			if (i == 0) {
+				record_ = (size_t) file_.tellp();
+			}
+		} else if (i < vectors_.size()) {
+			vectors_[i] = v;
+		} else {
+			vectors_.push_back(v);
+		}
+		n_ = max(n_, i + 1);
+	}
+
+	void push_back(const Vec& v) { Set(n_, v); }
+
+	/// Vector i; out-of-core it is read into buffer, which needs the right shape
+	const Vec& Get(size_t i, Vec& buffer) {
+		assert(i < n_);
+		if (!OutOfCore()) { return vectors_[i]; }
+		file_.seekg(Offset(i));
+		Traits::Read(buffer, file_);
+		return buffer;
+	}
+
+private:
+	streamoff Offset(size_t i) const { return (streamoff) (i * record_); }
+
+	string filename_;
+	fstream file_;
+	size_t record_{0};
+	size_t n_{0};
+	vector<Vec> vectors_;
+};
+
+#endif //KRYLOVSPACE_H
@@ -0,0 +1,393 @@
+#ifndef LANCZOS_H
+#define LANCZOS_H
+#include "Util/KrylovSpace.h"
+#include "Core/Matrix.h"
+#include "Core/Vector.h"
+#include <functional>
+#include <limits>
+
+template<class Vec>
+class Lanczos
+/**
+ * \class Lanczos
+ * \ingroup Krylov
+ * \brief Thick-restart block Lanczos solver for the lowest eigenpairs of a hermitian operator.
+ *
+ * The operator is only accessed through apply(HV, V); HV has the shape of V on
+ * entry. Vectors can be of any type with KrylovTraits, e.g. Tensor<T> or
+ * TensorTree<T>. The block size is the number of start vectors.
+ *
+ * - Block Lanczos: every iteration extends the basis by one block. Columns that
+ *   become linearly dependent are dropped (deflation).
+ * - Thick restart: once maxKrylov vectors are reached, the basis is contracted
+ *   to the lowest Ritz vectors and the Lanczos recursion continues from them.
+ * - Reorthogonalization: Full (against all basis vectors, default), Selective
+ *   (against converged Ritz vectors, Parlett & Scott) or None (three-term
+ *   recursion only). Selective keeps the basis semi-orthogonal: eigenvalues
+ *   are accurate, but the residuals of the eigenvectors level off at about
+ *   sqrt(machine eps) * |H|. It avoids reading the whole basis every iteration,
+ *   which matters most for out-of-core storage.
+ * - Out-of-core: if Parameters::storage is a filename, the Krylov vectors are
+ *   kept in this file. Only the current blocks (and the Ritz vectors while
+ *   restarting) are held in memory.
+ *
+ * Usage:
+ * Lanczos<Tensorcd>::Parameters par;
+ * par.nEigen = 3;
+ * Lanczos<Tensorcd> lanczos(apply, par);
+ * lanczos.Solve({Psi0, Psi1});
+ * lanczos.Eigenvalues().print();
+ * */
+{
+public:
+	typedef KrylovTraits<Vec> Traits;
+	typedef typename Traits::value_type T;
+	typedef function<void(Vec&, const Vec&)> Apply;
+
+	enum class Reorthogonalization {
+		None, Selective, Full
+	};
+
+	struct Parameters {
+		size_t nEigen{1};      ///< Number of lowest eigenpairs
+		size_t maxKrylov{60};  ///< Maximum number of Krylov vectors before restarting
+		size_t maxRestarts{50};
+		double tolerance{1e-10}; ///< Convergence threshold for |H y - theta y|
+		Reorthogonalization reorthogonalization{Reorthogonalization::Full};
+		string storage;        ///< File for out-of-core Krylov vectors (empty: in memory)
+	};
+
+	Lanczos(Apply apply, Parameters par)
+		: apply_(move(apply)), par_(move(par)), V_(par_.storage) {}
+
+	~Lanczos() = default;
+
+	/// Calculate the lowest eigenpairs. Returns true if all of them converged.
+	bool Solve(const vector<Vec>& start);
+
+	/// Lowest nEigen eigenvalues
+	const Vectord& Eigenvalues() const { return eigenvalues_; }
+
+	/// Eigenvectors for Eigenvalues()
+	const vector<Vec>& Eigenvectors() const { return eigenvectors_; }
+
+	/// Residual norms |H y - theta y| of the eigenpairs, estimated from the recursion
+	const Vectord& Residuals() const { return residuals_; }
+
+	/// Number of operator applications in the last Solve
+	size_t nApply() const { return nApply_; }
+
+	size_t nRestarts() const { return nRestarts_; }
+
+private:
+	/// Vector i of the basis, current block is taken from memory
+	const Vec& Basis(size_t i);
+
+	/// Gram-Schmidt among Q (twice), drops dependent columns, B(c, b) = <Q_c|W_b>
+	void BlockQR(vector<Vec>& W, Matrix<T>& B, double scale);
+
+	/// Orthogonalize W against the basis vectors [begin, end), optionally writing T
+	void Orthogonalize(vector<Vec>& W, size_t begin, size_t end, bool setT);
+
+	/// Diagonalize T on the first m basis vectors
+	void RayleighRitz(size_t m);
+
+	/// Residual norms of the Ritz pairs for the block that follows the first m vectors
+	Vectord RitzResiduals(size_t m, size_t nNext) const;
+
+	/// y_i = sum_a S(a, i) V_a for i < n
+	vector<Vec> RitzVectors(size_t m, size_t n);
+
+	/// Add converged Ritz vectors to good_ (selective reorthogonalization)
+	void SelectGood(size_t m, const Vectord& res);
+
+	/// Store the lowest Ritz pairs of the first m basis vectors as result
+	void Finish(size_t m, const Vectord& res);
+
+	Apply apply_;
+	Parameters par_;
+	KrylovStorage<Vec> V_;
+
+	Matrix<T> T_;        ///< Projected operator in the Krylov basis
+	Matrix<T> S_;        ///< Ritz vectors of T_
+	Vectord theta_;      ///< Ritz values of T_
+	vector<Vec> cur_;    ///< Current block
+	size_t curStart_{0}; ///< Index of the current block in V_
+	Vec buffer_;
+
+	vector<Vec> good_;   ///< Converged Ritz vectors for selective reorthogonalization
+	vector<double> goodTheta_;
+
+	Vectord eigenvalues_;
+	Vectord residuals_;
+	vector<Vec> eigenvectors_;
+	size_t nApply_{0};
+	size_t nRestarts_{0};
+};
+
+template<class Vec>
+const Vec& Lanczos<Vec>::Basis(size_t i) {
+	if (i >= curStart_ && i < curStart_ + cur_.size()) {
+		return cur_[i - curStart_];
+	}
+	return V_.Get(i, buffer_);
+}
+
+template<class Vec>
+void Lanczos<Vec>::Orthogonalize(vector<Vec>& W, size_t begin, size_t end, bool setT) {
+	for (size_t a = begin; a < end; ++a) {
+		const Vec& v = Basis(a);
+		for (size_t b = 0; b < W.size(); ++b) {
+			T t = Traits::Dot(v, W[b]);
+			Traits::Axpy(W[b], -t, v);
+			if (setT) {
+				size_t j = curStart_ + b;
+				T_(a, j) = t;
+				T_(j, a) = Krylov::Conj(t);
+			}
+		}
+	}
+}
+
+template<class Vec>
+void Lanczos<Vec>::BlockQR(vector<Vec>& W, Matrix<T>& B, double scale) {
+	size_t p = W.size();
+	B = Matrix<T>(p, p);
+	vector<Vec> Q;
+	vector<size_t> kept;
+	for (size_t b = 0; b < p; ++b) {
+		Vec& w = W[b];
+		for (size_t pass = 0; pass < 2; ++pass) {
+			for (size_t c = 0; c < Q.size(); ++c) {
+				T r = Traits::Dot(Q[c], w);
+				Traits::Axpy(w, -r, Q[c]);
+				B(c, b) += r;
+			}
+		}
+		double norm = sqrt(abs(Traits::Dot(w, w)));
+		if (norm <= 1e-12 * scale) { continue; }
+		B(Q.size(), b) = norm;
+		Traits::Scale(w, 1. / norm);
+		Q.emplace_back(move(w));
+	}
+	Matrix<T> Bk(Q.size(), p);
+	for (size_t b = 0; b < p; ++b) {
+		for (size_t c = 0; c < Q.size(); ++c) {
+			Bk(c, b) = B(c, b);
+		}
+	}
+	B = Bk;
+	W = move(Q);
+}
+
+template<class Vec>
+void Lanczos<Vec>::RayleighRitz(size_t m) {
+	Matrix<T> Tm(m, m);
+	for (size_t j = 0; j < m; ++j) {
+		for (size_t i = 0; i < m; ++i) {
+			Tm(i, j) = 0.5 * (T_(i, j) + Krylov::Conj(T_(j, i)));
+		}
+	}
+	auto x = Diagonalize(Tm);
+	S_ = x.first;
+	theta_ = x.second;
+}
+
+template<class Vec>
+Vectord Lanczos<Vec>::RitzResiduals(size_t m, size_t nNext) const {
+	/// H V = V T + Q_next T(next, :), so |H y_i - theta_i y_i| = |T(next, :) s_i|
+	Vectord res(m);
+	for (size_t i = 0; i < m; ++i) {
+		double r = 0.;
+		for (size_t c = 0; c < nNext; ++c) {
+			T x = 0.;
+			for (size_t a = 0; a < m; ++a) {
+				x += T_(m + c, a) * S_(a, i);
+			}
+			r += pow(abs(x), 2);
+		}
+		res(i) = sqrt(r);
+	}
+	return res;
+}
+
+template<class Vec>
+vector<Vec> Lanczos<Vec>::RitzVectors(size_t m, size_t n) {
+	vector<Vec> Y;
+	for (size_t a = 0; a < m; ++a) {
+		const Vec& v = Basis(a);
+		for (size_t i = 0; i < n; ++i) {
+			if (a == 0) {
+				Y.push_back(v);
+				Traits::Scale(Y[i], S_(a, i));
+			} else {
+				Traits::Axpy(Y[i], S_(a, i), v);
+			}
+		}
+	}
+	return Y;
+}
+
+template<class Vec>
+void Lanczos<Vec>::SelectGood(size_t m, const Vectord& res) {
+	double normT = max(abs(theta_(0)), abs(theta_(m - 1)));
+	double threshold = sqrt(numeric_limits<double>::epsilon()) * max(normT, 1.);
+	vector<size_t> select;
+	for (size_t i = 0; i < m; ++i) {
+		if (res(i) > threshold) { continue; }
+		bool known = false;
+		for (double t : goodTheta_) {
+			if (abs(t - theta_(i)) <= threshold) { known = true; }
+		}
+		if (!known) { select.push_back(i); }
+	}
+	if (select.empty()) { return; }
+
+	for (size_t a = 0; a < m; ++a) {
+		const Vec& v = Basis(a);
+		for (size_t s = 0; s < select.size(); ++s) {
+			size_t i = select[s];
+			if (a == 0) {
+				good_.push_back(v);
+				goodTheta_.push_back(theta_(i));
+				Traits::Scale(good_.back(), S_(a, i));
+			} else {
+				Traits::Axpy(good_[good_.size() - select.size() + s], S_(a, i), v);
+			}
+		}
+	}
+}
+
+template<class Vec>
+bool Lanczos<Vec>::Solve(const vector<Vec>& start) {
+	assert(!start.empty());
+	size_t p = start.size();
+	size_t nEigen = par_.nEigen;
+	if (par_.maxKrylov < nEigen + 2 * p) {
+		cerr << "Lanczos: maxKrylov has to be at least nEigen + 2 * block size.\n";
+		exit(1);
+	}
+
+	nApply_ = 0;
+	nRestarts_ = 0;
+	V_.clear();
+	good_.clear();
+	goodTheta_.clear();
+	size_t dim = par_.maxKrylov + p;
+	T_ = Matrix<T>(dim, dim);
+	buffer_ = start.front();
+
+	/// Orthonormal start block
+	cur_ = start;
+	Matrix<T> B;
+	BlockQR(cur_, B, 1.);
+	if (cur_.size() < p) {
+		cerr << "Lanczos: start vectors are linearly dependent.\n";
+		exit(1);
+	}
+	curStart_ = 0;
+	for (const Vec& q : cur_) { V_.push_back(q); }
+	size_t couplingStart = 0;
+
+	while (true) {
+		/// Extend Krylov space by one block
+		vector<Vec> W(cur_);
+		for (size_t b = 0; b < cur_.size(); ++b) {
+			apply_(W[b], cur_[b]);
+			nApply_++;
+		}
+		size_t m = curStart_ + cur_.size();
+		Orthogonalize(W, couplingStart, m, true);
+		if (par_.reorthogonalization == Reorthogonalization::Full) {
+			Orthogonalize(W, 0, m, false);
+		} else if (par_.reorthogonalization == Reorthogonalization::Selective) {
+			for (const Vec& y : good_) {
+				for (Vec& w : W) {
+					Traits::Axpy(w, -Traits::Dot(y, w), y);
+				}
+			}
+		}
+
+		RayleighRitz(m);
+		double scale = max(max(abs(theta_(0)), abs(theta_(m - 1))), 1e-300);
+		BlockQR(W, B, scale);
+		for (size_t b = 0; b < B.Dim2(); ++b) {
+			for (size_t c = 0; c < B.Dim1(); ++c) {
+				T_(m + c, curStart_ + b) = B(c, b);
+				T_(curStart_ + b, m + c) = Krylov::Conj(B(c, b));
+			}
+		}
+
+		/// Convergence of the lowest Ritz pairs
+		Vectord res = RitzResiduals(m, W.size());
+		bool converged = (m >= nEigen);
+		for (size_t i = 0; i < min(nEigen, m); ++i) {
+			if (res(i) > par_.tolerance) { converged = false; }
+		}
+		if (W.empty() && m < nEigen) {
+			cerr << "Lanczos: invariant subspace is smaller than the number of eigenpairs.\n";
+			exit(1);
+		}
+		if (converged || W.empty()) {
+			Finish(m, res);
+			return true;
+		}
+
+		if (par_.reorthogonalization == Reorthogonalization::Selective) {
+			SelectGood(m, res);
+		}
+
+		if (m + 2 * W.size() <= par_.maxKrylov) {
+			for (const Vec& w : W) { V_.Set(V_.size(), w); }
+			couplingStart = curStart_;
+			curStart_ = m;
+			cur_ = move(W);
+			continue;
+		}
+
+		/// Thick restart with the lowest Ritz vectors
+		if (nRestarts_ == par_.maxRestarts) {
+			/// Not converged, keep the current approximation
+			Finish(m, res);
+			return false;
+		}
+		nRestarts_++;
+		size_t k = min(max(nEigen, m / 2), par_.maxKrylov - 2 * W.size());
+		vector<Vec> Y = RitzVectors(m, k);
+		Matrix<T> Tnew(dim, dim);
+		for (size_t i = 0; i < k; ++i) {
+			Tnew(i, i) = theta_(i);
+			for (size_t c = 0; c < W.size(); ++c) {
+				T x = 0.;
+				for (size_t a = 0; a < m; ++a) {
+					x += T_(m + c, a) * S_(a, i);
+				}
+				Tnew(k + c, i) = x;
+				Tnew(i, k + c) = Krylov::Conj(x);
+			}
+		}
+		T_ = Tnew;
+		V_.clear();
+		for (const Vec& y : Y) { V_.push_back(y); }
+		for (const Vec& w : W) { V_.push_back(w); }
+		good_.clear();
+		goodTheta_.clear();
+		couplingStart = 0;
+		curStart_ = k;
+		cur_ = move(W);
+	}
+}
+
+template<class Vec>
+void Lanczos<Vec>::Finish(size_t m, const Vectord& res) {
+	size_t n = min(par_.nEigen, m);
+	eigenvectors_ = RitzVectors(m, n);
+	eigenvalues_ = Vectord(n);
+	residuals_ = Vectord(n);
+	for (size_t i = 0; i < n; ++i) {
+		eigenvalues_(i) = theta_(i);
+		residuals_(i) = res(i);
+	}
+}
+
+#endif //LANCZOS_H
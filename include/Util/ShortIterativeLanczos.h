@@ -0,0 +1,201 @@
+#ifndef SHORTITERATIVELANCZOS_H
+#define SHORTITERATIVELANCZOS_H
+#include "Util/KrylovSpace.h"
+#include "Core/Matrix.h"
+#include "Core/Vector.h"
+#include <functional>
+#include <type_traits>
+
+template<class Vec>
+class ShortIterativeLanczos
+/**
+ * \class ShortIterativeLanczos
+ * \ingroup Krylov
+ * \brief Short-iterative-Lanczos (SIL) propagator for psi(t + dt) = exp(-i H dt) psi(t).
+ *
+ * In every step a small Krylov space is built from psi. The Krylov space grows
+ * until the a-posteriori error estimate
+ *   err(dt) = |psi| * beta_k * |(exp(-i T_k dt))_{k-1, 0}|
+ * drops below the tolerance (adaptive order). If maxOrder is reached first, the
+ * step size is reduced until the estimate is met, which requires no further
+ * applications of H. The step size grows as long as fewer than maxOrder
+ * vectors are needed and is then predicted from err ~ dt^k.
+ *
+ * H is hermitian and only accessed through apply(HV, V); HV has the shape of V
+ * on entry. Any vector type with complex KrylovTraits can be propagated, e.g. the
+ * top-node Tensorcd or a whole TensorTreecd.
+ *
+ * Usage:
+ * ShortIterativeLanczos<Tensorcd> sil(apply, par);
+ * sil.Integrate(Psi, t, t_end, dt);
+ * */
+{
+public:
+	typedef KrylovTraits<Vec> Traits;
+	typedef typename Traits::value_type T;
+	typedef function<void(Vec&, const Vec&)> Apply;
+	static_assert(is_same<T, complex<double>>::value, "SIL propagation requires complex vectors.");
+
+	struct Parameters {
+		size_t minOrder{3};
+		size_t maxOrder{20};
+		double tolerance{1e-10}; ///< Maximum error per step (relative to |psi|)
+		double maxStep{1e10};
+		double grow{2.};       ///< Maximum increase of the step size per step
+	};
+
+	ShortIterativeLanczos(Apply apply, Parameters par)
+		: apply_(move(apply)), par_(par) {
+		assert(par_.minOrder >= 1);
+		assert(par_.maxOrder >= par_.minOrder);
+	}
+
+	~ShortIterativeLanczos() = default;
+
+	/**
+	 * \brief Propagate psi by at most dt.
+	 * @param psi wavefunction, propagated in place
+	 * @param dt requested step size
+	 * @return step size that was taken (<= dt)
+	 */
+	double Step(Vec& psi, double dt);
+
+	/// Propagate psi from t to t_end. dt is the initial step size and returns the predicted next one.
+	void Integrate(Vec& psi, double& t, double t_end, double& dt);
+
+	/// Step size predicted for the next step
+	double NextStep() const { return next_; }
+
+	/// Krylov order of the last step
+	size_t Order() const { return order_; }
+
+	/// Total number of H applications
+	size_t nApply() const { return nApply_; }
+
+	size_t nSteps() const { return nSteps_; }
+
+private:
+	/// Coefficients of exp(-i T_k dt) e_0 in the Krylov basis
+	Vectorcd KrylovCoefficients(size_t k, double dt) const;
+
+	/// err(dt) for Krylov order k
+	double Error(size_t k, double dt, double norm) const;
+
+	Apply apply_;
+	Parameters par_;
+
+	vector<Vec> q_;     ///< Lanczos vectors
+	vector<double> alpha_;
+	vector<double> beta_;
+	Matrixd U_;         ///< Eigenvectors of T_k
+	Vectord lambda_;    ///< Eigenvalues of T_k
+
+	double next_{0.};
+	size_t order_{0};
+	size_t nApply_{0};
+	size_t nSteps_{0};
+};
+
+template<class Vec>
+Vectorcd ShortIterativeLanczos<Vec>::KrylovCoefficients(size_t k, double dt) const {
+	Vectorcd c(k);
+	for (size_t n = 0; n < k; ++n) {
+		T phase = exp(T(0., -lambda_(n) * dt)) * U_(0, n);
+		for (size_t j = 0; j < k; ++j) {
+			c(j) += U_(j, n) * phase;
+		}
+	}
+	return c;
+}
+
+template<class Vec>
+double ShortIterativeLanczos<Vec>::Error(size_t k, double dt, double norm) const {
+	Vectorcd c = KrylovCoefficients(k, dt);
+	return norm * beta_[k - 1] * abs(c(k - 1));
+}
+
+template<class Vec>
+double ShortIterativeLanczos<Vec>::Step(Vec& psi, double dt) {
+	double norm = sqrt(abs(Traits::Dot(psi, psi)));
+	if (norm == 0.) { return dt; }
+	double tol = par_.tolerance * norm;
+
+	if (q_.empty()) { q_.push_back(psi); }
+	q_[0] = psi;
+	Traits::Scale(q_[0], 1. / norm);
+	alpha_.clear();
+	beta_.clear();
+
+	size_t k = 0;
+	double err = 0.;
+	while (true) {
+		/// Next Lanczos vector with full reorthogonalization
+		if (q_.size() == k + 1) { q_.push_back(q_[k]); }
+		Vec& w = q_[k + 1];
+		apply_(w, q_[k]);
+		nApply_++;
+		alpha_.push_back(real(Traits::Dot(q_[k], w)));
+		Traits::Axpy(w, -alpha_[k], q_[k]);
+		if (k > 0) { Traits::Axpy(w, -beta_[k - 1], q_[k - 1]); }
+		for (size_t j = 0; j <= k; ++j) {
+			Traits::Axpy(w, -Traits::Dot(q_[j], w), q_[j]);
+		}
+		beta_.push_back(sqrt(abs(Traits::Dot(w, w))));
+		k++;
+
+		Matrixd Tk(k, k);
+		for (size_t j = 0; j < k; ++j) {
+			Tk(j, j) = alpha_[j];
+			if (j + 1 < k) {
+				Tk(j, j + 1) = beta_[j];
+				Tk(j + 1, j) = beta_[j];
+			}
+		}
+		auto x = Diagonalize(Tk);
+		U_ = x.first;
+		lambda_ = x.second;
+
+		/// Invariant subspace: the step is exact
+		bool exact = (beta_[k - 1] <= 1e-14 * max(abs(lambda_(0)), abs(lambda_(k - 1))));
+		err = exact ? 0. : Error(k, dt, norm);
+		if ((err <= tol && k >= par_.minOrder) || exact) { break; }
+		if (k == par_.maxOrder) {
+			/// Shrink the step size, err ~ dt^k
+			for (size_t n = 0; n < 50 && err > tol; ++n) {
+				dt *= 0.9 * pow(tol / err, 1. / (double) k);
+				err = Error(k, dt, norm);
+			}
+			break;
+		}
+		Traits::Scale(w, 1. / beta_[k - 1]);
+	}
+	order_ = k;
+
+	/// psi = |psi| * sum_j c_j q_j
+	Vectorcd c = KrylovCoefficients(k, dt);
+	psi = q_[0];
+	Traits::Scale(psi, norm * c(0));
+	for (size_t j = 1; j < k; ++j) {
+		Traits::Axpy(psi, norm * c(j), q_[j]);
+	}
+
+	/// Grow the step until maxOrder is needed, then follow err ~ dt^k
+	double factor = par_.grow;
+	if (order_ == par_.maxOrder && err > 0.) {
+		factor = min(factor, 0.9 * pow(tol / err, 1. / (double) k));
+	}
+	next_ = min(dt * max(factor, 0.1), par_.maxStep);
+	nSteps_++;
+	return dt;
+}
+
+template<class Vec>
+void ShortIterativeLanczos<Vec>::Integrate(Vec& psi, double& t, double t_end, double& dt) {
+	while (t_end - t > 1e-12 * max(abs(t_end), 1.)) {
+		double h = min(dt, t_end - t);
+		t += Step(psi, h);
+		if (h == dt || next_ < dt) { dt = next_; }
+	}
+}
+
+#endif //SHORTITERATIVELANCZOS_H
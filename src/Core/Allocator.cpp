@@ -0,0 +1,271 @@
+#include "Core/Allocator.h"
+#include <atomic>
+#include <array>
+#include <cstdlib>
+#include <cstdint>
+
+namespace Memory {
+
+	//////////////////////////////////////////////////////////////////////
+	// Block layout
+	//////////////////////////////////////////////////////////////////////
+	/// Every block is preceded by one alignment unit that stores its origin
+	struct Header {
+		uint32_t magic;
+		uint32_t sizeClass;
+		Arena *owner;
+	};
+	static_assert(sizeof(Header) <= alignment, "Header has to fit into one alignment unit");
+
+	constexpr uint32_t magicNumber = 0x51547265;
+	constexpr uint32_t arenaClass = UINT32_MAX;
+	constexpr uint32_t largeClass = UINT32_MAX - 1;
+
+	/// Size classes: 64 bytes, then four classes per power of two up to 2^28 bytes
+	constexpr size_t minExponent = 6;
+	constexpr size_t maxExponent = 28;
+	constexpr size_t nClasses = 1 + 4 * (maxExponent - minExponent);
+
+	size_t roundUp(size_t bytes) {
+		return ((bytes + alignment - 1) / alignment) * alignment;
+	}
+
+	uint32_t sizeClass(size_t bytes) {
+		if (bytes <= (1 << minExponent)) { return 0; }
+		size_t v = bytes - 1;
+		size_t k = 63 - __builtin_clzll(v);
+		if (k >= maxExponent) { return largeClass; }
+		size_t sub = (v >> (k - 2)) & 3;
+		return 1 + 4 * (k - minExponent) + sub;
+	}
+
+	size_t classBytes(uint32_t c) {
+		if (c == 0) { return (1 << minExponent); }
+		size_t k = minExponent + (c - 1) / 4;
+		size_t sub = (c - 1) % 4;
+		return (5 + sub) << (k - 2);
+	}
+
+	char *payload(Header *h) {
+		return ((char *) h) + alignment;
+	}
+
+	Header *header(void *ptr) {
+		return (Header *) (((char *) ptr) - alignment);
+	}
+
+	void *systemAllocate(size_t bytes, uint32_t cls) {
+		void *block = aligned_alloc(alignment, roundUp(bytes) + alignment);
+		if (!block) {
+			cerr << "Memory::allocate: out of memory (" << bytes << " bytes requested).\n";
+			exit(1);
+		}
+		Header *h = (Header *) block;
+		h->magic = magicNumber;
+		h->sizeClass = cls;
+		h->owner = nullptr;
+		return payload(h);
+	}
+
+	//////////////////////////////////////////////////////////////////////
+	// Global state
+	//////////////////////////////////////////////////////////////////////
+	struct Counters {
+		atomic<size_t> allocations{0};
+		atomic<size_t> deallocations{0};
+		atomic<size_t> poolHits{0};
+		atomic<size_t> systemAllocations{0};
+		atomic<size_t> arenaAllocations{0};
+		atomic<size_t> bytesRequested{0};
+	};
+
+	Counters& counters() {
+		static Counters c;
+		return c;
+	}
+
+	atomic<Policy> currentPolicy{Policy::Pool};
+	atomic<size_t> poolCapacity{(size_t) 1 << 28};
+
+	thread_local Arena *currentArena = nullptr;
+	/// Guards against use of the pool after its thread_local destructor ran
+	thread_local bool poolAlive = false;
+
+	struct ThreadPool {
+		ThreadPool() { poolAlive = true; }
+
+		~ThreadPool() {
+			release();
+			poolAlive = false;
+		}
+
+		void release() {
+			for (auto& list : free_) {
+				for (void *ptr : list) {
+					std::free(header(ptr));
+				}
+				list.clear();
+			}
+			cached_ = 0;
+		}
+
+		array<vector<void *>, nClasses> free_;
+		size_t cached_{0};
+	};
+
+	ThreadPool *threadPool() {
+		static thread_local ThreadPool pool;
+		if (!poolAlive) { return nullptr; }
+		return &pool;
+	}
+
+	//////////////////////////////////////////////////////////////////////
+	// Interface
+	//////////////////////////////////////////////////////////////////////
+	void *allocate(size_t bytes) {
+		Counters& count = counters();
+		count.allocations.fetch_add(1, memory_order_relaxed);
+		count.bytesRequested.fetch_add(bytes, memory_order_relaxed);
+		if (bytes == 0) { bytes = 1; }
+
+		if (currentArena) {
+			count.arenaAllocations.fetch_add(1, memory_order_relaxed);
+			Header *h = (Header *) currentArena->allocate(bytes + alignment);
+			h->magic = magicNumber;
+			h->sizeClass = arenaClass;
+			h->owner = currentArena;
+			return payload(h);
+		}
+
+		uint32_t cls = sizeClass(bytes);
+		if (cls == largeClass) {
+			count.systemAllocations.fetch_add(1, memory_order_relaxed);
+			return systemAllocate(bytes, cls);
+		}
+
+		if (currentPolicy.load(memory_order_relaxed) == Policy::Pool) {
+			ThreadPool *pool = threadPool();
+			if (pool && !pool->free_[cls].empty()) {
+				void *ptr = pool->free_[cls].back();
+				pool->free_[cls].pop_back();
+				pool->cached_ -= classBytes(cls);
+				count.poolHits.fetch_add(1, memory_order_relaxed);
+				return ptr;
+			}
+		}
+		count.systemAllocations.fetch_add(1, memory_order_relaxed);
+		return systemAllocate(classBytes(cls), cls);
+	}
+
+	void deallocate(void *ptr) {
+		if (!ptr) { return; }
+		counters().deallocations.fetch_add(1, memory_order_relaxed);
+		Header *h = header(ptr);
+		assert(h->magic == magicNumber);
+		uint32_t cls = h->sizeClass;
+
+		if (cls == arenaClass) {
+			h->owner->release();
+			return;
+		}
+
+		if (cls != largeClass && currentPolicy.load(memory_order_relaxed) == Policy::Pool) {
+			ThreadPool *pool = threadPool();
+			size_t bytes = classBytes(cls);
+			if (pool && pool->cached_ + bytes <= poolCapacity.load(memory_order_relaxed)) {
+				pool->free_[cls].push_back(ptr);
+				pool->cached_ += bytes;
+				return;
+			}
+		}
+		std::free(h);
+	}
+
+	void setPolicy(Policy policy) {
+		currentPolicy = policy;
+	}
+
+	Policy policy() {
+		return currentPolicy;
+	}
+
+	void setPoolCapacity(size_t bytes) {
+		poolCapacity = bytes;
+	}
+
+	void releasePool() {
+		ThreadPool *pool = threadPool();
+		if (pool) { pool->release(); }
+	}
+
+	Statistics statistics() {
+		Counters& count = counters();
+		Statistics stat;
+		stat.allocations = count.allocations;
+		stat.deallocations = count.deallocations;
+		stat.poolHits = count.poolHits;
+		stat.systemAllocations = count.systemAllocations;
+		stat.arenaAllocations = count.arenaAllocations;
+		stat.bytesRequested = count.bytesRequested;
+		return stat;
+	}
+
+	void resetStatistics() {
+		Counters& count = counters();
+		count.allocations = 0;
+		count.deallocations = 0;
+		count.poolHits = 0;
+		count.systemAllocations = 0;
+		count.arenaAllocations = 0;
+		count.bytesRequested = 0;
+	}
+
+	//////////////////////////////////////////////////////////////////////
+	// Arena
+	//////////////////////////////////////////////////////////////////////
+	Arena::Arena(size_t capacity)
+		: chunk_(0), offset_(0), used_(0), live_(0) {
+		capacity = roundUp(capacity);
+		chunks_.emplace_back((char *) aligned_alloc(alignment, capacity), capacity);
+	}
+
+	Arena::~Arena() {
+		assert(live_ == 0);
+		for (auto& chunk : chunks_) {
+			std::free(chunk.first);
+		}
+	}
+
+	void *Arena::allocate(size_t bytes) {
+		bytes = roundUp(bytes);
+		while (offset_ + bytes > chunks_[chunk_].second) {
+			++chunk_;
+			offset_ = 0;
+			if (chunk_ == chunks_.size()) {
+				size_t size = max(chunks_.back().second, bytes);
+				chunks_.emplace_back((char *) aligned_alloc(alignment, size), size);
+			}
+		}
+		char *ptr = chunks_[chunk_].first + offset_;
+		offset_ += bytes;
+		used_ += bytes;
+		++live_;
+		return ptr;
+	}
+
+	void Arena::reset() {
+		assert(live_ == 0);
+		chunk_ = 0;
+		offset_ = 0;
+		used_ = 0;
+	}
+
+	ArenaScope::ArenaScope(Arena& arena)
+		: previous_(currentArena) {
+		currentArena = &arena;
+	}
+
+	ArenaScope::~ArenaScope() {
+		currentArena = previous_;
+	}
+}
@@ -0,0 +1,759 @@
+#include "Core/LAKernels.h"
+
+/// Compile the kernels for several instruction sets and pick at load time (ELF ifunc)
+#if defined(__x86_64__) && defined(__ELF__) && defined(__GNUC__) && !defined(__clang__)
+#define LAKERNELS_DISPATCH __attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+#else
+#define LAKERNELS_DISPATCH
+#endif
+
+#define LAKERNELS_INLINE inline __attribute__((always_inline))
+
+namespace LAKernels {
+
+	/// Minimum number of flops before a kernel launches OpenMP threads (same as LA_lib.f)
+	constexpr size_t effort = 1000;
+
+	/// Chunk length of the whole-array kernels and minimum length to launch OpenMP threads
+	constexpr size_t chunk = 4096;
+	constexpr size_t parallelSize = 8 * chunk;
+
+	//////////////////////////////////////////////////////////////////////
+	// BLAS-1 building blocks. Complex numbers are processed as interleaved
+	// (re, im) pairs so the compiler vectorizes the multiply-adds.
+	//////////////////////////////////////////////////////////////////////
+
+	/// y += alpha * x
+	LAKERNELS_INLINE void axpy(double *y, const double *x, double alpha, size_t n) {
+		for (size_t i = 0; i < n; ++i) {
+			y[i] += alpha * x[i];
+		}
+	}
+
+	LAKERNELS_INLINE void axpy(cd *y, const cd *x, cd alpha, size_t n) {
+		double *yd = (double *) y;
+		const double *xd = (const double *) x;
+		const double ar = real(alpha);
+		const double ai = imag(alpha);
+		for (size_t i = 0; i < n; ++i) {
+			const double xr = xd[2 * i];
+			const double xi = xd[2 * i + 1];
+			yd[2 * i] += ar * xr - ai * xi;
+			yd[2 * i + 1] += ar * xi + ai * xr;
+		}
+	}
+
+	/// y += alpha * conj(x)
+	LAKERNELS_INLINE void axpyc(double *y, const double *x, double alpha, size_t n) {
+		axpy(y, x, alpha, n);
+	}
+
+	LAKERNELS_INLINE void axpyc(cd *y, const cd *x, cd alpha, size_t n) {
+		double *yd = (double *) y;
+		const double *xd = (const double *) x;
+		const double ar = real(alpha);
+		const double ai = imag(alpha);
+		for (size_t i = 0; i < n; ++i) {
+			const double xr = xd[2 * i];
+			const double xi = xd[2 * i + 1];
+			yd[2 * i] += ar * xr + ai * xi;
+			yd[2 * i + 1] += ai * xr - ar * xi;
+		}
+	}
+
+	/// sum_i x(i) * y(i)
+	LAKERNELS_INLINE double dotu(const double *x, const double *y, size_t n) {
+		double result = 0.;
+		for (size_t i = 0; i < n; ++i) {
+			result += x[i] * y[i];
+		}
+		return result;
+	}
+
+	LAKERNELS_INLINE cd dotu(const cd *x, const cd *y, size_t n) {
+		const double *xd = (const double *) x;
+		const double *yd = (const double *) y;
+		double re = 0.;
+		double im = 0.;
+		for (size_t i = 0; i < n; ++i) {
+			const double xr = xd[2 * i];
+			const double xi = xd[2 * i + 1];
+			const double yr = yd[2 * i];
+			const double yi = yd[2 * i + 1];
+			re += xr * yr - xi * yi;
+			im += xr * yi + xi * yr;
+		}
+		return cd(re, im);
+	}
+
+	/// sum_i conj(x(i)) * y(i)
+	LAKERNELS_INLINE double dotc(const double *x, const double *y, size_t n) {
+		return dotu(x, y, n);
+	}
+
+	LAKERNELS_INLINE cd dotc(const cd *x, const cd *y, size_t n) {
+		const double *xd = (const double *) x;
+		const double *yd = (const double *) y;
+		double re = 0.;
+		double im = 0.;
+		for (size_t i = 0; i < n; ++i) {
+			const double xr = xd[2 * i];
+			const double xi = xd[2 * i + 1];
+			const double yr = yd[2 * i];
+			const double yi = yd[2 * i + 1];
+			re += xr * yr + xi * yi;
+			im += xr * yi - xi * yr;
+		}
+		return cd(re, im);
+	}
+
+	/// y = alpha * y
+	LAKERNELS_INLINE void scal(double *y, double alpha, size_t n) {
+		for (size_t i = 0; i < n; ++i) {
+			y[i] *= alpha;
+		}
+	}
+
+	LAKERNELS_INLINE void scal(cd *y, cd alpha, size_t n) {
+		double *yd = (double *) y;
+		const double ar = real(alpha);
+		const double ai = imag(alpha);
+		for (size_t i = 0; i < n; ++i) {
+			const double yr = yd[2 * i];
+			const double yi = yd[2 * i + 1];
+			yd[2 * i] = ar * yr - ai * yi;
+			yd[2 * i + 1] = ar * yi + ai * yr;
+		}
+	}
+
+	/// y = alpha * x + beta * y
+	LAKERNELS_INLINE void axpby(double *y, const double *x, double alpha, double beta, size_t n) {
+		for (size_t i = 0; i < n; ++i) {
+			y[i] = alpha * x[i] + beta * y[i];
+		}
+	}
+
+	LAKERNELS_INLINE void axpby(cd *y, const cd *x, cd alpha, cd beta, size_t n) {
+		double *yd = (double *) y;
+		const double *xd = (const double *) x;
+		const double ar = real(alpha);
+		const double ai = imag(alpha);
+		const double br = real(beta);
+		const double bi = imag(beta);
+		for (size_t i = 0; i < n; ++i) {
+			const double xr = xd[2 * i];
+			const double xi = xd[2 * i + 1];
+			const double yr = yd[2 * i];
+			const double yi = yd[2 * i + 1];
+			yd[2 * i] = ar * xr - ai * xi + br * yr - bi * yi;
+			yd[2 * i + 1] = ar * xi + ai * xr + br * yi + bi * yr;
+		}
+	}
+
+	/// y = alpha * x + beta * z (add = false) or y += alpha * x + beta * z (add = true)
+	LAKERNELS_INLINE void lincomb(double *y, const double *x, double alpha,
+		const double *z, double beta, size_t n, bool add) {
+		if (add) {
+			for (size_t i = 0; i < n; ++i) {
+				y[i] += alpha * x[i] + beta * z[i];
+			}
+		} else {
+			for (size_t i = 0; i < n; ++i) {
+				y[i] = alpha * x[i] + beta * z[i];
+			}
+		}
+	}
+
+	LAKERNELS_INLINE void lincomb(cd *y, const cd *x, cd alpha,
+		const cd *z, cd beta, size_t n, bool add) {
+		double *yd = (double *) y;
+		const double *xd = (const double *) x;
+		const double *zd = (const double *) z;
+		const double ar = real(alpha);
+		const double ai = imag(alpha);
+		const double br = real(beta);
+		const double bi = imag(beta);
+		if (add) {
+			for (size_t i = 0; i < n; ++i) {
+				const double xr = xd[2 * i];
+				const double xi = xd[2 * i + 1];
+				const double zr = zd[2 * i];
+				const double zi = zd[2 * i + 1];
+				yd[2 * i] += ar * xr - ai * xi + br * zr - bi * zi;
+				yd[2 * i + 1] += ar * xi + ai * xr + br * zi + bi * zr;
+			}
+		} else {
+			/// y is not read, so stale NaN/Inf in y do not survive
+			for (size_t i = 0; i < n; ++i) {
+				const double xr = xd[2 * i];
+				const double xi = xd[2 * i + 1];
+				const double zr = zd[2 * i];
+				const double zi = zd[2 * i + 1];
+				yd[2 * i] = ar * xr - ai * xi + br * zr - bi * zi;
+				yd[2 * i + 1] = ar * xi + ai * xr + br * zi + bi * zr;
+			}
+		}
+	}
+
+	/// sum_i x(i)^2
+	LAKERNELS_INLINE double sumsq(const double *x, size_t n) {
+		double result = 0.;
+		for (size_t i = 0; i < n; ++i) {
+			result += x[i] * x[i];
+		}
+		return result;
+	}
+
+	//////////////////////////////////////////////////////////////////////
+	// Tensor kernels
+	//////////////////////////////////////////////////////////////////////
+
+	template<typename T>
+	LAKERNELS_INLINE void nullvec(T *psi, size_t dim) {
+		for (size_t i = 0; i < dim; ++i) {
+			psi[i] = 0.;
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////
+	// Kernels for a fixed active dimension D (spins, qubits). The D x D
+	// matrix is kept in registers and the loops over it are unrolled.
+	//////////////////////////////////////////////////////////////////////
+
+	/// mulpsi(i, k, j) (+)= m(k, l) * psi(i, l, j) with m(k, l) = matrix[k * sK + l * sL]
+	template<size_t D, bool Add>
+	LAKERNELS_INLINE void matvecFixed(double *mulpsi, const double *psi, const double *matrix,
+		size_t sK, size_t sL, size_t b, size_t c) {
+		double m[D][D];
+		for (size_t k = 0; k < D; ++k) {
+			for (size_t l = 0; l < D; ++l) {
+				m[k][l] = matrix[k * sK + l * sL];
+			}
+		}
+#pragma omp parallel for if((c > 1) && (c * b * D * D >= effort))
+		for (size_t j = 0; j < c; ++j) {
+			const double *in = psi + j * D * b;
+			double *out = mulpsi + j * D * b;
+			for (size_t i = 0; i < b; ++i) {
+				double x[D];
+				for (size_t l = 0; l < D; ++l) {
+					x[l] = in[l * b + i];
+				}
+				for (size_t k = 0; k < D; ++k) {
+					double y = 0.;
+					for (size_t l = 0; l < D; ++l) {
+						y += m[k][l] * x[l];
+					}
+					if (Add) {
+						out[k * b + i] += y;
+					} else {
+						out[k * b + i] = y;
+					}
+				}
+			}
+		}
+	}
+
+	template<size_t D, bool Add>
+	LAKERNELS_INLINE void matvecFixed(cd *mulpsi, const cd *psi, const cd *matrix,
+		size_t sK, size_t sL, size_t b, size_t c) {
+		double mr[D][D];
+		double mi[D][D];
+		for (size_t k = 0; k < D; ++k) {
+			for (size_t l = 0; l < D; ++l) {
+				mr[k][l] = real(matrix[k * sK + l * sL]);
+				mi[k][l] = imag(matrix[k * sK + l * sL]);
+			}
+		}
+#pragma omp parallel for if((c > 1) && (c * b * D * D >= effort))
+		for (size_t j = 0; j < c; ++j) {
+			const double *in = (const double *) (psi + j * D * b);
+			double *out = (double *) (mulpsi + j * D * b);
+			for (size_t i = 0; i < b; ++i) {
+				double xr[D];
+				double xi[D];
+				for (size_t l = 0; l < D; ++l) {
+					xr[l] = in[2 * (l * b + i)];
+					xi[l] = in[2 * (l * b + i) + 1];
+				}
+				for (size_t k = 0; k < D; ++k) {
+					double re = 0.;
+					double im = 0.;
+					for (size_t l = 0; l < D; ++l) {
+						re += mr[k][l] * xr[l] - mi[k][l] * xi[l];
+						im += mr[k][l] * xi[l] + mi[k][l] * xr[l];
+					}
+					double *y = out + 2 * (k * b + i);
+					if (Add) {
+						y[0] += re;
+						y[1] += im;
+					} else {
+						y[0] = re;
+						y[1] = im;
+					}
+				}
+			}
+		}
+	}
+
+	/// matrix(j, i) (+)= conj(bra(n, j, m)) * ket(n, i, m)
+	template<size_t D>
+	LAKERNELS_INLINE void rhomatFixed(double *matrix, const double *bra, const double *ket,
+		size_t b, size_t c, bool add) {
+		double s[D][D] = {};
+		for (size_t m = 0; m < c; ++m) {
+			const double *x = bra + m * D * b;
+			const double *y = ket + m * D * b;
+			for (size_t n = 0; n < b; ++n) {
+				for (size_t i = 0; i < D; ++i) {
+					for (size_t j = 0; j < D; ++j) {
+						s[i][j] += x[j * b + n] * y[i * b + n];
+					}
+				}
+			}
+		}
+		for (size_t i = 0; i < D; ++i) {
+			for (size_t j = 0; j < D; ++j) {
+				matrix[i * D + j] = (add ? matrix[i * D + j] : 0.) + s[i][j];
+			}
+		}
+	}
+
+	template<size_t D>
+	LAKERNELS_INLINE void rhomatFixed(cd *matrix, const cd *bra, const cd *ket,
+		size_t b, size_t c, bool add) {
+		double sr[D][D] = {};
+		double si[D][D] = {};
+		for (size_t m = 0; m < c; ++m) {
+			const double *x = (const double *) (bra + m * D * b);
+			const double *y = (const double *) (ket + m * D * b);
+			for (size_t n = 0; n < b; ++n) {
+				double xr[D], xi[D], yr[D], yi[D];
+				for (size_t l = 0; l < D; ++l) {
+					xr[l] = x[2 * (l * b + n)];
+					xi[l] = x[2 * (l * b + n) + 1];
+					yr[l] = y[2 * (l * b + n)];
+					yi[l] = y[2 * (l * b + n) + 1];
+				}
+				for (size_t i = 0; i < D; ++i) {
+					for (size_t j = 0; j < D; ++j) {
+						sr[i][j] += xr[j] * yr[i] + xi[j] * yi[i];
+						si[i][j] += xr[j] * yi[i] - xi[j] * yr[i];
+					}
+				}
+			}
+		}
+		for (size_t i = 0; i < D; ++i) {
+			for (size_t j = 0; j < D; ++j) {
+				cd sum(sr[i][j], si[i][j]);
+				matrix[i * D + j] = add ? matrix[i * D + j] + sum : sum;
+			}
+		}
+	}
+
+	/// Run the fixed-size kernel if a matches one of the instantiated dimensions
+	template<typename T>
+	LAKERNELS_INLINE bool matvecSmall(T *mulpsi, const T *psi, const T *matrix,
+		size_t a, size_t b, size_t c, bool add, bool transpose) {
+		const size_t sK = transpose ? a : 1;
+		const size_t sL = transpose ? 1 : a;
+		switch (a) {
+			case 2:
+				add ? matvecFixed<2, true>(mulpsi, psi, matrix, sK, sL, b, c)
+					: matvecFixed<2, false>(mulpsi, psi, matrix, sK, sL, b, c);
+				return true;
+			case 3:
+				add ? matvecFixed<3, true>(mulpsi, psi, matrix, sK, sL, b, c)
+					: matvecFixed<3, false>(mulpsi, psi, matrix, sK, sL, b, c);
+				return true;
+			case 4:
+				add ? matvecFixed<4, true>(mulpsi, psi, matrix, sK, sL, b, c)
+					: matvecFixed<4, false>(mulpsi, psi, matrix, sK, sL, b, c);
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	template<typename T>
+	LAKERNELS_INLINE bool rhomatSmall(T *matrix, const T *bra, const T *ket,
+		size_t a, size_t b, size_t c, bool add) {
+		switch (a) {
+			case 2: rhomatFixed<2>(matrix, bra, ket, b, c, add);
+				return true;
+			case 3: rhomatFixed<3>(matrix, bra, ket, b, c, add);
+				return true;
+			case 4: rhomatFixed<4>(matrix, bra, ket, b, c, add);
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	template<typename T>
+	LAKERNELS_INLINE void matvecT(T *mulpsi, const T *psi, const T *matrix,
+		size_t aC, size_t aB, size_t b, size_t c, bool add, bool transpose) {
+		if (aC == aB && matvecSmall(mulpsi, psi, matrix, aC, b, c, add, transpose)) { return; }
+		if (!add) { nullvec(mulpsi, b * aC * c); }
+		/// matrix(k, l) or matrix(l, k)
+		const size_t strideK = transpose ? aB : 1;
+		const size_t strideL = transpose ? 1 : aC;
+		if (b == 1) {
+#pragma omp parallel for if((c > 1) && (c * aC * aB >= effort))
+			for (size_t j = 0; j < c; ++j) {
+				T *out = mulpsi + j * aC;
+				const T *in = psi + j * aB;
+				if (transpose) {
+					for (size_t k = 0; k < aC; ++k) {
+						out[k] += dotu(matrix + k * strideK, in, aB);
+					}
+				} else {
+					for (size_t l = 0; l < aB; ++l) {
+						axpy(out, matrix + l * strideL, in[l], aC);
+					}
+				}
+			}
+		} else {
+#pragma omp parallel for if((c > 1) && (c * aC * aB * b >= effort))
+			for (size_t j = 0; j < c; ++j) {
+				for (size_t k = 0; k < aC; ++k) {
+					T *out = mulpsi + (j * aC + k) * b;
+					for (size_t l = 0; l < aB; ++l) {
+						axpy(out, psi + (j * aB + l) * b, matrix[k * strideK + l * strideL], b);
+					}
+				}
+			}
+		}
+	}
+
+	template<typename T>
+	LAKERNELS_INLINE void rhomatT(T *matrix, const T *bra, const T *ket,
+		size_t a1, size_t a2, size_t b, size_t c, bool add) {
+		if (a1 == a2 && rhomatSmall(matrix, bra, ket, a1, b, c, add)) { return; }
+		if (!add) { nullvec(matrix, a1 * a2); }
+		if (b == 1) {
+			/// matrix(:, i) += ket(i, m) * conj(bra(:, m))
+			for (size_t m = 0; m < c; ++m) {
+				for (size_t i = 0; i < a2; ++i) {
+					axpyc(matrix + i * a1, bra + m * a1, ket[m * a2 + i], a1);
+				}
+			}
+		} else {
+			for (size_t m = 0; m < c; ++m) {
+				for (size_t i = 0; i < a2; ++i) {
+					const T *k = ket + (m * a2 + i) * b;
+					for (size_t j = 0; j < a1; ++j) {
+						matrix[i * a1 + j] += dotc(bra + (m * a1 + j) * b, k, b);
+					}
+				}
+			}
+		}
+	}
+
+	LAKERNELS_INLINE void diagmatT(double *mulpsi, const double *psi, const double *diag,
+		size_t a, size_t c) {
+#pragma omp parallel for if(a * c >= parallelSize)
+		for (size_t j = 0; j < c; ++j) {
+			double *out = mulpsi + j * a;
+			const double *in = psi + j * a;
+			for (size_t k = 0; k < a; ++k) {
+				out[k] = diag[k] * in[k];
+			}
+		}
+	}
+
+	LAKERNELS_INLINE void diagmatT(cd *mulpsi, const cd *psi, const cd *diag,
+		size_t a, size_t c) {
+		const double *d = (const double *) diag;
+#pragma omp parallel for if(a * c >= parallelSize)
+		for (size_t j = 0; j < c; ++j) {
+			double *out = (double *) (mulpsi + j * a);
+			const double *in = (const double *) (psi + j * a);
+			for (size_t k = 0; k < a; ++k) {
+				const double dr = d[2 * k];
+				const double di = d[2 * k + 1];
+				const double xr = in[2 * k];
+				const double xi = in[2 * k + 1];
+				out[2 * k] = dr * xr - di * xi;
+				out[2 * k + 1] = dr * xi + di * xr;
+			}
+		}
+	}
+
+	LAKERNELS_INLINE void csrmatT(double *mulpsi, const double *psi, const size_t *rowPtr,
+		const size_t *col, const double *val, size_t aC, size_t aB, size_t c) {
+#pragma omp parallel for if((c > 1) && (c * rowPtr[aC] >= effort))
+		for (size_t j = 0; j < c; ++j) {
+			double *out = mulpsi + j * aC;
+			const double *in = psi + j * aB;
+			for (size_t k = 0; k < aC; ++k) {
+				double sum = 0.;
+				for (size_t p = rowPtr[k]; p < rowPtr[k + 1]; ++p) {
+					sum += val[p] * in[col[p]];
+				}
+				out[k] = sum;
+			}
+		}
+	}
+
+	LAKERNELS_INLINE void csrmatT(cd *mulpsi, const cd *psi, const size_t *rowPtr,
+		const size_t *col, const cd *val, size_t aC, size_t aB, size_t c) {
+		const double *v = (const double *) val;
+#pragma omp parallel for if((c > 1) && (c * rowPtr[aC] >= effort))
+		for (size_t j = 0; j < c; ++j) {
+			double *out = (double *) (mulpsi + j * aC);
+			const double *in = (const double *) (psi + j * aB);
+			for (size_t k = 0; k < aC; ++k) {
+				double re = 0.;
+				double im = 0.;
+				for (size_t p = rowPtr[k]; p < rowPtr[k + 1]; ++p) {
+					const double vr = v[2 * p];
+					const double vi = v[2 * p + 1];
+					const double xr = in[2 * col[p]];
+					const double xi = in[2 * col[p] + 1];
+					re += vr * xr - vi * xi;
+					im += vr * xi + vi * xr;
+				}
+				out[2 * k] = re;
+				out[2 * k + 1] = im;
+			}
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////
+	// Dispatched entry points
+	//////////////////////////////////////////////////////////////////////
+
+	LAKERNELS_DISPATCH
+	void matvec(cd *mulpsi, const cd *psi, const cd *matrix,
+		size_t aC, size_t aB, size_t b, size_t c, bool add) {
+		matvecT(mulpsi, psi, matrix, aC, aB, b, c, add, false);
+	}
+
+	LAKERNELS_DISPATCH
+	void matvec(double *mulpsi, const double *psi, const double *matrix,
+		size_t aC, size_t aB, size_t b, size_t c, bool add) {
+		matvecT(mulpsi, psi, matrix, aC, aB, b, c, add, false);
+	}
+
+	LAKERNELS_DISPATCH
+	void tmatvec(cd *mulpsi, const cd *psi, const cd *matrix,
+		size_t aC, size_t aB, size_t b, size_t c, bool add) {
+		matvecT(mulpsi, psi, matrix, aC, aB, b, c, add, true);
+	}
+
+	LAKERNELS_DISPATCH
+	void tmatvec(double *mulpsi, const double *psi, const double *matrix,
+		size_t aC, size_t aB, size_t b, size_t c, bool add) {
+		matvecT(mulpsi, psi, matrix, aC, aB, b, c, add, true);
+	}
+
+	LAKERNELS_DISPATCH
+	void rhomat(cd *matrix, const cd *bra, const cd *ket,
+		size_t a1, size_t a2, size_t b, size_t c, bool add) {
+		rhomatT(matrix, bra, ket, a1, a2, b, c, add);
+	}
+
+	LAKERNELS_DISPATCH
+	void rhomat(double *matrix, const double *bra, const double *ket,
+		size_t a1, size_t a2, size_t b, size_t c, bool add) {
+		rhomatT(matrix, bra, ket, a1, a2, b, c, add);
+	}
+
+	LAKERNELS_DISPATCH
+	void diagmat(cd *mulpsi, const cd *psi, const cd *diag, size_t a, size_t c) {
+		diagmatT(mulpsi, psi, diag, a, c);
+	}
+
+	LAKERNELS_DISPATCH
+	void diagmat(double *mulpsi, const double *psi, const double *diag, size_t a, size_t c) {
+		diagmatT(mulpsi, psi, diag, a, c);
+	}
+
+	LAKERNELS_DISPATCH
+	void csrmat(cd *mulpsi, const cd *psi, const size_t *rowPtr, const size_t *col,
+		const cd *val, size_t aC, size_t aB, size_t c) {
+		csrmatT(mulpsi, psi, rowPtr, col, val, aC, aB, c);
+	}
+
+	LAKERNELS_DISPATCH
+	void csrmat(double *mulpsi, const double *psi, const size_t *rowPtr, const size_t *col,
+		const double *val, size_t aC, size_t aB, size_t c) {
+		csrmatT(mulpsi, psi, rowPtr, col, val, aC, aB, c);
+	}
+
+	//////////////////////////////////////////////////////////////////////
+	// Whole-array kernels: the chunks are dispatched, the threads are
+	// spawned outside of the dispatched code.
+	//////////////////////////////////////////////////////////////////////
+
+	LAKERNELS_DISPATCH
+	static void scalChunk(cd *y, cd alpha, size_t n) { scal(y, alpha, n); }
+
+	LAKERNELS_DISPATCH
+	static void scalChunk(double *y, double alpha, size_t n) { scal(y, alpha, n); }
+
+	LAKERNELS_DISPATCH
+	static void axpyChunk(cd *y, const cd *x, cd alpha, size_t n) { axpy(y, x, alpha, n); }
+
+	LAKERNELS_DISPATCH
+	static void axpyChunk(double *y, const double *x, double alpha, size_t n) { axpy(y, x, alpha, n); }
+
+	LAKERNELS_DISPATCH
+	static void axpbyChunk(cd *y, const cd *x, cd alpha, cd beta, size_t n) {
+		axpby(y, x, alpha, beta, n);
+	}
+
+	LAKERNELS_DISPATCH
+	static void axpbyChunk(double *y, const double *x, double alpha, double beta, size_t n) {
+		axpby(y, x, alpha, beta, n);
+	}
+
+	LAKERNELS_DISPATCH
+	static void lincombChunk(cd *y, const cd *x, cd alpha, const cd *z, cd beta,
+		size_t n, bool add) {
+		lincomb(y, x, alpha, z, beta, n, add);
+	}
+
+	LAKERNELS_DISPATCH
+	static void lincombChunk(double *y, const double *x, double alpha, const double *z, double beta,
+		size_t n, bool add) {
+		lincomb(y, x, alpha, z, beta, n, add);
+	}
+
+	LAKERNELS_DISPATCH
+	static cd dotChunk(const cd *x, const cd *y, size_t n) { return dotc(x, y, n); }
+
+	LAKERNELS_DISPATCH
+	static double dotChunk(const double *x, const double *y, size_t n) { return dotc(x, y, n); }
+
+	LAKERNELS_DISPATCH
+	static double sumsqChunk(const double *x, size_t n) { return sumsq(x, n); }
+
+	void vscal(cd *y, cd alpha, size_t n) {
+#pragma omp parallel for if(n >= parallelSize)
+		for (size_t s = 0; s < n; s += chunk) {
+			scalChunk(y + s, alpha, min(chunk, n - s));
+		}
+	}
+
+	void vscal(double *y, double alpha, size_t n) {
+#pragma omp parallel for if(n >= parallelSize)
+		for (size_t s = 0; s < n; s += chunk) {
+			scalChunk(y + s, alpha, min(chunk, n - s));
+		}
+	}
+
+	void vaxpy(cd *y, const cd *x, cd alpha, size_t n) {
+#pragma omp parallel for if(n >= parallelSize)
+		for (size_t s = 0; s < n; s += chunk) {
+			axpyChunk(y + s, x + s, alpha, min(chunk, n - s));
+		}
+	}
+
+	void vaxpy(double *y, const double *x, double alpha, size_t n) {
+#pragma omp parallel for if(n >= parallelSize)
+		for (size_t s = 0; s < n; s += chunk) {
+			axpyChunk(y + s, x + s, alpha, min(chunk, n - s));
+		}
+	}
+
+	void vaxpby(cd *y, const cd *x, cd alpha, cd beta, size_t n) {
+#pragma omp parallel for if(n >= parallelSize)
+		for (size_t s = 0; s < n; s += chunk) {
+			axpbyChunk(y + s, x + s, alpha, beta, min(chunk, n - s));
+		}
+	}
+
+	void vaxpby(double *y, const double *x, double alpha, double beta, size_t n) {
+#pragma omp parallel for if(n >= parallelSize)
+		for (size_t s = 0; s < n; s += chunk) {
+			axpbyChunk(y + s, x + s, alpha, beta, min(chunk, n - s));
+		}
+	}
+
+	void vaxpbz(cd *y, const cd *x, cd alpha, const cd *z, cd beta, size_t n) {
+#pragma omp parallel for if(n >= parallelSize)
+		for (size_t s = 0; s < n; s += chunk) {
+			lincombChunk(y + s, x + s, alpha, z + s, beta, min(chunk, n - s), true);
+		}
+	}
+
+	void vaxpbz(double *y, const double *x, double alpha, const double *z, double beta, size_t n) {
+#pragma omp parallel for if(n >= parallelSize)
+		for (size_t s = 0; s < n; s += chunk) {
+			lincombChunk(y + s, x + s, alpha, z + s, beta, min(chunk, n - s), true);
+		}
+	}
+
+	void vlincomb(cd *y, const cd *x, cd alpha, const cd *z, cd beta, size_t n) {
+#pragma omp parallel for if(n >= parallelSize)
+		for (size_t s = 0; s < n; s += chunk) {
+			lincombChunk(y + s, x + s, alpha, z + s, beta, min(chunk, n - s), false);
+		}
+	}
+
+	void vlincomb(double *y, const double *x, double alpha, const double *z, double beta, size_t n) {
+#pragma omp parallel for if(n >= parallelSize)
+		for (size_t s = 0; s < n; s += chunk) {
+			lincombChunk(y + s, x + s, alpha, z + s, beta, min(chunk, n - s), false);
+		}
+	}
+
+	/// Sum of f(s, len) over all chunks. The chunk results are added serially in
+	/// chunk order, so the result does not depend on the number of threads.
+	template<typename T, typename F>
+	static T sumChunks(size_t n, F f) {
+		size_t nChunks = (n + chunk - 1) / chunk;
+		T result = 0.;
+		if (n < parallelSize) {
+			for (size_t i = 0; i < nChunks; ++i) {
+				result += f(i * chunk, min(chunk, n - i * chunk));
+			}
+			return result;
+		}
+		vector<T> partial(nChunks);
+#pragma omp parallel for
+		for (size_t i = 0; i < nChunks; ++i) {
+			partial[i] = f(i * chunk, min(chunk, n - i * chunk));
+		}
+		for (const T& p : partial) {
+			result += p;
+		}
+		return result;
+	}
+
+	cd vdot(const cd *x, const cd *y, size_t n) {
+		return sumChunks<cd>(n, [x, y](size_t s, size_t len) {
+			return dotChunk(x + s, y + s, len);
+		});
+	}
+
+	double vdot(const double *x, const double *y, size_t n) {
+		return sumChunks<double>(n, [x, y](size_t s, size_t len) {
+			return dotChunk(x + s, y + s, len);
+		});
+	}
+
+	double vnrm2(const double *x, size_t n) {
+		return sqrt(sumChunks<double>(n, [x](size_t s, size_t len) {
+			return sumsqChunk(x + s, len);
+		}));
+	}
+
+	double vnrm2(const cd *x, size_t n) {
+		/// |x|^2 of a complex array is the sum of squares of its (re, im) pairs
+		return vnrm2((const double *) x, 2 * n);
+	}
+
+	string activeISA() {
+#if defined(__x86_64__) && defined(__ELF__) && defined(__GNUC__) && !defined(__clang__)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("x86-64-v4")) { return "x86-64-v4"; }
+		if (__builtin_cpu_supports("x86-64-v3")) { return "x86-64-v3"; }
+		return "x86-64";
+#else
+		return "generic";
+#endif
+	}
+}
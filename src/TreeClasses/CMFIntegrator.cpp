@@ -0,0 +1,143 @@
+#include "TreeClasses/CMFIntegrator.h"
+#include "TreeClasses/SparseMatrixTreeFunctions.h"
+#include "TreeClasses/MatrixTreeFunctions.h"
+#include "TreeClasses/SpectralDecompositionTree.h"
+
+typedef complex<double> cd;
+
+namespace {
+	ShortIterativeLanczos<Tensorcd>::Parameters TopParameters(const CMFIntegrator::Parameters& par) {
+		ShortIterativeLanczos<Tensorcd>::Parameters sil;
+		sil.tolerance = par.innerTolerance;
+		sil.maxStep = par.maxStep;
+		return sil;
+	}
+}
+
+CMFIntegrator::CMFIntegrator(const SOPcd& H, const Tree& tree, Parameters par)
+	: H_(H), tree_(tree), par_(par), mats_(H, tree), rho_(tree), rhoinv_(tree),
+	  top_([this](Tensorcd& HA, const Tensorcd& A) {
+		  ApplyTop(HA, A);
+		  HA *= sign_;
+	  }, TopParameters(par)),
+	  dt_top_(min(0.01, par.maxStep)) {
+	assert(par_.minStep <= par_.maxStep);
+	for (const Node& node : tree_) {
+		Tensorcd init(node.shape());
+		layers_.emplace_back(node.shape().totalDimension(), init);
+	}
+	dt_layers_.resize(tree_.nNodes(), dt_top_);
+}
+
+void CMFIntegrator::MeanFields(const TensorTreecd& Psi) {
+	TreeFunctions::Represent(mats_, H_, Psi, Psi, tree_);
+	rho_ = TreeFunctions::Contraction(Psi, tree_, true);
+	rhoinv_ = inverse(rho_, tree_, par_.eps_rho);
+	TreeFunctions::Contraction(mats_.contractions_, Psi, Psi, mats_.matrices_, rho_, tree_);
+	nMeanFields_++;
+}
+
+void CMFIntegrator::ApplyTop(Tensorcd& HA, const Tensorcd& A) const {
+	const Node& top = tree_.TopNode();
+	HA.Zero();
+	for (size_t l = 0; l < H_.size(); ++l) {
+		Tensorcd hA = TreeFunctions::Apply(mats_.matrices_[l], A, H_[l], top);
+		HA += H_.Coeff(l) * hA;
+	}
+}
+
+Tensorcd CMFIntegrator::Derivative(const Tensorcd& Phi, const Node& node) const {
+	if (node.isToplayer()) {
+		Tensorcd HA(Phi.shape());
+		ApplyTop(HA, Phi);
+		return cd(0., -sign_) * HA;
+	}
+
+	/// Terms that are inactive at node are a matrix on the last index and projected out
+	Tensorcd X(Phi.shape());
+	for (size_t l = 0; l < H_.size(); ++l) {
+		const SparseMatrixTreecd& mat = mats_.matrices_[l];
+		if (!mat.Active(node)) { continue; }
+		Tensorcd hPhi = TreeFunctions::Apply(mat, Phi, H_[l], node);
+		const SparseMatrixTreecd& hole = mats_.contractions_[l];
+		X += H_.Coeff(l) * multStateAB(hole[node], hPhi);
+	}
+	X = multStateAB(rhoinv_[node], X);
+	X -= ProjectOrthogonal(Phi, X);
+	return cd(0., -sign_) * X;
+}
+
+void CMFIntegrator::Propagate(TensorTreecd& Psi, double dt) {
+	/// Backward propagation is forward propagation with the sign of H flipped
+	sign_ = (dt < 0.) ? -1. : 1.;
+	dt = abs(dt);
+	const Node& top = tree_.TopNode();
+	double t = 0.;
+	top_.Integrate(Psi[top], t, dt, dt_top_);
+
+	auto ddx = [](const CMFIntegrator& I, double /*t*/, Tensorcd& dPhi, Tensorcd& Phi, const Node& node) {
+		dPhi = I.Derivative(Phi, node);
+	};
+	auto err = [](const CMFIntegrator&, Tensorcd& A, Tensorcd& B) {
+		Tensorcd D(A);
+		D -= B;
+		return sqrt(abs(KrylovTraits<Tensorcd>::Dot(D, D)));
+	};
+	for (const Node& node : tree_) {
+		if (node.isToplayer()) { continue; }
+		size_t n = node.Address();
+		t = 0.;
+		layers_[n].Integrate(Psi[node], t, dt, dt_layers_[n], par_.innerTolerance,
+			[&node, &ddx](const CMFIntegrator& I, double t, Tensorcd& dPhi, Tensorcd& Phi) {
+				ddx(I, t, dPhi, Phi, node);
+			}, err, *this);
+	}
+	sign_ = 1.;
+}
+
+double CMFIntegrator::Step(TensorTreecd& Psi, double dt) {
+	MeanFields(Psi);
+	return MacroStep(Psi, dt);
+}
+
+double CMFIntegrator::MacroStep(TensorTreecd& Psi, double dt) {
+	TensorTreecd Psi0(Psi);
+	while (true) {
+		/// Predictor: mean fields at t, propagate to t + dt/2
+		TensorTreecd Half(Psi0);
+		Propagate(Half, dt / 2.);
+
+		/// Mean fields at t + dt/2, propagate from t to t + dt
+		MeanFields(Half);
+		Psi = Psi0;
+		Propagate(Psi, dt);
+
+		/// Mean fields at t + dt, propagate back to t + dt/2
+		MeanFields(Psi);
+		TensorTreecd Back(Psi);
+		Propagate(Back, -dt / 2.);
+
+		/// Both half steps have the same O(dt^2) error, the difference is O(dt^3)
+		KrylovTraits<TensorTreecd>::Axpy(Back, -1., Half);
+		double err = sqrt(abs(KrylovTraits<TensorTreecd>::Dot(Back, Back)));
+		double factor = (err > 0.) ? 0.9 * pow(par_.tolerance / err, 1. / 3.) : 2.;
+		factor = min(max(factor, 0.2), 2.);
+		if (err <= par_.tolerance || dt <= par_.minStep) {
+			next_ = min(max(dt * factor, par_.minStep), par_.maxStep);
+			nSteps_++;
+			return dt;
+		}
+		dt = max(dt * factor, min(par_.minStep, dt));
+		MeanFields(Psi0);
+	}
+}
+
+void CMFIntegrator::Integrate(TensorTreecd& Psi, double& t, double t_end, double& dt) {
+	/// Every accepted macro step ends with the mean fields of the new Psi
+	MeanFields(Psi);
+	while (t_end - t > 1e-12 * max(abs(t_end), 1.)) {
+		double h = min(dt, t_end - t);
+		t += MacroStep(Psi, h);
+		if (h == dt || next_ < dt) { dt = next_; }
+	}
+}
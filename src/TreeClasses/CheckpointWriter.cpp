@@ -0,0 +1,314 @@
+#include "TreeClasses/CheckpointWriter.h"
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+	constexpr size_t headerSize = 64;
+	constexpr uint32_t restartVersion = 1;
+	const char restartMagic[8] = {'Q', 'T', 'R', 'E', 'E', 'R', 'S', 'T'};
+
+	void Fail(const string& msg) {
+		cerr << "Restart: " << msg << endl;
+		exit(2);
+	}
+
+	void CheckEndianness() {
+		const uint16_t one = 1;
+		if (*(const char *) &one != 1) { Fail("only little-endian machines are supported."); }
+	}
+
+	template<typename T>
+	uint32_t ScalarType();
+
+	template<>
+	uint32_t ScalarType<double>() { return 1; }
+
+	template<>
+	uint32_t ScalarType<complex<double>>() { return 2; }
+
+	template<typename T>
+	void put(vector<char>& buf, T x) {
+		const char *p = (const char *) &x;
+		buf.insert(buf.end(), p, p + sizeof(T));
+	}
+
+	template<typename T>
+	T get(istream& is) {
+		T x;
+		is.read((char *) &x, sizeof(T));
+		if (!is.good()) { Fail("file is truncated."); }
+		return x;
+	}
+
+	/// Part of a node tensor that is compressed on its own
+	struct Block {
+		size_t node;
+		size_t offset; ///< Byte offset in the node tensor
+		size_t size;
+	};
+
+	template<typename T>
+	vector<Block> Blocks(const TensorTree<T>& Psi, size_t blockSize) {
+		/// Whole numbers per block keep the byte shuffle aligned
+		blockSize = max(blockSize / sizeof(T), (size_t) 1) * sizeof(T);
+		vector<Block> blocks;
+		for (size_t n = 0; n < Psi.size(); ++n) {
+			size_t bytes = Psi.begin()[n].shape().totalDimension() * sizeof(T);
+			for (size_t off = 0; off < bytes; off += blockSize) {
+				blocks.push_back({n, off, min(blockSize, bytes - off)});
+			}
+		}
+		return blocks;
+	}
+
+	/// Blocks per batch: a few per thread
+	size_t BatchSize() {
+#ifdef _OPENMP
+		return 4 * (size_t) omp_get_max_threads();
+#else
+		return 4;
+#endif
+	}
+
+	string TreeText(const Tree& tree) {
+		stringstream ss;
+		tree.Write(ss);
+		ss << setprecision(17);
+		for (size_t l = 0; l < tree.nLeaves(); ++l) {
+			PhysPar par = tree.GetLeaf(l).Par();
+			ss << par.Omega() << " " << par.R0() << " " << par.WFR0() << " " << par.WFOmega() << endl;
+		}
+		return ss.str();
+	}
+}
+
+namespace Checkpoint {
+
+	template<typename T>
+	size_t WriteRestart(const TensorTree<T>& Psi, const Tree& tree, const string& filename,
+		const RestartParameters& par) {
+		CheckEndianness();
+		ofstream os(filename, ios::binary);
+		if (!os.good()) { Fail("cannot open " + filename + "."); }
+		string text = TreeText(tree);
+		vector<Block> blocks = Blocks(Psi, par.blockSize);
+
+		vector<char> header(headerSize, 0);
+		os.write(header.data(), header.size());
+		os.write(text.data(), text.size());
+
+		vector<uint32_t> crcs(Psi.size());
+#pragma omp parallel for schedule(dynamic)
+		for (size_t n = 0; n < Psi.size(); ++n) {
+			const Tensor<T>& Phi = Psi.begin()[n];
+			crcs[n] = CRC32(&Phi[0], Phi.shape().totalDimension() * sizeof(T));
+		}
+
+		/// Compress a batch in parallel, then append it in order
+		vector<uint64_t> stored(blocks.size());
+		vector<uint32_t> codecs(blocks.size());
+		size_t batch = BatchSize();
+		vector<vector<char>> buffers(batch);
+		for (size_t start = 0; start < blocks.size(); start += batch) {
+			size_t end = min(start + batch, blocks.size());
+#pragma omp parallel for schedule(dynamic)
+			for (size_t b = start; b < end; ++b) {
+				const Block& block = blocks[b];
+				const char *raw = (const char *) &Psi.begin()[block.node][0] + block.offset;
+				Compression::Codec codec = par.codec;
+				vector<char>& buf = buffers[b - start];
+				buf = Compression::Compress(raw, block.size, codec, sizeof(double));
+				if (buf.size() >= block.size) {
+					codec = Compression::Codec::none;
+					buf.assign(raw, raw + block.size);
+				}
+				stored[b] = buf.size();
+				codecs[b] = (uint32_t) codec;
+			}
+			for (size_t b = start; b < end; ++b) {
+				os.write(buffers[b - start].data(), stored[b]);
+			}
+		}
+
+		/// Tables
+		uint64_t tableOffset = os.tellp();
+		vector<char> tables;
+		for (size_t n = 0; n < Psi.size(); ++n) {
+			const TensorShape& shape = Psi.begin()[n].shape();
+			put<uint32_t>(tables, shape.order());
+			put<uint32_t>(tables, crcs[n]);
+			for (size_t k = 0; k < shape.order(); ++k) {
+				put<uint64_t>(tables, shape[k]);
+			}
+		}
+		for (size_t b = 0; b < blocks.size(); ++b) {
+			put<uint64_t>(tables, blocks[b].size);
+			put<uint64_t>(tables, stored[b]);
+			put<uint32_t>(tables, codecs[b]);
+			put<uint32_t>(tables, 0);
+		}
+		os.write(tables.data(), tables.size());
+		size_t fileSize = os.tellp();
+
+		header.assign(restartMagic, restartMagic + 8);
+		put<uint32_t>(header, restartVersion);
+		put<uint32_t>(header, ScalarType<T>());
+		put<uint32_t>(header, (uint32_t) par.codec);
+		put<uint32_t>(header, 0);
+		put<uint64_t>(header, Psi.size());
+		put<uint64_t>(header, blocks.size());
+		put<uint64_t>(header, text.size());
+		put<uint64_t>(header, tableOffset);
+		header.resize(headerSize, 0);
+		os.seekp(0);
+		os.write(header.data(), header.size());
+		os.flush();
+		if (!os.good()) { Fail("cannot write " + filename + "."); }
+		return fileSize;
+	}
+
+	template<typename T>
+	void ReadRestart(Tree& tree, TensorTree<T>& Psi, const string& filename) {
+		CheckEndianness();
+		ifstream is(filename, ios::binary);
+		if (!is.good()) { Fail("cannot open " + filename + "."); }
+		char magic[8];
+		is.read(magic, 8);
+		if (!is.good() || memcmp(magic, restartMagic, 8) != 0) { Fail("not a restart file."); }
+		auto version = get<uint32_t>(is);
+		if (version == 0 || version > restartVersion) {
+			Fail("unsupported version " + to_string(version) + ".");
+		}
+		if (get<uint32_t>(is) != ScalarType<T>()) { Fail("wrong scalar type."); }
+		get<uint32_t>(is);
+		get<uint32_t>(is);
+		auto nNodes = get<uint64_t>(is);
+		auto nBlocks = get<uint64_t>(is);
+		auto treeSize = get<uint64_t>(is);
+		auto tableOffset = get<uint64_t>(is);
+
+		/// Tree
+		is.seekg(headerSize);
+		string text(treeSize, ' ');
+		is.read(&text[0], treeSize);
+		if (!is.good()) { Fail("file is truncated."); }
+		stringstream ts(text);
+		tree = Tree(ts);
+		if (tree.nNodes() != nNodes) { Fail("tree does not match the tensors."); }
+
+		/// Tables
+		is.seekg(tableOffset);
+		vector<TensorShape> shapes;
+		vector<uint32_t> crcs;
+		for (size_t n = 0; n < nNodes; ++n) {
+			auto order = get<uint32_t>(is);
+			crcs.push_back(get<uint32_t>(is));
+			vector<size_t> dims;
+			for (size_t k = 0; k < order; ++k) {
+				dims.push_back(get<uint64_t>(is));
+			}
+			shapes.emplace_back(dims);
+		}
+		vector<uint64_t> raw(nBlocks), stored(nBlocks);
+		vector<uint32_t> codecs(nBlocks);
+		for (size_t b = 0; b < nBlocks; ++b) {
+			raw[b] = get<uint64_t>(is);
+			stored[b] = get<uint64_t>(is);
+			codecs[b] = get<uint32_t>(is);
+			get<uint32_t>(is);
+		}
+		for (const Node& node : tree) {
+			if (!(node.shape() == shapes[node.Address()])) { Fail("tree does not match the tensors."); }
+		}
+
+		/// Blocks follow the nodes in order
+		Psi.InitializeContiguous(shapes);
+		vector<Block> blocks;
+		size_t n = 0;
+		size_t off = 0;
+		for (size_t b = 0; b < nBlocks; ++b) {
+			while (n < nNodes && off == shapes[n].totalDimension() * sizeof(T)) {
+				n++;
+				off = 0;
+			}
+			if (n == nNodes || off + raw[b] > shapes[n].totalDimension() * sizeof(T)) {
+				Fail("corrupt block table.");
+			}
+			blocks.push_back({n, off, raw[b]});
+			off += raw[b];
+		}
+
+		is.seekg(headerSize + treeSize);
+		size_t batch = BatchSize();
+		vector<vector<char>> buffers(batch);
+		for (size_t start = 0; start < nBlocks; start += batch) {
+			size_t end = min(start + batch, (size_t) nBlocks);
+			for (size_t b = start; b < end; ++b) {
+				buffers[b - start].resize(stored[b]);
+				is.read(buffers[b - start].data(), stored[b]);
+			}
+			if (!is.good()) { Fail("file is truncated."); }
+#pragma omp parallel for schedule(dynamic)
+			for (size_t b = start; b < end; ++b) {
+				const Block& block = blocks[b];
+				char *dst = (char *) &Psi.begin()[block.node][0] + block.offset;
+				const vector<char>& buf = buffers[b - start];
+				Compression::Decompress(buf.data(), buf.size(), dst, block.size,
+					(Compression::Codec) codecs[b], sizeof(double));
+			}
+		}
+
+		bool ok = true;
+#pragma omp parallel for schedule(dynamic) reduction(&&:ok)
+		for (size_t m = 0; m < Psi.size(); ++m) {
+			const Tensor<T>& Phi = Psi.begin()[m];
+			ok = ok && (CRC32(&Phi[0], Phi.shape().totalDimension() * sizeof(T)) == crcs[m]);
+		}
+		if (!ok) { Fail("CRC mismatch."); }
+	}
+}
+
+template<typename T>
+void CheckpointWriter<T>::Write(const TensorTree<T>& Psi, const Tree& tree, const string& filename) {
+	Wait();
+	/// Same layout as the last snapshot: one block copy without allocation
+	snapshot_ = Psi;
+	tree_ = tree;
+	busy_ = true;
+	if (async_) {
+		worker_ = thread(&CheckpointWriter<T>::Run, this, filename);
+	} else {
+		Run(filename);
+	}
+}
+
+template<typename T>
+void CheckpointWriter<T>::Wait() {
+	if (worker_.joinable()) { worker_.join(); }
+}
+
+template<typename T>
+void CheckpointWriter<T>::Run(const string& filename) {
+	string tmp = filename + ".tmp";
+	size_t bytes = Checkpoint::WriteRestart(snapshot_, tree_, tmp, par_);
+	if (rename(tmp.c_str(), filename.c_str()) != 0) { Fail("cannot rename " + tmp + "."); }
+	bytes_ = bytes;
+	nWritten_++;
+	busy_ = false;
+}
+
+typedef complex<double> cd;
+
+template size_t Checkpoint::WriteRestart(const TensorTree<cd>& Psi, const Tree& tree, const string& filename,
+	const RestartParameters& par);
+template void Checkpoint::ReadRestart(Tree& tree, TensorTree<cd>& Psi, const string& filename);
+template class CheckpointWriter<cd>;
+
+template size_t Checkpoint::WriteRestart(const TensorTree<double>& Psi, const Tree& tree, const string& filename,
+	const RestartParameters& par);
+template void Checkpoint::ReadRestart(Tree& tree, TensorTree<double>& Psi, const string& filename);
+template class CheckpointWriter<double>;
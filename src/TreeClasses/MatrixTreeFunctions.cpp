@@ -12,6 +12,8 @@ namespace TreeFunctions {
 	template void DotProduct(MatrixTree<cd>& S, const TensorTree<cd>& Bra, const TensorTree<cd>& Ket,
 		const Tree& tree);
 	template MatrixTree<cd> DotProduct(const TensorTree<cd>& Bra, const TensorTree<cd>& Ket, const Tree& tree);
+	template void DotProduct(MatrixTree<cd>& S, const vector<TensorTree<cd>>& Psis, const Tree& tree);
+	template Matrix<cd> GramMatrix(const vector<TensorTree<cd>>& Psis, const Tree& tree);
 
 	template void ContractionLocal(MatrixTree<cd>& Rho, const Tensor<cd>& Bra, Tensor<cd> Ket, const Node& node,
 		const MatrixTree<cd> *S);
@@ -24,12 +26,25 @@ namespace TreeFunctions {
 		const MatrixTree<cd>& S, const Tree& tree);
 	template MatrixTree<cd> Contraction(const TensorTree<cd>& Psi, const Tree& tree, bool orthogonal);
 
+	template void DotProductLocal(MatrixTree<cd>& S, const Tensor<cd>& Bra, const Tensor<cd>& Ket,
+		const Node& node, TreeWorkspace<cd>& work);
+	template void DotProduct(MatrixTree<cd>& S, const TensorTree<cd>& Bra, const TensorTree<cd>& Ket,
+		const Tree& tree, TreeWorkspace<cd>& work);
+	template void ContractionLocal(MatrixTree<cd>& Rho, const Tensor<cd>& Bra, const Tensor<cd>& Ket,
+		const Node& node, const MatrixTree<cd> *S_opt, TreeWorkspace<cd>& work);
+	template void Contraction(MatrixTree<cd>& Rho, const TensorTree<cd>& Bra, const TensorTree<cd>& Ket,
+		const MatrixTree<cd>& S, const Tree& tree, TreeWorkspace<cd>& work);
+	template void Contraction(MatrixTree<cd>& Rho, const TensorTree<cd>& Bra, const TensorTree<cd>& Ket,
+		const Tree& tree, TreeWorkspace<cd>& work);
+
 	typedef double d;
 
 	template void DotProductLocal<d>(MatrixTree<d>& S, const Tensor<d>& Bra, Tensor<d> Ket, const Node& node);
 	template void DotProduct<d>(MatrixTree<d>& S, const TensorTree<d>& Bra, const TensorTree<d>& Ket,
 		const Tree& tree);
 	template MatrixTree<d> DotProduct(const TensorTree<d>& Bra, const TensorTree<d>& Ket, const Tree& tree);
+	template void DotProduct(MatrixTree<d>& S, const vector<TensorTree<d>>& Psis, const Tree& tree);
+	template Matrix<d> GramMatrix(const vector<TensorTree<d>>& Psis, const Tree& tree);
 
 	template void ContractionLocal(MatrixTree<d>& Rho, const Tensor<d>& Bra, Tensor<d> Ket, const Node& node,
 		const MatrixTree<d> *S);
@@ -41,4 +56,15 @@ namespace TreeFunctions {
 	template MatrixTree<d> Contraction(const TensorTree<d>& Bra, const TensorTree<d>& Ket,
 		const MatrixTree<d>& S, const Tree& tree);
 	template MatrixTree<d> Contraction(const TensorTree<d>& Psi, const Tree& tree, bool orthogonal);
+
+	template void DotProductLocal(MatrixTree<d>& S, const Tensor<d>& Bra, const Tensor<d>& Ket,
+		const Node& node, TreeWorkspace<d>& work);
+	template void DotProduct(MatrixTree<d>& S, const TensorTree<d>& Bra, const TensorTree<d>& Ket,
+		const Tree& tree, TreeWorkspace<d>& work);
+	template void ContractionLocal(MatrixTree<d>& Rho, const Tensor<d>& Bra, const Tensor<d>& Ket,
+		const Node& node, const MatrixTree<d> *S_opt, TreeWorkspace<d>& work);
+	template void Contraction(MatrixTree<d>& Rho, const TensorTree<d>& Bra, const TensorTree<d>& Ket,
+		const MatrixTree<d>& S, const Tree& tree, TreeWorkspace<d>& work);
+	template void Contraction(MatrixTree<d>& Rho, const TensorTree<d>& Bra, const TensorTree<d>& Ket,
+		const Tree& tree, TreeWorkspace<d>& work);
 }
@@ -0,0 +1,328 @@
+#include "TreeClasses/OutOfCoreTensorTree.h"
+#include "TreeClasses/MatrixTreeFunctions.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+	void Fail(const string& msg) {
+		cerr << "OutOfCoreTensorTree: " << msg << endl;
+		exit(2);
+	}
+
+	/// Offset of the flags in the checkpoint header
+	constexpr off_t flagsOffset = 16;
+}
+
+template<typename T>
+OutOfCoreTensorTree<T>::OutOfCoreTensorTree(const string& filename, size_t cacheBytes)
+	: cacheBytes_(cacheBytes) {
+	Open(filename);
+}
+
+template<typename T>
+OutOfCoreTensorTree<T>::OutOfCoreTensorTree(const Tree& tree, const string& filename, size_t cacheBytes)
+	: cacheBytes_(cacheBytes) {
+	vector<TensorShape> shapes;
+	for (const Node& node : tree) {
+		shapes.push_back(node.shape());
+	}
+	Checkpoint::Create<T>(shapes, filename);
+	Open(filename);
+}
+
+template<typename T>
+OutOfCoreTensorTree<T>::OutOfCoreTensorTree(const TensorTree<T>& Psi, const string& filename, size_t cacheBytes)
+	: cacheBytes_(cacheBytes) {
+	Checkpoint::Write(Psi, filename, false);
+	Open(filename);
+}
+
+template<typename T>
+OutOfCoreTensorTree<T>::~OutOfCoreTensorTree() {
+	{
+		lock_guard<mutex> lock(mutex_);
+		stop_ = true;
+	}
+	queued_.notify_all();
+	if (worker_.joinable()) { worker_.join(); }
+	Flush();
+	close(fd_);
+	if (wfd_ >= 0) { close(wfd_); }
+}
+
+template<typename T>
+void OutOfCoreTensorTree<T>::Open(const string& filename) {
+	{
+		ifstream is(filename, ios::binary);
+		if (!is.good()) { Fail("cannot open " + filename + "."); }
+		index_ = Checkpoint::ReadIndex(is);
+	}
+	Checkpoint::CheckIndex<T>(index_);
+	filename_ = filename;
+	fd_ = open(filename.c_str(), O_RDONLY);
+	if (fd_ < 0) { Fail("cannot open " + filename + "."); }
+	struct stat st{};
+	fstat(fd_, &st);
+	if (index_.dataOffset + index_.dataSize > (uint64_t) st.st_size) { Fail("file is truncated."); }
+}
+
+template<typename T>
+void OutOfCoreTensorTree<T>::OpenForWriting() const {
+	wfd_ = open(filename_.c_str(), O_RDWR);
+	if (wfd_ < 0) { Fail("cannot open " + filename_ + " for writing."); }
+	/// The tensors change, so the CRCs become invalid
+	if (index_.crc) {
+		uint32_t flags = 0;
+		if (pwrite(wfd_, &flags, sizeof(flags), flagsOffset) != sizeof(flags)) {
+			Fail("cannot write " + filename_ + ".");
+		}
+	}
+}
+
+template<typename T>
+void OutOfCoreTensorTree<T>::ReadTensor(size_t n, Tensor<T>& Phi) const {
+	char *p = (char *) &Phi[0];
+	size_t bytes = index_.shapes[n].totalDimension() * sizeof(T);
+	off_t offset = index_.dataOffset + index_.offsets[n];
+	while (bytes > 0) {
+		ssize_t r = pread(fd_, p, bytes, offset);
+		if (r <= 0) { Fail("read failed."); }
+		p += r;
+		offset += r;
+		bytes -= r;
+	}
+}
+
+template<typename T>
+void OutOfCoreTensorTree<T>::WriteTensor(size_t n, const Tensor<T>& Phi) const {
+	if (wfd_ < 0) { OpenForWriting(); }
+	const char *p = (const char *) &Phi[0];
+	size_t bytes = index_.shapes[n].totalDimension() * sizeof(T);
+	off_t offset = index_.dataOffset + index_.offsets[n];
+	while (bytes > 0) {
+		ssize_t r = pwrite(wfd_, p, bytes, offset);
+		if (r <= 0) { Fail("write failed."); }
+		p += r;
+		offset += r;
+		bytes -= r;
+	}
+}
+
+template<typename T>
+void OutOfCoreTensorTree<T>::Touch(size_t n, Entry& entry) const {
+	lru_.erase(entry.lru);
+	lru_.push_front(n);
+	entry.lru = lru_.begin();
+}
+
+template<typename T>
+void OutOfCoreTensorTree<T>::Evict() const {
+	while (cached_ > cacheBytes_ && !lru_.empty()) {
+		size_t n = lru_.back();
+		Entry& entry = cache_.at(n);
+		if (entry.dirty) { WriteTensor(n, *entry.tensor); }
+		cached_ -= index_.shapes[n].totalDimension() * sizeof(T);
+		lru_.pop_back();
+		cache_.erase(n);
+	}
+}
+
+template<typename T>
+shared_ptr<Tensor<T>> OutOfCoreTensorTree<T>::Fetch(size_t n, unique_lock<mutex>& lock, bool prefetch) const {
+	while (true) {
+		auto it = cache_.find(n);
+		if (it == cache_.end()) { break; }
+		Entry& entry = it->second;
+		if (entry.loading) {
+			loaded_.wait(lock);
+			continue;
+		}
+		if (!prefetch) {
+			nHits_++;
+			Touch(n, entry);
+		}
+		return entry.tensor;
+	}
+
+	/// Read without holding the lock, others wait for "loading"
+	cache_[n].loading = true;
+	(prefetch ? nPrefetched_ : nMisses_)++;
+	lock.unlock();
+	auto Phi = make_shared<Tensor<T>>(index_.shapes[n], false);
+	ReadTensor(n, *Phi);
+	lock.lock();
+
+	Entry& entry = cache_[n];
+	entry.tensor = Phi;
+	entry.loading = false;
+	lru_.push_front(n);
+	entry.lru = lru_.begin();
+	cached_ += index_.shapes[n].totalDimension() * sizeof(T);
+	Evict();
+	loaded_.notify_all();
+	return Phi;
+}
+
+template<typename T>
+shared_ptr<const Tensor<T>> OutOfCoreTensorTree<T>::Read(const Node& node) const {
+	assert(node.Address() < size());
+	unique_lock<mutex> lock(mutex_);
+	return Fetch(node.Address(), lock, false);
+}
+
+template<typename T>
+void OutOfCoreTensorTree<T>::Write(const Node& node, const Tensor<T>& Phi) {
+	size_t n = node.Address();
+	assert(n < size());
+	assert(Phi.shape() == index_.shapes[n]);
+	auto copy = make_shared<Tensor<T>>(Phi);
+	unique_lock<mutex> lock(mutex_);
+	auto it = cache_.find(n);
+	while (it != cache_.end() && it->second.loading) {
+		loaded_.wait(lock);
+		it = cache_.find(n);
+	}
+	if (it == cache_.end()) {
+		Entry& entry = cache_[n];
+		lru_.push_front(n);
+		entry.lru = lru_.begin();
+		cached_ += Phi.shape().totalDimension() * sizeof(T);
+		it = cache_.find(n);
+	} else {
+		Touch(n, it->second);
+	}
+	it->second.tensor = copy;
+	it->second.loading = false;
+	it->second.dirty = true;
+	Evict();
+}
+
+template<typename T>
+void OutOfCoreTensorTree<T>::Prefetch(const Node& node) const {
+	size_t n = node.Address();
+	{
+		lock_guard<mutex> lock(mutex_);
+		if (cache_.count(n) || find(queue_.begin(), queue_.end(), n) != queue_.end()) { return; }
+		queue_.push_back(n);
+		if (!worker_.joinable()) { worker_ = thread(&OutOfCoreTensorTree<T>::Worker, this); }
+	}
+	queued_.notify_one();
+}
+
+template<typename T>
+void OutOfCoreTensorTree<T>::Worker() const {
+	unique_lock<mutex> lock(mutex_);
+	while (true) {
+		queued_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+		if (stop_) { return; }
+		size_t n = queue_.front();
+		queue_.pop_front();
+		Fetch(n, lock, true);
+	}
+}
+
+template<typename T>
+void OutOfCoreTensorTree<T>::Flush() {
+	lock_guard<mutex> lock(mutex_);
+	for (auto& x : cache_) {
+		Entry& entry = x.second;
+		if (entry.dirty && !entry.loading) {
+			WriteTensor(x.first, *entry.tensor);
+			entry.dirty = false;
+		}
+	}
+}
+
+template<typename T>
+TensorTree<T> OutOfCoreTensorTree<T>::Load() const {
+	TensorTree<T> Psi;
+	Psi.InitializeContiguous(index_.shapes);
+	for (size_t n = 0; n < size(); ++n) {
+		unique_lock<mutex> lock(mutex_);
+		auto it = cache_.find(n);
+		if (it != cache_.end() && !it->second.loading) {
+			Psi.begin()[n] = *it->second.tensor;
+		} else {
+			lock.unlock();
+			ReadTensor(n, Psi.begin()[n]);
+		}
+	}
+	return Psi;
+}
+
+template<typename T>
+size_t OutOfCoreTensorTree<T>::CachedBytes() const {
+	lock_guard<mutex> lock(mutex_);
+	return cached_;
+}
+
+namespace TreeFunctions {
+	template<typename T>
+	void DotProduct(MatrixTree<T>& S, const OutOfCoreTensorTree<T>& Bra,
+		const OutOfCoreTensorTree<T>& Ket, const Tree& tree, size_t lookahead) {
+		/// Bottom-up in the order of the tree, the next nodes are read in the background
+		for (size_t i = 0; i < tree.nNodes(); ++i) {
+			for (size_t j = i + 1; j <= i + lookahead && j < tree.nNodes(); ++j) {
+				const Node& next = tree.GetNode(j);
+				Bra.Prefetch(next);
+				Ket.Prefetch(next);
+			}
+			const Node& node = tree.GetNode(i);
+			auto bra = Bra.Read(node);
+			auto ket = Ket.Read(node);
+			DotProductLocal(S, *bra, *ket, node);
+		}
+	}
+
+	template<typename T>
+	MatrixTree<T> DotProduct(const OutOfCoreTensorTree<T>& Bra,
+		const OutOfCoreTensorTree<T>& Ket, const Tree& tree, size_t lookahead) {
+		MatrixTree<T> S(tree);
+		DotProduct(S, Bra, Ket, tree, lookahead);
+		return S;
+	}
+
+	template<typename T>
+	void Contraction(MatrixTree<T>& Rho, const OutOfCoreTensorTree<T>& Bra,
+		const OutOfCoreTensorTree<T>& Ket, const Tree& tree,
+		const MatrixTree<T> *S_opt, size_t lookahead) {
+		/// Top-down; every node needs the tensors of its parent
+		size_t nNodes = tree.nNodes();
+		for (size_t i = nNodes; i-- > 0;) {
+			for (size_t j = i; j-- > 0 && j + lookahead >= i;) {
+				const Node& next = tree.GetNode(j);
+				if (next.isToplayer()) { continue; }
+				Bra.Prefetch(next.parent());
+				Ket.Prefetch(next.parent());
+			}
+			const Node& node = tree.GetNode(i);
+			if (node.isToplayer()) {
+				Rho[node] = IdentityMatrix<T>(node.shape().lastDimension());
+				continue;
+			}
+			const Node& parent = node.parent();
+			auto bra = Bra.Read(parent);
+			auto ket = Ket.Read(parent);
+			ContractionLocal(Rho, *bra, *ket, node, S_opt);
+		}
+	}
+}
+
+typedef complex<double> cd;
+
+template class OutOfCoreTensorTree<cd>;
+template void TreeFunctions::DotProduct(MatrixTree<cd>& S, const OutOfCoreTensorTree<cd>& Bra,
+	const OutOfCoreTensorTree<cd>& Ket, const Tree& tree, size_t lookahead);
+template MatrixTree<cd> TreeFunctions::DotProduct(const OutOfCoreTensorTree<cd>& Bra,
+	const OutOfCoreTensorTree<cd>& Ket, const Tree& tree, size_t lookahead);
+template void TreeFunctions::Contraction(MatrixTree<cd>& Rho, const OutOfCoreTensorTree<cd>& Bra,
+	const OutOfCoreTensorTree<cd>& Ket, const Tree& tree, const MatrixTree<cd> *S_opt, size_t lookahead);
+
+template class OutOfCoreTensorTree<double>;
+template void TreeFunctions::DotProduct(MatrixTree<double>& S, const OutOfCoreTensorTree<double>& Bra,
+	const OutOfCoreTensorTree<double>& Ket, const Tree& tree, size_t lookahead);
+template MatrixTree<double> TreeFunctions::DotProduct(const OutOfCoreTensorTree<double>& Bra,
+	const OutOfCoreTensorTree<double>& Ket, const Tree& tree, size_t lookahead);
+template void TreeFunctions::Contraction(MatrixTree<double>& Rho, const OutOfCoreTensorTree<double>& Bra,
+	const OutOfCoreTensorTree<double>& Ket, const Tree& tree, const MatrixTree<double> *S_opt, size_t lookahead);
@@ -0,0 +1,188 @@
+#include "TreeClasses/RankAdaptation.h"
+
+namespace TreeFunctions {
+
+	size_t TargetRank(const Vectord& p, const RankParameters& par) {
+		/// Populations are in ascending order
+		double trace = 0.;
+		for (size_t i = 0; i < p.Dim(); ++i) {
+			trace += max(p(i), 0.);
+		}
+		size_t n = p.Dim();
+		double discarded = 0.;
+		for (size_t i = 0; i < p.Dim(); ++i) {
+			discarded += max(p(i), 0.);
+			if (discarded > par.tolerance * trace) { break; }
+			n--;
+		}
+		return max(n, (size_t) 1) + par.spare;
+	}
+
+	/// Fill the first nNew functions of Phi, which are zero, with functions orthonormal to the rest
+	template<typename T>
+	void FillNewFunctions(Tensor<T>& Phi, size_t nNew) {
+		size_t dim = Phi.shape().lastBefore();
+		size_t ntensor = Phi.shape().lastDimension();
+		size_t e = 0;
+		for (size_t n = 0; n < nNew; ++n) {
+			/// Unit vectors as candidates, the first one that is not in the span is taken
+			for (; e < dim; ++e) {
+				for (size_t i = 0; i < dim; ++i) {
+					Phi(i, n) = (i == e) ? 1. : 0.;
+				}
+				for (size_t iter = 0; iter < 2; ++iter) {
+					for (size_t m = 0; m < ntensor; ++m) {
+						if (m == n || (m < nNew && m > n)) { continue; }
+						T overlap = Phi.singleDotProduct(Phi, m, n);
+						for (size_t i = 0; i < dim; ++i) {
+							Phi(i, n) -= overlap * Phi(i, m);
+						}
+					}
+				}
+				double norm = sqrt(abs(Phi.singleDotProduct(Phi, n, n)));
+				if (norm > 0.1) {
+					for (size_t i = 0; i < dim; ++i) {
+						Phi(i, n) /= norm;
+					}
+					e++;
+					break;
+				}
+			}
+			assert(e <= dim);
+		}
+	}
+
+	template<typename T>
+	bool AdaptRanks(TensorTree<T>& Psi, Tree& tree, const SpectralDecompositionTree<T>& X,
+		const RankParameters& par) {
+		bool changed = false;
+		for (Node& node : tree) {
+			if (node.isToplayer()) { continue; }
+			Node& parent = node.parent();
+			size_t k = node.childIdx();
+			size_t n = node.shape().lastDimension();
+
+			size_t bound = min(node.shape().lastBefore(), parent.shape().totalDimension() / n);
+			bound = min(bound, par.maxRank);
+			size_t r = TargetRank(X[node].second, par);
+			r = min(max(r, par.minRank), bound);
+			if (r == n) { continue; }
+			changed = true;
+
+			/// Rotate the edge to the natural functions. This leaves the density
+			/// matrices of all other edges (and thereby X) unchanged.
+			const Matrix<T>& U = X[node].first;
+			Psi[node] = TensorMatrix(Psi[node], U, node.shape().lastIdx());
+			Psi[parent] = MatrixTensor(U.Adjoint(), Psi[parent], k);
+
+			/// Weak functions are in front and get removed first, new functions are added in front
+			node.shape().setDimension(r, node.shape().lastIdx());
+			parent.shape().setDimension(r, k);
+			Psi[node] = Psi[node].AdjustStateDim(r);
+			Psi[parent] = Psi[parent].AdjustActiveDim(r, k);
+			if (r > n) {
+				FillNewFunctions(Psi[node], r - n);
+			}
+		}
+		return changed;
+	}
+
+	template<typename T>
+	bool AdaptRanks(TensorTree<T>& Psi, Tree& tree, const RankParameters& par) {
+		MatrixTree<T> rho = Contraction(Psi, tree, true);
+		SpectralDecompositionTree<T> X(rho, tree);
+		return AdaptRanks(Psi, tree, X, par);
+	}
+
+	template<typename T>
+	TruncatedTree<T> Truncate(const TensorTree<T>& Psi, const Tree& tree,
+		const TruncationParameters& par) {
+		TruncatedTree<T> x{tree, Psi, vector<double>(tree.nNodes(), 0.), 0.};
+		Tree& newtree = x.tree;
+		TensorTree<T>& Chi = x.Psi;
+
+		/// Orthonormalize bottom-up: Phi = Q R, R goes to the parent
+		for (const Node& node : newtree) {
+			if (node.isToplayer()) { continue; }
+			Tensor<T> Q(Chi[node]);
+			GramSchmidt(Q);
+			Matrix<T> R = Contraction(Q, Chi[node], node.shape().lastIdx());
+			const Node& parent = node.parent();
+			Chi[parent] = MatrixTensor(R, Chi[parent], node.childIdx());
+			Chi[node] = Q;
+		}
+
+		Node& top = newtree.TopNode();
+		const Tensor<T>& A = Chi[top];
+		double norm2 = 0.;
+		for (size_t i = 0; i < A.shape().totalDimension(); ++i) {
+			norm2 += pow(abs(A(i)), 2);
+		}
+		size_t nEdges = max(newtree.nNodes() - 1, (size_t) 1);
+		double budget = par.eps * par.eps * norm2 / (double) nEdges;
+
+		/// Truncate top-down; rho of the lower node is diagonal after its edge is truncated
+		MatrixTree<T> rho(newtree);
+		rho[top] = IdentityMatrix<T>(top.shape().lastDimension());
+		double sum = 0.;
+		for (auto it = newtree.rbegin(); it != newtree.rend(); ++it) {
+			Node& node = *it;
+			if (node.isBottomlayer()) { continue; }
+			for (size_t k = 0; k < node.nChildren(); ++k) {
+				Node& child = node.child(k);
+				Tensor<T> Ket = multStateAB(rho[node], Chi[node]);
+				Matrix<T> rho_k = Contraction(Chi[node], Ket, k);
+				auto spec = Diagonalize(rho_k);
+				const Vectord& p = spec.second;
+				size_t n = p.Dim();
+
+				/// Populations are ascending: discard from the front
+				size_t drop = 0;
+				double discarded = 0.;
+				while (drop < n && discarded + abs(p(drop)) <= budget) {
+					discarded += abs(p(drop));
+					drop++;
+				}
+				size_t r = min(max(n - drop, par.minRank), par.maxRank);
+				r = max(min(r, n), (size_t) 1);
+				drop = n - r;
+				discarded = 0.;
+				for (size_t i = 0; i < drop; ++i) {
+					discarded += abs(p(i));
+				}
+
+				Matrix<T> U(n, r);
+				Matrix<T> rho_r(r, r);
+				for (size_t j = 0; j < r; ++j) {
+					for (size_t i = 0; i < n; ++i) {
+						U(i, j) = spec.first(i, drop + j);
+					}
+					rho_r(j, j) = p(drop + j);
+				}
+				Chi[child] = TensorMatrix(Chi[child], U, child.shape().lastIdx());
+				Chi[node] = MatrixTensor(U.Adjoint(), Chi[node], k);
+				child.shape().setDimension(r, child.shape().lastIdx());
+				node.shape().setDimension(r, k);
+				rho[child] = rho_r;
+				x.discarded[child.Address()] = discarded;
+				sum += discarded;
+			}
+		}
+		x.error = sqrt(sum);
+		return x;
+	}
+
+	typedef complex<double> cd;
+
+	template bool AdaptRanks(TensorTree<cd>& Psi, Tree& tree, const RankParameters& par);
+	template bool AdaptRanks(TensorTree<cd>& Psi, Tree& tree, const SpectralDecompositionTree<cd>& X,
+		const RankParameters& par);
+	template TruncatedTree<cd> Truncate(const TensorTree<cd>& Psi, const Tree& tree,
+		const TruncationParameters& par);
+
+	template bool AdaptRanks(TensorTree<double>& Psi, Tree& tree, const RankParameters& par);
+	template bool AdaptRanks(TensorTree<double>& Psi, Tree& tree, const SpectralDecompositionTree<double>& X,
+		const RankParameters& par);
+	template TruncatedTree<double> Truncate(const TensorTree<double>& Psi, const Tree& tree,
+		const TruncationParameters& par);
+}
@@ -0,0 +1,76 @@
+#include "TreeClasses/SOPSubtreeCache.h"
+#include <map>
+
+template<typename T>
+SOPSubtreeCache<T>::SOPSubtreeCache(const SOP<T>& sop, const Tree& tree) {
+	Initialize(sop, tree);
+}
+
+template<typename T>
+void SOPSubtreeCache<T>::Initialize(const SOP<T>& sop, const Tree& tree) {
+	/// Ordered list of (leaf mode, LeafOperator) that act below a node
+	typedef vector<pair<size_t, const void *>> Key;
+
+	groups_.clear();
+	groups_.resize(tree.nNodes());
+	vector<map<Key, size_t>> known(tree.nNodes());
+	vector<Key> keys(tree.nNodes());
+
+	for (size_t l = 0; l < sop.size(); ++l) {
+		const MLO<T>& M = sop[l];
+		for (auto& key : keys) { key.clear(); }
+
+		for (size_t i = 0; i < M.size(); ++i) {
+			size_t mode = M.Mode(i);
+			const void *op = M[i].get();
+			const Leaf& leaf = tree.GetLeaf(mode);
+			auto node = (const Node *) &leaf.Up();
+			while (!node->isToplayer()) {
+				keys[node->Address()].emplace_back(mode, op);
+				node = &node->parent();
+			}
+		}
+
+		for (const Node& node : tree) {
+			size_t addr = node.Address();
+			const Key& key = keys[addr];
+			if (key.empty()) { continue; }
+			auto it = known[addr].find(key);
+			if (it == known[addr].end()) {
+				known[addr][key] = groups_[addr].size();
+				groups_[addr].push_back({l, {}});
+			} else {
+				groups_[addr][it->second].shared.push_back(l);
+			}
+		}
+	}
+}
+
+template<typename T>
+size_t SOPSubtreeCache<T>::nMatrices() const {
+	size_t n = 0;
+	for (const auto& groups : groups_) {
+		for (const Group& group : groups) {
+			n += 1 + group.shared.size();
+		}
+	}
+	return n;
+}
+
+template<typename T>
+size_t SOPSubtreeCache<T>::nDistinct() const {
+	size_t n = 0;
+	for (const auto& groups : groups_) {
+		n += groups.size();
+	}
+	return n;
+}
+
+template<typename T>
+void SOPSubtreeCache<T>::print(ostream& os) const {
+	os << "SOPSubtreeCache: " << nDistinct() << " of " << nMatrices()
+	   << " matrices are computed per sweep.\n";
+}
+
+template class SOPSubtreeCache<complex<double>>;
+template class SOPSubtreeCache<double>;
@@ -65,6 +65,61 @@ namespace TreeFunctions {
 
 	template Tensor<cd> ApplyHole(const SparseMatrixTree<cd>& holes, Tensor<cd> Phi, const Node& hole_node);
 
+	template void RepresentLayer(SparseMatrixTree<cd>& mats, const Tensor<cd>& Bra,
+		const Tensor<cd>& Ket, const MLO<cd>& M, const Node& node, TreeWorkspace<cd>& work);
+
+	template void Represent(SparseMatrixTree<cd>& hmat, const MLO<cd>& M,
+		const TensorTree<cd>& Bra, const TensorTree<cd>& Ket,
+		const Tree& tree, TreeWorkspace<cd>& work);
+
+	template void Represent(SparseMatrixTrees<cd>& Mats, const SOP<cd>& sop,
+		const TensorTree<cd>& Bra, const TensorTree<cd>& Ket,
+		const Tree& tree, TreeWorkspace<cd>& work);
+
+	template void Represent(SOPMatrixTrees<cd>& mats, const SOP<cd>& sop,
+		const TensorTree<cd>& Bra, const TensorTree<cd>& Ket,
+		const Tree& tree, TreeWorkspace<cd>& work);
+
+	template void Contraction(SparseMatrixTree<cd>& holes, const TensorTree<cd>& Bra,
+		const TensorTree<cd>& Ket, const SparseMatrixTree<cd>& mats,
+		const Tree& tree, TreeWorkspace<cd>& work);
+
+	template void Contraction(SparseMatrixTree<cd>& holes, const TensorTree<cd>& Bra,
+		const TensorTree<cd>& Ket, const SparseMatrixTree<cd>& mats,
+		const MatrixTree<cd>& rho, const Tree& tree, TreeWorkspace<cd>& work);
+
+	template void Contraction(SparseMatrixTrees<cd>& holes, const SparseMatrixTrees<cd>& mats,
+		const TensorTree<cd>& Bra, const TensorTree<cd>& Ket,
+		const Tree& tree, TreeWorkspace<cd>& work);
+
+	template void Contraction(SparseMatrixTrees<cd>& holes, const TensorTree<cd>& Bra,
+		const TensorTree<cd>& Ket, const SparseMatrixTrees<cd>& mats,
+		const MatrixTree<cd>& rho, const Tree& tree, TreeWorkspace<cd>& work);
+
+	template void Represent(SparseMatrixTrees<cd>& Mats, const SOP<cd>& sop,
+		const TensorTree<cd>& Bra, const TensorTree<cd>& Ket,
+		const Tree& tree, TreeWorkspaces<cd>& work);
+
+	template void Represent(SOPMatrixTrees<cd>& mats, const SOP<cd>& sop,
+		const TensorTree<cd>& Bra, const TensorTree<cd>& Ket,
+		const Tree& tree, TreeWorkspaces<cd>& work);
+
+	template void Contraction(SparseMatrixTrees<cd>& holes, const SparseMatrixTrees<cd>& mats,
+		const TensorTree<cd>& Bra, const TensorTree<cd>& Ket,
+		const Tree& tree, TreeWorkspaces<cd>& work);
+
+	template void Contraction(SparseMatrixTrees<cd>& holes, const TensorTree<cd>& Bra,
+		const TensorTree<cd>& Ket, const SparseMatrixTrees<cd>& mats,
+		const MatrixTree<cd>& rho, const Tree& tree, TreeWorkspaces<cd>& work);
+
+	template void Represent(SparseMatrixTrees<cd>& Mats, const SOP<cd>& sop,
+		const TensorTree<cd>& Bra, const TensorTree<cd>& Ket, const SOPSubtreeCache<cd>& cache,
+		const Tree& tree, TreeWorkspaces<cd>& work);
+
+	template void Represent(SOPMatrixTrees<cd>& mats, const SOP<cd>& sop,
+		const TensorTree<cd>& Bra, const TensorTree<cd>& Ket, const SOPSubtreeCache<cd>& cache,
+		const Tree& tree, TreeWorkspaces<cd>& work);
+
 
 	typedef double d;
 	template void Represent(SparseMatrixTree<d>& hmat,
@@ -119,4 +174,59 @@ namespace TreeFunctions {
 
 	template Tensor<d> ApplyHole(const SparseMatrixTree<d>& holes, Tensor<d> Phi, const Node& hole_node);
 
+	template void RepresentLayer(SparseMatrixTree<d>& mats, const Tensor<d>& Bra,
+		const Tensor<d>& Ket, const MLO<d>& M, const Node& node, TreeWorkspace<d>& work);
+
+	template void Represent(SparseMatrixTree<d>& hmat, const MLO<d>& M,
+		const TensorTree<d>& Bra, const TensorTree<d>& Ket,
+		const Tree& tree, TreeWorkspace<d>& work);
+
+	template void Represent(SparseMatrixTrees<d>& Mats, const SOP<d>& sop,
+		const TensorTree<d>& Bra, const TensorTree<d>& Ket,
+		const Tree& tree, TreeWorkspace<d>& work);
+
+	template void Represent(SOPMatrixTrees<d>& mats, const SOP<d>& sop,
+		const TensorTree<d>& Bra, const TensorTree<d>& Ket,
+		const Tree& tree, TreeWorkspace<d>& work);
+
+	template void Contraction(SparseMatrixTree<d>& holes, const TensorTree<d>& Bra,
+		const TensorTree<d>& Ket, const SparseMatrixTree<d>& mats,
+		const Tree& tree, TreeWorkspace<d>& work);
+
+	template void Contraction(SparseMatrixTree<d>& holes, const TensorTree<d>& Bra,
+		const TensorTree<d>& Ket, const SparseMatrixTree<d>& mats,
+		const MatrixTree<d>& rho, const Tree& tree, TreeWorkspace<d>& work);
+
+	template void Contraction(SparseMatrixTrees<d>& holes, const SparseMatrixTrees<d>& mats,
+		const TensorTree<d>& Bra, const TensorTree<d>& Ket,
+		const Tree& tree, TreeWorkspace<d>& work);
+
+	template void Contraction(SparseMatrixTrees<d>& holes, const TensorTree<d>& Bra,
+		const TensorTree<d>& Ket, const SparseMatrixTrees<d>& mats,
+		const MatrixTree<d>& rho, const Tree& tree, TreeWorkspace<d>& work);
+
+	template void Represent(SparseMatrixTrees<d>& Mats, const SOP<d>& sop,
+		const TensorTree<d>& Bra, const TensorTree<d>& Ket,
+		const Tree& tree, TreeWorkspaces<d>& work);
+
+	template void Represent(SOPMatrixTrees<d>& mats, const SOP<d>& sop,
+		const TensorTree<d>& Bra, const TensorTree<d>& Ket,
+		const Tree& tree, TreeWorkspaces<d>& work);
+
+	template void Contraction(SparseMatrixTrees<d>& holes, const SparseMatrixTrees<d>& mats,
+		const TensorTree<d>& Bra, const TensorTree<d>& Ket,
+		const Tree& tree, TreeWorkspaces<d>& work);
+
+	template void Contraction(SparseMatrixTrees<d>& holes, const TensorTree<d>& Bra,
+		const TensorTree<d>& Ket, const SparseMatrixTrees<d>& mats,
+		const MatrixTree<d>& rho, const Tree& tree, TreeWorkspaces<d>& work);
+
+	template void Represent(SparseMatrixTrees<d>& Mats, const SOP<d>& sop,
+		const TensorTree<d>& Bra, const TensorTree<d>& Ket, const SOPSubtreeCache<d>& cache,
+		const Tree& tree, TreeWorkspaces<d>& work);
+
+	template void Represent(SOPMatrixTrees<d>& mats, const SOP<d>& sop,
+		const TensorTree<d>& Bra, const TensorTree<d>& Ket, const SOPSubtreeCache<d>& cache,
+		const Tree& tree, TreeWorkspaces<d>& work);
+
 }
@@ -0,0 +1,364 @@
+#include "TreeClasses/TensorTreeCheckpoint.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Checkpoint {
+
+	constexpr size_t headerSize = 64;
+	constexpr size_t align = 64;
+	const char magic[8] = {'Q', 'T', 'R', 'E', 'E', 'C', 'K', 'P'};
+
+	size_t RoundUp(size_t n) {
+		return (n + align - 1) / align * align;
+	}
+
+	void CheckEndianness() {
+		const uint16_t one = 1;
+		if (*(const char *) &one != 1) {
+			cerr << "Checkpoint: only little-endian machines are supported." << endl;
+			exit(1);
+		}
+	}
+
+	template<typename T>
+	uint32_t ScalarType();
+
+	template<>
+	uint32_t ScalarType<double>() { return 1; }
+
+	template<>
+	uint32_t ScalarType<complex<double>>() { return 2; }
+
+	/// Table for slicing-by-8: table[k][b] is the CRC of byte b followed by k zero bytes
+	struct CRCTable {
+		CRCTable() {
+			for (uint32_t b = 0; b < 256; ++b) {
+				uint32_t c = b;
+				for (size_t k = 0; k < 8; ++k) {
+					c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+				}
+				table[0][b] = c;
+			}
+			for (uint32_t b = 0; b < 256; ++b) {
+				for (size_t k = 1; k < 8; ++k) {
+					uint32_t c = table[k - 1][b];
+					table[k][b] = (c >> 8) ^ table[0][c & 0xFF];
+				}
+			}
+		}
+
+		uint32_t table[8][256];
+	};
+
+	uint32_t CRC32(const void *data, size_t size, uint32_t crc) {
+		static const CRCTable t;
+		const auto *p = (const unsigned char *) data;
+		crc = ~crc;
+		/// Eight bytes per iteration (little-endian)
+		for (; size >= 8; size -= 8, p += 8) {
+			uint32_t lo, hi;
+			memcpy(&lo, p, 4);
+			memcpy(&hi, p + 4, 4);
+			lo ^= crc;
+			crc = t.table[7][lo & 0xFF] ^ t.table[6][(lo >> 8) & 0xFF]
+				^ t.table[5][(lo >> 16) & 0xFF] ^ t.table[4][lo >> 24]
+				^ t.table[3][hi & 0xFF] ^ t.table[2][(hi >> 8) & 0xFF]
+				^ t.table[1][(hi >> 16) & 0xFF] ^ t.table[0][hi >> 24];
+		}
+		for (; size > 0; --size, ++p) {
+			crc = (crc >> 8) ^ t.table[0][(crc ^ *p) & 0xFF];
+		}
+		return ~crc;
+	}
+
+	/// Offsets of the tensors in the data block, same rule as the TensorTree slab
+	Index Layout(const vector<TensorShape>& shapes, size_t scalarSize) {
+		Index idx;
+		idx.version = version;
+		idx.shapes = shapes;
+		size_t indexSize = 0;
+		for (const TensorShape& shape : shapes) {
+			idx.offsets.push_back(idx.dataSize);
+			idx.dataSize += RoundUp(shape.totalDimension() * scalarSize);
+			indexSize += 16 + 8 * shape.order();
+		}
+		idx.crcs.resize(shapes.size(), 0);
+		idx.dataOffset = RoundUp(headerSize + indexSize);
+		return idx;
+	}
+
+	template<typename T>
+	void put(vector<char>& buf, T x) {
+		const char *p = (const char *) &x;
+		buf.insert(buf.end(), p, p + sizeof(T));
+	}
+
+	template<typename T>
+	T get(const char *& p) {
+		T x;
+		memcpy(&x, p, sizeof(T));
+		p += sizeof(T);
+		return x;
+	}
+
+	void WriteIndex(ostream& os, const Index& idx) {
+		vector<char> buf(magic, magic + 8);
+		put<uint32_t>(buf, idx.version);
+		put<uint32_t>(buf, idx.scalar);
+		put<uint32_t>(buf, idx.crc ? 1 : 0);
+		put<uint32_t>(buf, 0);
+		put<uint64_t>(buf, idx.shapes.size());
+		put<uint64_t>(buf, idx.dataOffset - headerSize);
+		put<uint64_t>(buf, idx.dataOffset);
+		put<uint64_t>(buf, idx.dataSize);
+		buf.resize(headerSize, 0);
+		for (size_t n = 0; n < idx.shapes.size(); ++n) {
+			const TensorShape& shape = idx.shapes[n];
+			put<uint64_t>(buf, idx.offsets[n]);
+			put<uint32_t>(buf, idx.crcs[n]);
+			put<uint32_t>(buf, shape.order());
+			for (size_t k = 0; k < shape.order(); ++k) {
+				put<uint64_t>(buf, shape[k]);
+			}
+		}
+		buf.resize(idx.dataOffset, 0);
+		os.write(buf.data(), buf.size());
+	}
+
+	void Fail(const string& msg) {
+		cerr << "Checkpoint: " << msg << endl;
+		exit(2);
+	}
+
+	Index ReadIndex(istream& is) {
+		CheckEndianness();
+		char header[headerSize];
+		is.read(header, headerSize);
+		if (!is.good()) { Fail("cannot read the header."); }
+		if (memcmp(header, magic, 8) != 0) { Fail("not a checkpoint file."); }
+		const char *p = header + 8;
+		Index idx;
+		idx.version = get<uint32_t>(p);
+		if (idx.version == 0 || idx.version > version) {
+			Fail("unsupported version " + to_string(idx.version) + ".");
+		}
+		idx.scalar = get<uint32_t>(p);
+		idx.crc = (get<uint32_t>(p) & 1);
+		get<uint32_t>(p);
+		auto nNodes = get<uint64_t>(p);
+		auto indexSize = get<uint64_t>(p);
+		idx.dataOffset = get<uint64_t>(p);
+		idx.dataSize = get<uint64_t>(p);
+		if (idx.dataOffset < headerSize + indexSize || idx.dataOffset % align != 0) {
+			Fail("corrupt header.");
+		}
+
+		/// The index up to the data block (including padding)
+		vector<char> buf(idx.dataOffset - headerSize);
+		is.read(buf.data(), buf.size());
+		if (!is.good()) { Fail("cannot read the index."); }
+		p = buf.data();
+		const char *end = buf.data() + indexSize;
+		for (size_t n = 0; n < nNodes; ++n) {
+			if (p + 16 > end) { Fail("corrupt index."); }
+			idx.offsets.push_back(get<uint64_t>(p));
+			idx.crcs.push_back(get<uint32_t>(p));
+			auto order = get<uint32_t>(p);
+			if (p + 8 * order > end) { Fail("corrupt index."); }
+			vector<size_t> dims;
+			for (size_t k = 0; k < order; ++k) {
+				dims.push_back(get<uint64_t>(p));
+			}
+			idx.shapes.emplace_back(dims);
+		}
+		return idx;
+	}
+
+	/// Check that the tensors fit into the data block
+	template<typename T>
+	void CheckIndex(const Index& idx) {
+		if (idx.scalar != ScalarType<T>()) { Fail("wrong scalar type."); }
+		for (size_t n = 0; n < idx.shapes.size(); ++n) {
+			size_t bytes = idx.shapes[n].totalDimension() * sizeof(T);
+			if (idx.offsets[n] % align != 0 || idx.offsets[n] + bytes > idx.dataSize) {
+				Fail("corrupt index.");
+			}
+		}
+	}
+
+	/// True if the slab of Psi has the layout of the data block
+	template<typename T>
+	bool SlabMatches(const TensorTree<T>& Psi, const Index& idx) {
+		if (!Psi.Contiguous() || Psi.dataSize() * sizeof(T) != idx.dataSize) { return false; }
+		for (size_t n = 0; n < Psi.size(); ++n) {
+			if ((&Psi.begin()[n][0] - Psi.data()) * sizeof(T) != idx.offsets[n]) { return false; }
+		}
+		return true;
+	}
+
+	template<typename T>
+	void VerifyCRC(const TensorTree<T>& Psi, const Index& idx) {
+		if (!idx.crc) { return; }
+		bool ok = true;
+#pragma omp parallel for schedule(dynamic) reduction(&&:ok)
+		for (size_t n = 0; n < Psi.size(); ++n) {
+			const Tensor<T>& Phi = Psi.begin()[n];
+			ok = ok && (CRC32(&Phi[0], Phi.shape().totalDimension() * sizeof(T)) == idx.crcs[n]);
+		}
+		if (!ok) { Fail("CRC mismatch."); }
+	}
+
+	template<typename T>
+	void Write(const TensorTree<T>& Psi, ostream& os, bool crc) {
+		CheckEndianness();
+		vector<TensorShape> shapes;
+		for (const Tensor<T>& Phi : Psi) {
+			shapes.push_back(Phi.shape());
+		}
+		Index idx = Layout(shapes, sizeof(T));
+		idx.scalar = ScalarType<T>();
+		idx.crc = crc;
+		if (crc) {
+#pragma omp parallel for schedule(dynamic)
+			for (size_t n = 0; n < Psi.size(); ++n) {
+				const Tensor<T>& Phi = Psi.begin()[n];
+				idx.crcs[n] = CRC32(&Phi[0], Phi.shape().totalDimension() * sizeof(T));
+			}
+		}
+		WriteIndex(os, idx);
+
+		if (SlabMatches(Psi, idx)) {
+			os.write((const char *) Psi.data(), idx.dataSize);
+		} else {
+			const vector<char> zeros(align, 0);
+			for (size_t n = 0; n < Psi.size(); ++n) {
+				const Tensor<T>& Phi = Psi.begin()[n];
+				size_t bytes = Phi.shape().totalDimension() * sizeof(T);
+				os.write((const char *) &Phi[0], bytes);
+				os.write(zeros.data(), RoundUp(bytes) - bytes);
+			}
+		}
+		os.flush();
+	}
+
+	template<typename T>
+	void Write(const TensorTree<T>& Psi, const string& filename, bool crc) {
+		ofstream os(filename, ios::binary);
+		Write(Psi, os, crc);
+		if (!os.good()) { Fail("cannot write " + filename + "."); }
+	}
+
+	template<typename T>
+	Index Create(const vector<TensorShape>& shapes, const string& filename) {
+		CheckEndianness();
+		Index idx = Layout(shapes, sizeof(T));
+		idx.scalar = ScalarType<T>();
+		idx.crc = false;
+		{
+			ofstream os(filename, ios::binary);
+			WriteIndex(os, idx);
+			if (!os.good()) { Fail("cannot write " + filename + "."); }
+		}
+		if (truncate(filename.c_str(), idx.dataOffset + idx.dataSize) != 0) {
+			Fail("cannot resize " + filename + ".");
+		}
+		return idx;
+	}
+
+	template<typename T>
+	void Read(TensorTree<T>& Psi, istream& is, bool verify) {
+		Index idx = ReadIndex(is);
+		CheckIndex<T>(idx);
+		Psi.InitializeContiguous(idx.shapes);
+		if (SlabMatches(Psi, idx)) {
+			is.read((char *) Psi.data(), idx.dataSize);
+		} else {
+			size_t pos = 0;
+			for (size_t n = 0; n < Psi.size(); ++n) {
+				Tensor<T>& Phi = Psi.begin()[n];
+				if (idx.offsets[n] < pos) { Fail("unsupported tensor order in the data block."); }
+				is.ignore(idx.offsets[n] - pos);
+				size_t bytes = Phi.shape().totalDimension() * sizeof(T);
+				is.read((char *) &Phi[0], bytes);
+				pos = idx.offsets[n] + bytes;
+			}
+			is.ignore(idx.dataSize - pos);
+		}
+		if (!is.good()) { Fail("file is truncated."); }
+		if (verify) { VerifyCRC(Psi, idx); }
+	}
+
+	template<typename T>
+	void Read(TensorTree<T>& Psi, const string& filename, bool verify) {
+		ifstream is(filename, ios::binary);
+		if (!is.good()) { Fail("cannot open " + filename + "."); }
+		Read(Psi, is, verify);
+	}
+
+	/// Read-only stream on a memory block
+	struct MemoryBuffer : public streambuf {
+		MemoryBuffer(char *begin, size_t size) { setg(begin, begin, begin + size); }
+	};
+}
+
+template<typename T>
+MappedTensorTree<T>::MappedTensorTree(const string& filename, bool verify) {
+	using namespace Checkpoint;
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) { Fail("cannot open " + filename + "."); }
+	struct stat st{};
+	fstat(fd, &st);
+	size_ = st.st_size;
+	if (size_ < headerSize) {
+		close(fd);
+		Fail("file is truncated.");
+	}
+	/// Private mapping: writes to Psi stay in memory
+	map_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map_ == MAP_FAILED) {
+		map_ = nullptr;
+		Fail("cannot map " + filename + ".");
+	}
+
+	MemoryBuffer buf((char *) map_, size_);
+	istream is(&buf);
+	index_ = ReadIndex(is);
+	CheckIndex<T>(index_);
+	if (index_.dataOffset + index_.dataSize > size_) { Fail("file is truncated."); }
+
+	T *data = (T *) ((char *) map_ + index_.dataOffset);
+	for (size_t n = 0; n < index_.shapes.size(); ++n) {
+		T *ptr = data + index_.offsets[n] / sizeof(T);
+		Psi_.attributes_.emplace_back(Tensor<T>(index_.shapes[n], ptr, false, false));
+	}
+	if (verify) { VerifyCRC(Psi_, index_); }
+}
+
+template<typename T>
+MappedTensorTree<T>::~MappedTensorTree() {
+	/// The views have to go before the memory
+	Psi_.attributes_.clear();
+	if (map_) { munmap(map_, size_); }
+}
+
+typedef complex<double> cd;
+
+template void Checkpoint::CheckIndex<cd>(const Checkpoint::Index& idx);
+template void Checkpoint::Write(const TensorTree<cd>& Psi, ostream& os, bool crc);
+template void Checkpoint::Write(const TensorTree<cd>& Psi, const string& filename, bool crc);
+template Checkpoint::Index Checkpoint::Create<cd>(const vector<TensorShape>& shapes, const string& filename);
+template void Checkpoint::Read(TensorTree<cd>& Psi, istream& is, bool verify);
+template void Checkpoint::Read(TensorTree<cd>& Psi, const string& filename, bool verify);
+template class MappedTensorTree<cd>;
+
+template void Checkpoint::CheckIndex<double>(const Checkpoint::Index& idx);
+template void Checkpoint::Write(const TensorTree<double>& Psi, ostream& os, bool crc);
+template void Checkpoint::Write(const TensorTree<double>& Psi, const string& filename, bool crc);
+template Checkpoint::Index Checkpoint::Create<double>(const vector<TensorShape>& shapes, const string& filename);
+template void Checkpoint::Read(TensorTree<double>& Psi, istream& is, bool verify);
+template void Checkpoint::Read(TensorTree<double>& Psi, const string& filename, bool verify);
+template class MappedTensorTree<double>;
@@ -38,3 +38,19 @@ template void TreeFunctions::Adjust<d>(TensorTree<d>& Psi, const Tree& newtree);
 
 template void TreeFunctions::Sum(TensorTree<d>& Psi, Tree& tree, const TensorTree<d>& Chi, bool sameLeafs, bool sumToplayer);
 template void TreeFunctions::Sum(TensorTree<cd>& Psi, Tree& tree, const TensorTree<cd>& Chi, bool sameLeafs, bool sumToplayer);
+
+template void TreeFunctions::Scal(TensorTree<cd>& x, cd alpha);
+template void TreeFunctions::Axpy(TensorTree<cd>& y, cd alpha, const TensorTree<cd>& x);
+template void TreeFunctions::Axpby(TensorTree<cd>& y, cd alpha, const TensorTree<cd>& x, cd beta);
+template void TreeFunctions::Axpbz(TensorTree<cd>& y, cd alpha, const TensorTree<cd>& x, cd beta, const TensorTree<cd>& z);
+template void TreeFunctions::LinearCombination(TensorTree<cd>& y, cd alpha, const TensorTree<cd>& x, cd beta, const TensorTree<cd>& z);
+template cd TreeFunctions::Dot(const TensorTree<cd>& x, const TensorTree<cd>& y);
+template double TreeFunctions::Nrm2(const TensorTree<cd>& x);
+
+template void TreeFunctions::Scal(TensorTree<d>& x, d alpha);
+template void TreeFunctions::Axpy(TensorTree<d>& y, d alpha, const TensorTree<d>& x);
+template void TreeFunctions::Axpby(TensorTree<d>& y, d alpha, const TensorTree<d>& x, d beta);
+template void TreeFunctions::Axpbz(TensorTree<d>& y, d alpha, const TensorTree<d>& x, d beta, const TensorTree<d>& z);
+template void TreeFunctions::LinearCombination(TensorTree<d>& y, d alpha, const TensorTree<d>& x, d beta, const TensorTree<d>& z);
+template d TreeFunctions::Dot(const TensorTree<d>& x, const TensorTree<d>& y);
+template double TreeFunctions::Nrm2(const TensorTree<d>& x);
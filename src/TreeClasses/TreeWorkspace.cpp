@@ -0,0 +1,26 @@
+#include "TreeClasses/TreeWorkspace.h"
+
+template<typename T>
+TreeWorkspace<T>::TreeWorkspace(const Tree& tree) {
+	Initialize(tree);
+}
+
+template<typename T>
+void TreeWorkspace<T>::Initialize(const Tree& tree) {
+	buffers_.clear();
+	holes_.clear();
+	buffers_.resize(tree.nNodes());
+	holes_.resize(tree.nNodes());
+	for (const Node& node : tree) {
+		size_t addr = node.Address();
+		for (size_t i = 0; i < 2; ++i) {
+			buffers_[addr][i] = Tensor<T>(node.shape(), false);
+			if (!node.isToplayer()) {
+				holes_[addr][i] = Tensor<T>(node.parent().shape(), false);
+			}
+		}
+	}
+}
+
+template class TreeWorkspace<complex<double>>;
+template class TreeWorkspace<double>;
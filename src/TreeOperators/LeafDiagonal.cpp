@@ -0,0 +1,31 @@
+#include "TreeOperators/LeafDiagonal.h"
+#include "Core/LAKernels.h"
+
+template<typename T>
+LeafDiagonal<T>::LeafDiagonal(Vector<T> d)
+	: d_(move(d)) {}
+
+template<typename T>
+void LeafDiagonal<T>::Apply(const LeafInterface& grid, Tensor<T>& hAcoeff,
+	const Tensor<T>& Acoeff) const {
+	const TensorShape& shape = Acoeff.shape();
+	assert(shape[0] == d_.Dim());
+	assert(hAcoeff.shape().totalDimension() == shape.totalDimension());
+	size_t dim = d_.Dim();
+	LAKernels::diagmat(&hAcoeff[0], &Acoeff[0], d_.Coeffs(), dim, shape.totalDimension() / dim);
+}
+
+template<typename T>
+Matrix<T> LeafDiagonal<T>::Dense() const {
+	Matrix<T> h(d_.Dim(), d_.Dim());
+	for (size_t i = 0; i < d_.Dim(); ++i) {
+		h(i, i) = d_(i);
+	}
+	return h;
+}
+
+template
+class LeafDiagonal<complex<double>>;
+
+template
+class LeafDiagonal<double>;
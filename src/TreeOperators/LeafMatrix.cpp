@@ -3,10 +3,17 @@
 //
 
 #include "TreeOperators/LeafMatrix.h"
+#include "TreeOperators/LeafDiagonal.h"
+#include "TreeOperators/LeafSparseMatrix.h"
 
 Matrixcd toMatrix(const LeafOperatorcd& h, const Leaf& leaf) {
-	size_t mode = leaf.Mode();
 	size_t dim = leaf.Dim();
+	/// Diagonal and sparse SPOs know their matrix, no need to apply them to unit vectors
+	if (auto d = dynamic_cast<const LeafDiagonalcd *>(&h)) {
+		if (d->Dim() == dim) { return d->Dense(); }
+	} else if (auto s = dynamic_cast<const LeafSparseMatrixcd *>(&h)) {
+		if (s->Dim1() == dim && s->Dim2() == dim) { return s->Dense(); }
+	}
 	TensorShape shape{dim, dim};
 	Tensorcd v(shape);
 	Tensorcd hv(shape);
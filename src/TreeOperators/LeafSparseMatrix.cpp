@@ -0,0 +1,80 @@
+#include "TreeOperators/LeafSparseMatrix.h"
+#include "Core/LAKernels.h"
+
+template<typename T>
+LeafSparseMatrix<T>::LeafSparseMatrix(const Matrix<T>& h, double eps)
+	: dim1_(h.Dim1()), dim2_(h.Dim2()) {
+	rowPtr_.assign(1, 0);
+	for (size_t i = 0; i < dim1_; ++i) {
+		for (size_t j = 0; j < dim2_; ++j) {
+			if (abs(h(i, j)) > eps) {
+				col_.push_back(j);
+				val_.push_back(h(i, j));
+			}
+		}
+		rowPtr_.push_back(val_.size());
+	}
+}
+
+template<typename T>
+LeafSparseMatrix<T>::LeafSparseMatrix(size_t dim1, size_t dim2, vector<size_t> rowPtr,
+	vector<size_t> col, vector<T> val)
+	: dim1_(dim1), dim2_(dim2), rowPtr_(move(rowPtr)), col_(move(col)), val_(move(val)) {
+	if (rowPtr_.size() != dim1_ + 1 || rowPtr_.front() != 0 || rowPtr_.back() != val_.size()
+		|| col_.size() != val_.size()) {
+		cerr << "LeafSparseMatrix: inconsistent CSR arrays." << endl;
+		exit(1);
+	}
+	for (size_t j : col_) {
+		if (j >= dim2_) {
+			cerr << "LeafSparseMatrix: column index " << j << " out of range." << endl;
+			exit(1);
+		}
+	}
+}
+
+template<typename T>
+void LeafSparseMatrix<T>::Apply(const LeafInterface& grid, Tensor<T>& hAcoeff,
+	const Tensor<T>& Acoeff) const {
+	const TensorShape& shape = Acoeff.shape();
+	assert(shape[0] == dim2_);
+	size_t nCols = shape.totalDimension() / dim2_;
+	assert(hAcoeff.shape().totalDimension() == dim1_ * nCols);
+	LAKernels::csrmat(&hAcoeff[0], &Acoeff[0], rowPtr_.data(), col_.data(), val_.data(),
+		dim1_, dim2_, nCols);
+}
+
+template<typename T>
+Matrix<T> LeafSparseMatrix<T>::Dense() const {
+	Matrix<T> h(dim1_, dim2_);
+	for (size_t i = 0; i < dim1_; ++i) {
+		for (size_t p = rowPtr_[i]; p < rowPtr_[i + 1]; ++p) {
+			h(i, col_[p]) += val_[p];
+		}
+	}
+	return h;
+}
+
+template<typename T>
+void LeafSparseMatrix<T>::ScaleRows(const Vector<T>& d) {
+	assert(d.Dim() == dim1_);
+	for (size_t i = 0; i < dim1_; ++i) {
+		for (size_t p = rowPtr_[i]; p < rowPtr_[i + 1]; ++p) {
+			val_[p] *= d(i);
+		}
+	}
+}
+
+template<typename T>
+void LeafSparseMatrix<T>::ScaleColumns(const Vector<T>& d) {
+	assert(d.Dim() == dim2_);
+	for (size_t p = 0; p < val_.size(); ++p) {
+		val_[p] *= d(col_[p]);
+	}
+}
+
+template
+class LeafSparseMatrix<complex<double>>;
+
+template
+class LeafSparseMatrix<double>;
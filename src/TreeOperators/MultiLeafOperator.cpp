@@ -1,4 +1,37 @@
 #include "TreeOperators/MultiLeafOperator.h"
+#include "Core/LAKernels.h"
+
+namespace {
+	/// Matrix representation of a SPO in the primitive basis of leaf
+	template<typename T>
+	Matrix<T> Probe(const LeafOperator<T>& h, const Leaf& leaf) {
+		size_t dim = leaf.Dim();
+		TensorShape shape({dim, dim});
+		Tensor<T> v(shape);
+		Tensor<T> hv(shape);
+		for (size_t i = 0; i < dim; ++i) {
+			v(i, i) = 1.;
+		}
+		h.Apply(leaf.PrimitiveGrid(), hv, v);
+		Matrix<T> H(dim, dim);
+		for (size_t j = 0; j < dim; ++j) {
+			for (size_t i = 0; i < dim; ++i) {
+				H(i, j) = hv(i, j);
+			}
+		}
+		return H;
+	}
+
+	template<typename T>
+	bool IsDiagonal(const Matrix<T>& H) {
+		for (size_t j = 0; j < H.Dim2(); ++j) {
+			for (size_t i = 0; i < H.Dim1(); ++i) {
+				if (i != j && H(i, j) != T(0.)) { return false; }
+			}
+		}
+		return true;
+	}
+}
 
 
 template <typename T>
@@ -7,11 +40,165 @@ MultiLeafOperator<T>::MultiLeafOperator()
 	targetLeaves_.clear();
 }
 
+template<typename T>
+void MultiLeafOperator<T>::Compile(const Tree& tree) {
+	steps_.assign(tree.nLeaves(), vector<LeafStep>());
+	compiledDims_.assign(tree.nLeaves(), 0);
+	for (size_t k = 0; k < tree.nLeaves(); ++k) {
+		const Leaf& leaf = tree.GetLeaf(k);
+		size_t mode_x = leaf.Mode();
+		size_t dim = leaf.Dim();
+		if (mode_x >= steps_.size()) {
+			steps_.resize(mode_x + 1);
+			compiledDims_.resize(mode_x + 1, 0);
+		}
+		compiledDims_[mode_x] = dim;
+		vector<LeafStep>& steps = steps_[mode_x];
+
+		/// Fused factor that has not been written to steps yet
+		Matrix<T> h;
+		Vector<T> diag;
+		LeafSparseMatrix<T> sparse;
+		bool hasMatrix = false;
+		bool hasDiag = false;
+		bool hasSparse = false;
+		auto flush = [&]() {
+			if (hasMatrix) {
+				steps.push_back({h, Vector<T>(), nullptr, false});
+			} else if (hasSparse) {
+				steps.push_back({Matrix<T>(), Vector<T>(), make_shared<LeafSparseMatrix<T>>(sparse), false});
+			} else if (hasDiag) {
+				steps.push_back({Matrix<T>(), diag, nullptr, true});
+			}
+			hasMatrix = false;
+			hasDiag = false;
+			hasSparse = false;
+		};
+
+		for (size_t l = 0; l < leafOperators_.size(); ++l) {
+			if (mode_x != targetLeaves_[l]) { continue; }
+			const shared_ptr<LeafOperator<T>>& spo = leafOperators_[l];
+
+			Matrix<T> H;
+			Vector<T> D;
+			shared_ptr<LeafSparseMatrix<T>> S;
+			bool isMatrix = false;
+			bool isDiag = false;
+			if (auto d = dynamic_pointer_cast<LeafDiagonal<T>>(spo)) {
+				isDiag = (d->Dim() == dim);
+				if (isDiag) { D = d->diag(); }
+			} else if (auto sp = dynamic_pointer_cast<LeafSparseMatrix<T>>(spo)) {
+				if (sp->Dim1() == dim && sp->Dim2() == dim) { S = sp; }
+			} else {
+				bool known = false;
+				if (auto m = dynamic_pointer_cast<LeafMatrix<T>>(spo)) {
+					isMatrix = (m->matrix().Dim1() == dim) && (m->matrix().Dim2() == dim);
+					known = isMatrix;
+					if (isMatrix) { H = m->matrix(); }
+				} else if (dynamic_pointer_cast<LeafFunction<T>>(spo)) {
+					H = Probe(*spo, leaf);
+					known = true;
+				}
+				if (known && IsDiagonal(H)) {
+					isDiag = true;
+					isMatrix = false;
+					D = Vector<T>(dim);
+					for (size_t i = 0; i < dim; ++i) {
+						D(i) = H(i, i);
+					}
+				}
+			}
+
+			if (isDiag) {
+				if (hasMatrix) {
+					for (size_t j = 0; j < dim; ++j) {
+						for (size_t i = 0; i < dim; ++i) {
+							h(i, j) *= D(i);
+						}
+					}
+				} else if (hasSparse) {
+					sparse.ScaleRows(D);
+				} else if (hasDiag) {
+					for (size_t i = 0; i < dim; ++i) {
+						diag(i) *= D(i);
+					}
+				} else {
+					diag = D;
+					hasDiag = true;
+				}
+			} else if (S) {
+				if (hasMatrix) {
+					/// Dense stays dense
+					h = S->Dense() * h;
+				} else {
+					if (hasSparse) { flush(); }
+					sparse = *S;
+					if (hasDiag) { sparse.ScaleColumns(diag); }
+					hasSparse = true;
+					hasDiag = false;
+				}
+			} else if (isMatrix) {
+				if (hasMatrix) {
+					h = H * h;
+				} else if (hasSparse) {
+					h = H * sparse.Dense();
+					hasMatrix = true;
+					hasSparse = false;
+				} else {
+					h = H;
+					if (hasDiag) {
+						for (size_t j = 0; j < dim; ++j) {
+							for (size_t i = 0; i < dim; ++i) {
+								h(i, j) *= diag(j);
+							}
+						}
+					}
+					hasMatrix = true;
+					hasDiag = false;
+				}
+			} else {
+				flush();
+				steps.push_back({Matrix<T>(), Vector<T>(), spo, false});
+			}
+		}
+		flush();
+	}
+	compiled_ = true;
+}
+
+template<typename T>
+const Tensor<T>& MultiLeafOperator<T>::ApplySteps(const vector<LeafStep>& steps,
+	const LeafInterface& grid, const Tensor<T>& Phi, Tensor<T>& work1, Tensor<T>& work2) const {
+	const Tensor<T> *in = &Phi;
+	Tensor<T> *out = &work1;
+	for (const LeafStep& step : steps) {
+		if (step.spo) {
+			step.spo->Apply(grid, *out, *in);
+		} else if (!step.diagonal) {
+			MatrixTensor(*out, step.h, *in, 0, true);
+		} else {
+			/// Diagonal in the primitive basis: a single scaling pass
+			size_t dim = step.diag.Dim();
+			LAKernels::diagmat(&(*out)[0], &(*in)[0], step.diag.Coeffs(), dim,
+				in->shape().totalDimension() / dim);
+		}
+		in = out;
+		out = (out == &work1) ? &work2 : &work1;
+	}
+	return *in;
+}
+
 template <typename T>
 Tensor<T> MultiLeafOperator<T>::ApplyBottomLayer(Tensor<T> Phi,
 	const Leaf& leaf) const {
 	Tensor<T> hPhi(Phi.shape());
 	size_t mode_x = leaf.Mode();
+	if (UseCompiled(leaf)) {
+		/// Phi is a copy and can be used as the second buffer
+		const Tensor<T>& result = ApplySteps(steps_[mode_x], leaf.PrimitiveGrid(), Phi, hPhi, Phi);
+		if (&result == &hPhi) { return hPhi; }
+		return Phi;
+	}
 	const LeafInterface& grid = leaf.PrimitiveGrid();
 	bool switchbool = true;
 
@@ -36,6 +223,25 @@ Tensor<T> MultiLeafOperator<T>::ApplyBottomLayer(Tensor<T> Phi,
 	}
 }
 
+template<typename T>
+const Tensor<T>& MultiLeafOperator<T>::ApplyBottomLayer(const Tensor<T>& Phi,
+	Tensor<T>& work1, Tensor<T>& work2, const Leaf& leaf) const {
+	size_t mode_x = leaf.Mode();
+	const LeafInterface& grid = leaf.PrimitiveGrid();
+	if (UseCompiled(leaf)) {
+		return ApplySteps(steps_[mode_x], grid, Phi, work1, work2);
+	}
+	const Tensor<T> *in = &Phi;
+	Tensor<T> *out = &work1;
+	for (size_t l = 0; l < leafOperators_.size(); ++l) {
+		if (mode_x != targetLeaves_[l]) { continue; }
+		leafOperators_[l]->Apply(grid, *out, *in);
+		in = out;
+		out = (out == &work1) ? &work2 : &work1;
+	}
+	return *in;
+}
+
 template <typename T>
 Tensor<T> MultiLeafOperator<T>::ApplyBottomLayer(Tensor<T> Acoeffs,
 	const vector<int>& list, const LeafInterface& grid) const {
@@ -75,19 +281,9 @@ void MultiLeafOperator<T>::ApplyReference(TensorTree<T>& Psi, const Tree& tree)
 	for (const Node& node : tree) {
 		if (node.isBottomlayer()) {
 			const Leaf& phy = node.getLeaf();
-			const LeafInterface& grid = phy.PrimitiveGrid();
-			size_t coord = phy.Mode();
-
-			// build list with active_ parts
-			vector<int> activelayerparts;
-			for (size_t l = 0; l < leafOperators_.size(); l++) {
-				if (targetLeaves_[l] == coord) {
-					activelayerparts.push_back(l);
-				}
-			}
-
+			if (!ModeIsActive(phy.Mode())) { continue; }
 			Tensor<T>& Acoeff = Psi[node];
-			Acoeff = ApplyBottomLayer(Acoeff, activelayerparts, grid);
+			Acoeff = ApplyBottomLayer(Acoeff, phy);
 		}
 	}
 }
@@ -3,6 +3,7 @@
 //
 
 #include "TreeOperators/TensorOperators/TensorOperatorTree.h"
+#include "Core/Tensor_Extension.h"
 
 TensorOperatorTree::TensorOperatorTree(const MLOcd& M,
 	const Tree& tree)
@@ -23,11 +24,101 @@ TensorOperatorTree::TensorOperatorTree(const MLOcd& M,
 	}
 }
 
+namespace {
+	/// Product of all LeafOperators of M that act on leaf (in order of application)
+	Matrixcd LeafProduct(const MLOcd& M, const Leaf& leaf) {
+		Matrixcd h = IdentityMatrixcd(leaf.Dim());
+		for (size_t k = 0; k < M.size(); ++k) {
+			if (M.Mode(k) == leaf.Mode()) {
+				h = toMatrix(*M[k], leaf) * h;
+			}
+		}
+		return h;
+	}
+}
+
 TensorOperatorTree::TensorOperatorTree(const SOPcd& S,
-	const Tree& tree)
-	: TensorOperatorTree(tree) {
-	Occupy(tree);
+	const Tree& tree) {
+	/**
+	 * The SOP is a direct sum of its terms, i.e. a tensor operator tree of
+	 * rank S.size() at every edge. Instead of building this tree, the rank is
+	 * reduced bottom-up on the fly: R[node] maps the numerically independent
+	 * operators at the node to the terms, (U, sigma, V) = SVD(term matrix).
+	 * Only the columns with non-vanishing singular values are kept, the
+	 * truncation is numerically exact. Use TreeFunctions::Compress to
+	 * truncate the ranks for a given accuracy.
+	 */
 	assert(S.size() > 0);
+	size_t nterms = S.size();
+	attributes_.clear();
+	attributes_.resize(tree.nNodes());
+	vector<Matrixcd> R(tree.nNodes());
+
+	for (const Node& node : tree) {
+		/// Shape of the node without the operator index towards the parent
+		vector<size_t> dims;
+		if (node.isBottomlayer()) {
+			size_t leafdim = node.getLeaf().Dim();
+			dims = {leafdim, leafdim};
+		} else {
+			for (size_t k = 0; k < node.nChildren(); ++k) {
+				dims.push_back(R[node.child(k).Address()].Dim1());
+			}
+		}
+		dims.push_back(1);
+		TensorShape shape(dims);
+		size_t dim = shape.lastBefore();
+
+		/// Matrix of all terms at this node, first index: operator, second: term
+		Matrixcd A(dim, nterms);
+		for (size_t l = 0; l < nterms; ++l) {
+			if (node.isBottomlayer()) {
+				Matrixcd h = LeafProduct(S[l], node.getLeaf());
+				for (size_t I = 0; I < dim; ++I) {
+					A(I, l) = h[I];
+				}
+			} else {
+				for (size_t I = 0; I < dim; ++I) {
+					vector<size_t> Ibreak = indexMapping(I, shape);
+					complex<double> a = 1.;
+					for (size_t k = 0; k < node.nChildren(); ++k) {
+						a *= R[node.child(k).Address()](Ibreak[k], l);
+					}
+					A(I, l) = a;
+				}
+			}
+		}
+
+		if (node.isToplayer()) {
+			Tensorcd B(shape);
+			for (size_t l = 0; l < nterms; ++l) {
+				for (size_t I = 0; I < dim; ++I) {
+					B(I, 0) += S.Coeff(l) * A(I, l);
+				}
+			}
+			operator[](node) = B;
+		} else {
+			auto svd = Tensor_Extension::SVD(A);
+			const Matrixcd& U = get<0>(svd);
+			const Matrixcd& V = get<1>(svd);
+			const Vectord& sigma = get<2>(svd);
+			size_t r = Tensor_Extension::NumericalRank(sigma);
+
+			shape.setDimension(r, shape.lastIdx());
+			Tensorcd B(shape);
+			Matrixcd& Rnode = R[node.Address()];
+			Rnode = Matrixcd(r, nterms);
+			for (size_t i = 0; i < r; ++i) {
+				for (size_t I = 0; I < dim; ++I) {
+					B(I, i) = U(I, i);
+				}
+				for (size_t l = 0; l < nterms; ++l) {
+					Rnode(i, l) = sigma(i) * conj(V(l, i));
+				}
+			}
+			operator[](node) = B;
+		}
+	}
 }
 
 TensorOperatorTree::TensorOperatorTree(const Tree& tree) {
@@ -3,6 +3,38 @@
 //
 
 #include "TreeOperators/TensorOperators/TensorOperatorTreeFunctions.h"
+#include "Core/Tensor_Extension.h"
+
+namespace {
+	/// Matrix with rows: index k, columns: all other indices
+	Matrixcd Matricize(const Tensorcd& A, size_t k) {
+		const TensorShape& shape = A.shape();
+		size_t before = shape.before(k);
+		size_t active = shape[k];
+		size_t after = shape.after(k);
+		Matrixcd M(active, before * after);
+		for (size_t c = 0; c < after; ++c) {
+			for (size_t a = 0; a < active; ++a) {
+				for (size_t b = 0; b < before; ++b) {
+					M(a, b + before * c) = A(b + before * (a + active * c));
+				}
+			}
+		}
+		return M;
+	}
+
+	/// sigma is sorted descending, discard the smallest singular values
+	/// while their squared sum stays below eps^2
+	size_t TruncatedRank(const Vectord& sigma, double eps) {
+		double discarded = 0.;
+		size_t r = sigma.Dim();
+		for (; r > 1; --r) {
+			discarded += pow(sigma(r - 1), 2);
+			if (discarded > eps * eps) { break; }
+		}
+		return r;
+	}
+}
 
 namespace TreeFunctions {
 
@@ -143,6 +175,95 @@ namespace TreeFunctions {
 		return Hmean;
 	}
 
-}
+	void Orthonormalize(TensorOperatorTree& H, const Tree& tree) {
+		/// Bottom-up SVD of every node, sigma * V^dagger is moved into the parent
+		for (const Node& node : tree) {
+			if (node.isToplayer()) { continue; }
+			Tensorcd& B = H[node];
+			TensorShape shape = B.shape();
+			size_t dim = shape.lastBefore();
+			size_t ldim = shape.lastDimension();
+			Matrixcd A(dim, ldim);
+			for (size_t i = 0; i < A.Dim1() * A.Dim2(); ++i) {
+				A[i] = B[i];
+			}
+
+			auto svd = Tensor_Extension::SVD(A);
+			const Matrixcd& U = get<0>(svd);
+			const Matrixcd& V = get<1>(svd);
+			const Vectord& sigma = get<2>(svd);
+			size_t r = Tensor_Extension::NumericalRank(sigma);
+
+			shape.setDimension(r, shape.lastIdx());
+			B = Tensorcd(shape);
+			Matrixcd R(r, ldim);
+			for (size_t i = 0; i < r; ++i) {
+				for (size_t I = 0; I < dim; ++I) {
+					B(I, i) = U(I, i);
+				}
+				for (size_t l = 0; l < ldim; ++l) {
+					R(i, l) = sigma(i) * conj(V(l, i));
+				}
+			}
+			Tensorcd& P = H[node.parent()];
+			P = MatrixTensor(R, P, node.childIdx());
+		}
+	}
+
+	void Compress(TensorOperatorTree& H, const Tree& tree, double eps) {
+		Orthonormalize(H, tree);
+
+		/// Top-down: the operator above the edge of a node equals L[node] * V^dagger
+		/// with orthonormal V, so the singular values at the edge of a child are
+		/// those of its parent tensor with L[parent] applied to the parent index.
+		vector<Matrixcd> U(tree.nNodes());
+		vector<size_t> ranks(tree.nNodes());
+		vector<Matrixcd> L(tree.nNodes());
+		const Node& top = tree.TopNode();
+		double norm = sqrt(abs(H[top].DotProduct(H[top]).Trace()));
+		for (auto it = tree.rbegin(); it != tree.rend(); ++it) {
+			const Node& node = *it;
+			if (node.isToplayer()) { continue; }
+			const Node& parent = node.parent();
+			Tensorcd P = H[parent];
+			if (!parent.isToplayer()) {
+				P = TensorMatrix(P, L[parent.Address()], P.shape().lastIdx());
+			}
+			auto svd = Tensor_Extension::SVD(Matricize(P, node.childIdx()));
+			const Vectord& sigma = get<2>(svd);
+			U[node.Address()] = get<0>(svd);
+			ranks[node.Address()] = TruncatedRank(sigma, eps * norm);
+			Matrixcd& Lnode = L[node.Address()];
+			Lnode = get<0>(svd);
+			for (size_t j = 0; j < Lnode.Dim2(); ++j) {
+				for (size_t i = 0; i < Lnode.Dim1(); ++i) {
+					Lnode(i, j) *= sigma(j);
+				}
+			}
+		}
 
+		/// Project every edge onto its dominant left singular vectors
+		for (const Node& node : tree) {
+			if (node.isToplayer()) { continue; }
+			const Matrixcd& u = U[node.Address()];
+			size_t r = ranks[node.Address()];
+			Matrixcd W(u.Dim1(), r);
+			for (size_t j = 0; j < r; ++j) {
+				for (size_t i = 0; i < u.Dim1(); ++i) {
+					W(i, j) = u(i, j);
+				}
+			}
+			Tensorcd& B = H[node];
+			B = TensorMatrix(B, W, B.shape().lastIdx());
+			Tensorcd& P = H[node.parent()];
+			P = MatrixTensor(W.Adjoint(), P, node.childIdx());
+		}
+	}
+
+	TensorOperatorTree Compress(const SOPcd& S, const Tree& tree, double eps) {
+		TensorOperatorTree H(S, tree);
+		Compress(H, tree, eps);
+		return H;
+	}
 
+}
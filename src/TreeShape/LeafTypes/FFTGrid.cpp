@@ -1,8 +1,8 @@
 #include "TreeShape/LeafTypes/FFTGrid.h"
-#include "Util/FFT.h"
+#include "Util/QMConstants.h"
 
 FFTGrid::FFTGrid(int dim)
-	: dim_(dim), x_(dim), p_(dim), trafo_(dim, dim) {}
+	: dim_(dim), x_(dim), p_(dim), phase_(dim) {}
 
 void FFTGrid::Initialize(double x0, double x1, double wfr0, double wfomega) {
 	x0_ = x0;
@@ -20,19 +20,43 @@ void FFTGrid::Initialize(double x0, double x1, double wfr0, double wfomega) {
 	}
 
 	// Set p_ values
-	double pi = 3.1415926538375;
-	double dp = 2 * pi / (dx * dim_);
+	double dp = QM::two_pi / (dx * dim_);
 	double prange = (dim_ - 1) * dp;
 	double p0 = -prange / 2.;
 	for (int i = 0; i < dim_; i++) {
 		p_(i) = p0 + i * dp;
 	}
 
-	complex<double> imag(0., 1.);
-	for (int i = 0; i < dim_; i++)
-		for (int j = 0; j < dim_; j++)
-			trafo_(j, i) = exp(-imag * (x_(i) - x0_) * p_(j)) / sqrt(1. * dim_);
-//			trafo_(j, i) = exp(-imag*(x_(i) - x0_)*(p_(j) - p0));
+	// exp(-i (x_i - x0) p_j) = exp(-i (x_i - x0) p0) exp(-2 pi i ij / dim):
+	// a phase on the grid followed by a discrete Fourier transform
+	for (int i = 0; i < dim_; i++) {
+		phase_(i) = exp(-QM::im * (x_(i) - x0_) * p0) / sqrt(1. * dim_);
+	}
+	plan_ = FFTPlan(dim_);
+}
+
+void FFTGrid::Forward(Tensorcd& A) const {
+	assert(plan_.size() == (size_t) dim_);
+	assert(A.shape()[0] == (size_t) dim_);
+	size_t nBatch = A.shape().totalDimension() / dim_;
+	for (size_t n = 0; n < nBatch; n++) {
+		complex<double> *col = &A[n * dim_];
+		for (int i = 0; i < dim_; i++)
+			col[i] *= phase_(i);
+		plan_.Execute(col, -1);
+	}
+}
+
+void FFTGrid::Backward(Tensorcd& A) const {
+	assert(plan_.size() == (size_t) dim_);
+	assert(A.shape()[0] == (size_t) dim_);
+	size_t nBatch = A.shape().totalDimension() / dim_;
+	for (size_t n = 0; n < nBatch; n++) {
+		complex<double> *col = &A[n * dim_];
+		plan_.Execute(col, 1);
+		for (int i = 0; i < dim_; i++)
+			col[i] *= conj(phase_(i));
+	}
 }
 
 void FFTGrid::applyX(Tensorcd& xA, const Tensorcd& Acoeffs) const {
@@ -57,17 +81,17 @@ void FFTGrid::applyP(Tensorcd& pA, const Tensorcd& Acoeffs) const {
 	for (int n = 0; n < Acoeffs.shape().lastDimension(); n++)
 		for (int i = 0; i < dim_; i++)
 			pA(i, n) *= -p_(i);
-
-	Tensorcd tmp(pA);
-	ToGrid(pA, tmp);
+	Backward(pA);
 }
 
 void FFTGrid::ToGrid(Tensorcd& uA, const Tensorcd& Acoeffs) const {
-	uA = multATB(trafo_, Acoeffs, 0);
+	uA = Acoeffs;
+	Backward(uA);
 }
 
 void FFTGrid::FromGrid(Tensorcd& uA, const Tensorcd& Acoeffs) const {
-	uA = MatrixTensor(trafo_, Acoeffs, 0);
+	uA = Acoeffs;
+	Forward(uA);
 }
 
 void FFTGrid::applyKin(Tensorcd& pA, const Tensorcd& Acoeffs) const {
@@ -75,8 +99,7 @@ void FFTGrid::applyKin(Tensorcd& pA, const Tensorcd& Acoeffs) const {
 	for (int n = 0; n < Acoeffs.shape().lastDimension(); n++)
 		for (int i = 0; i < dim_; i++)
 			pA(i, n) *= 0.5 * p_(i) * p_(i);
-	Tensorcd tmp(pA);
-	ToGrid(pA, tmp);
+	Backward(pA);
 }
 
 void FFTGrid::InitSPF(Tensorcd& phi) const {
@@ -0,0 +1,270 @@
+#include "Util/Compression.h"
+#include <cstring>
+#ifdef QUTREE_USE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef QUTREE_USE_LZ4
+#include <lz4.h>
+#endif
+
+namespace Compression {
+
+	void Fail(const string& msg) {
+		cerr << "Compression: " << msg << endl;
+		exit(2);
+	}
+
+	bool Available(Codec codec) {
+		switch (codec) {
+			case Codec::none:
+			case Codec::builtin:
+				return true;
+			case Codec::zstd:
+#ifdef QUTREE_USE_ZSTD
+				return true;
+#else
+				return false;
+#endif
+			case Codec::lz4:
+#ifdef QUTREE_USE_LZ4
+				return true;
+#else
+				return false;
+#endif
+		}
+		return false;
+	}
+
+	Codec Default() {
+		if (Available(Codec::zstd)) { return Codec::zstd; }
+		if (Available(Codec::lz4)) { return Codec::lz4; }
+		return Codec::builtin;
+	}
+
+	string Name(Codec codec) {
+		switch (codec) {
+			case Codec::none: return "none";
+			case Codec::builtin: return "builtin";
+			case Codec::zstd: return "zstd";
+			case Codec::lz4: return "lz4";
+		}
+		return "unknown";
+	}
+
+	//////////////////////////////////////////////////////////////////////
+	// Byte shuffle
+	//////////////////////////////////////////////////////////////////////
+
+	void Shuffle(char *out, const char *in, size_t size, size_t e) {
+		size_t n = size / e;
+		for (size_t b = 0; b < e; ++b) {
+			for (size_t i = 0; i < n; ++i) {
+				out[b * n + i] = in[i * e + b];
+			}
+		}
+		memcpy(out + n * e, in + n * e, size - n * e);
+	}
+
+	void Unshuffle(char *out, const char *in, size_t size, size_t e) {
+		size_t n = size / e;
+		for (size_t b = 0; b < e; ++b) {
+			for (size_t i = 0; i < n; ++i) {
+				out[i * e + b] = in[b * n + i];
+			}
+		}
+		memcpy(out + n * e, in + n * e, size - n * e);
+	}
+
+	//////////////////////////////////////////////////////////////////////
+	// Built-in LZ77 codec. A block is a list of sequences:
+	//   token (literal length : 4 | match length - 4 : 4),
+	//   [extra literal length bytes], literals,
+	//   offset (2 bytes, little-endian), [extra match length bytes].
+	// Lengths of 15 continue with bytes of 255 up to the first smaller byte.
+	// The last sequence only has literals.
+	//////////////////////////////////////////////////////////////////////
+
+	constexpr size_t minMatch = 4;
+	constexpr size_t hashLog = 16;
+	constexpr size_t maxOffset = 65535;
+	/// Matches end this far from the end of the input, the rest are literals
+	constexpr size_t lastLiterals = 8;
+
+	inline uint32_t Read32(const unsigned char *p) {
+		uint32_t x;
+		memcpy(&x, p, 4);
+		return x;
+	}
+
+	inline uint32_t Hash(uint32_t x) {
+		return (x * 2654435761u) >> (32 - hashLog);
+	}
+
+	void PutLength(vector<char>& out, size_t len) {
+		while (len >= 255) {
+			out.push_back((char) 255);
+			len -= 255;
+		}
+		out.push_back((char) len);
+	}
+
+	void PutSequence(vector<char>& out, const unsigned char *lit, size_t nLit,
+		size_t offset, size_t matchLen) {
+		size_t m = (matchLen >= minMatch) ? matchLen - minMatch : 0;
+		unsigned char token = (unsigned char) ((min(nLit, (size_t) 15) << 4) | min(m, (size_t) 15));
+		out.push_back((char) token);
+		if (nLit >= 15) { PutLength(out, nLit - 15); }
+		out.insert(out.end(), lit, lit + nLit);
+		if (matchLen == 0) { return; }
+		out.push_back((char) (offset & 0xFF));
+		out.push_back((char) (offset >> 8));
+		if (m >= 15) { PutLength(out, m - 15); }
+	}
+
+	vector<char> LZCompress(const unsigned char *src, size_t n) {
+		vector<char> out;
+		out.reserve(n + n / 255 + 16);
+		vector<uint32_t> table(1 << hashLog, 0); ///< Position + 1 of the last occurrence
+		size_t ip = 0;
+		size_t anchor = 0;
+		size_t limit = (n > lastLiterals + minMatch) ? n - lastLiterals - minMatch : 0;
+		while (ip < limit) {
+			uint32_t seq = Read32(src + ip);
+			uint32_t h = Hash(seq);
+			size_t ref = table[h];
+			table[h] = (uint32_t) (ip + 1);
+			if (ref > 0 && ip + 1 - ref <= maxOffset && Read32(src + ref - 1) == seq) {
+				ref--;
+				size_t len = minMatch;
+				size_t end = n - lastLiterals;
+				while (ip + len < end && src[ref + len] == src[ip + len]) { len++; }
+				PutSequence(out, src + anchor, ip - anchor, ip - ref, len);
+				ip += len;
+				anchor = ip;
+			} else {
+				/// Skip faster through incompressible data
+				ip += 1 + ((ip - anchor) >> 6);
+			}
+		}
+		PutSequence(out, src + anchor, n - anchor, 0, 0);
+		return out;
+	}
+
+	size_t GetLength(const unsigned char *& p, const unsigned char *end) {
+		size_t len = 0;
+		unsigned char b;
+		do {
+			if (p >= end) { Fail("corrupt block."); }
+			b = *p++;
+			len += b;
+		} while (b == 255);
+		return len;
+	}
+
+	void LZDecompress(const unsigned char *in, size_t inSize, unsigned char *out, size_t outSize) {
+		const unsigned char *p = in;
+		const unsigned char *end = in + inSize;
+		size_t op = 0;
+		while (p < end) {
+			unsigned char token = *p++;
+			size_t nLit = token >> 4;
+			if (nLit == 15) { nLit += GetLength(p, end); }
+			if (nLit > (size_t) (end - p) || op + nLit > outSize) { Fail("corrupt block."); }
+			memcpy(out + op, p, nLit);
+			p += nLit;
+			op += nLit;
+			if (p == end) { break; }
+
+			if (end - p < 2) { Fail("corrupt block."); }
+			size_t offset = p[0] | (p[1] << 8);
+			p += 2;
+			size_t len = token & 15;
+			if (len == 15) { len += GetLength(p, end); }
+			len += minMatch;
+			if (offset == 0 || offset > op || op + len > outSize) { Fail("corrupt block."); }
+			/// Byte by byte: source and destination may overlap
+			for (size_t i = 0; i < len; ++i, ++op) {
+				out[op] = out[op - offset];
+			}
+		}
+		if (op != outSize) { Fail("corrupt block."); }
+	}
+
+	//////////////////////////////////////////////////////////////////////
+	// Interface
+	//////////////////////////////////////////////////////////////////////
+
+	vector<char> Compress(const void *data, size_t size, Codec codec, size_t elementSize) {
+		if (!Available(codec)) { Fail("codec " + Name(codec) + " is not available."); }
+		if (codec == Codec::none) {
+			const char *p = (const char *) data;
+			return vector<char>(p, p + size);
+		}
+		vector<char> shuffled(size);
+		Shuffle(shuffled.data(), (const char *) data, size, max(elementSize, (size_t) 1));
+		const auto *src = (const unsigned char *) shuffled.data();
+
+		vector<char> out;
+		switch (codec) {
+			case Codec::builtin:
+				out = LZCompress(src, size);
+				break;
+			case Codec::zstd: {
+#ifdef QUTREE_USE_ZSTD
+				out.resize(ZSTD_compressBound(size));
+				size_t n = ZSTD_compress(out.data(), out.size(), src, size, 1);
+				if (ZSTD_isError(n)) { Fail(ZSTD_getErrorName(n)); }
+				out.resize(n);
+#endif
+				break;
+			}
+			case Codec::lz4: {
+#ifdef QUTREE_USE_LZ4
+				if (size > (size_t) LZ4_MAX_INPUT_SIZE) { Fail("block too large for lz4."); }
+				out.resize(LZ4_compressBound((int) size));
+				int n = LZ4_compress_default((const char *) src, out.data(), (int) size, (int) out.size());
+				if (n <= 0) { Fail("lz4 compression failed."); }
+				out.resize(n);
+#endif
+				break;
+			}
+			default:
+				break;
+		}
+		return out;
+	}
+
+	void Decompress(const char *in, size_t inSize, void *out, size_t outSize,
+		Codec codec, size_t elementSize) {
+		if (!Available(codec)) { Fail("codec " + Name(codec) + " is not available."); }
+		if (codec == Codec::none) {
+			if (inSize != outSize) { Fail("corrupt block."); }
+			memcpy(out, in, outSize);
+			return;
+		}
+		vector<char> shuffled(outSize);
+		auto *dst = (unsigned char *) shuffled.data();
+		switch (codec) {
+			case Codec::builtin:
+				LZDecompress((const unsigned char *) in, inSize, dst, outSize);
+				break;
+			case Codec::zstd: {
+#ifdef QUTREE_USE_ZSTD
+				size_t n = ZSTD_decompress(dst, outSize, in, inSize);
+				if (ZSTD_isError(n) || n != outSize) { Fail("corrupt zstd block."); }
+#endif
+				break;
+			}
+			case Codec::lz4: {
+#ifdef QUTREE_USE_LZ4
+				int n = LZ4_decompress_safe(in, (char *) dst, (int) inSize, (int) outSize);
+				if (n < 0 || (size_t) n != outSize) { Fail("corrupt lz4 block."); }
+#endif
+				break;
+			}
+			default:
+				break;
+		}
+		Unshuffle((char *) out, shuffled.data(), outSize, max(elementSize, (size_t) 1));
+	}
+}
@@ -1,197 +1,327 @@
 #include "Util/FFT.h"
+#include <map>
+#include <mutex>
 
-size_t FFT::getGoodSize(size_t size)
-{
-	//check if size is a power of 2
-	size_t mod = size % 2;
-	if(mod == 0) return size;
-	
-	//get the next bigger power of 2
-	size_t potens = 0;
-	while(size > 0)
-	{
-		size = size/2;
-		potens++;
-	}
-	return pow(2,potens);
-}
+typedef complex<double> cd;
 
-Tensorcd FFT::reverseOrder(const Tensorcd& in)
-{
-	//get the next best size for fft
-	const TensorShape& dim = in.shape();
-	size_t size = dim.lastBefore();
-	size_t states = dim.lastDimension();
-	size_t N = getGoodSize(size);
-
-	//build the output tensor withe the new sizes
-	vector<size_t> d;
-	d.push_back(N);
-	d.push_back(dim.lastDimension());
-	TensorShape newdim(d);
-	Tensorcd out(newdim);
-	
-	for(size_t n = 0; n < states; n++)
-		for(size_t i = 0; i < size; i++)
-			out[n*size + i] = in[n*size + i];
-
-	complex<double> tmp;
-
-	//reverse the order
-	for(size_t n = 0; n < states; n++)
-	{
-		size_t j = 1;
-		for(size_t i = 1; i <= size; i++)
-		{
-			if(j > i)
-			{
-				tmp = out[n*size + j-1];
-				out[n*size + j-1] = out[n*size + i-1];
-				out[n*size + i-1] = tmp;
-			}
+struct FFTPlan::Kernel {
+	explicit Kernel(size_t n);
 
-			size_t m = size/2;
-			while((m >= 2) && (j > m))
-			{
-				j -= m;
-				m /= 2;
-			}
-			j += m;
-		} 
-	}
+	/// Transform s0 interleaved vectors, element j of vector q at x[q + s0 j]
+	void Stockham(cd *x, cd *work, size_t s0, int sign) const;
 
-	return out;
-}
+	/// Transform a single vector with elements x[j * stride]
+	void Bluestein(cd *x, size_t stride, cd *buf, cd *work, int sign) const;
 
-Tensorcd FFT::generalFFT(const Tensorcd& in, const int sign)
-{
-	//get sizes for fft
-	const TensorShape& dim = in.shape();
-	size_t size = dim.lastBefore();
-	size_t states = dim.lastDimension();
+	size_t n;
+	vector<size_t> factors;
+	vector<cd> twiddle; ///< exp(-2 pi i k / n)
 
-	//get primefactors
-	vector<size_t> primefactors = primeFactorization(size);
-	size_t numberOfFactors = primefactors.size();
+	bool bluestein{false};
+	size_t m{0}; ///< Length of the convolution
+	shared_ptr<const Kernel> inner;
+	vector<cd> chirp; ///< exp(-i pi k^2 / n)
+	vector<cd> filter[2]; ///< Transformed conjugate chirp for sign -1 and +1, divided by m
+};
 
-	//make a factor 2 fft if possible
-	if(primefactors[numberOfFactors-1] == 2)
-		return factor2FFT(in, sign);
+namespace {
+	/// Prime factors above this use Bluestein's algorithm
+	constexpr size_t maxRadix = 13;
 
-	//otherwise perform dft
-	return dft(in, sign);
-}
+	/// Complex multiplication without the inf/nan handling of std::complex (vectorizes)
+	inline cd mul(cd a, cd b) {
+		return cd(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+	}
 
-Tensorcd FFT::dft(const Tensorcd& in, const int sign)
-{
-	//get sizes for dft
-	const TensorShape& dim = in.shape();
-	size_t size = dim.lastBefore();
-	size_t states = dim.lastDimension();
-
-	//otherwise perform dft
-	vector<size_t> d;
-	d.push_back(size);
-	d.push_back(states);
-	TensorShape newdim(d);
-	Tensorcd out(newdim);
-	for(size_t k = 0; k < states; k++)
-	{
-		for(size_t i = 0; i < size; i++)
+	/// i * a
+	inline cd rot(cd a) {
+		return cd(-a.imag(), a.real());
+	}
+
+	/// Kernels are shared by all plans of the same size
+	shared_ptr<const FFTPlan::Kernel> GetKernel(size_t n) {
+		static mutex m;
+		static map<size_t, shared_ptr<const FFTPlan::Kernel>> kernels;
 		{
-			double angle = (2.*M_PI*i*sign)/(1.*size);
-			complex<double> factor(cos(angle),sin(angle));
-			complex<double> w(1/sqrt(1.*size),0.);
-			for(size_t j = 0; j < size; j++)
-			{
-				out[k*size + i] += w*in[k*size + j];
-				w *= factor;
+			lock_guard<mutex> lock(m);
+			auto it = kernels.find(n);
+			if (it != kernels.end()) { return it->second; }
+		}
+		/// Construct without the lock: Bluestein kernels request their inner kernel
+		auto kernel = make_shared<const FFTPlan::Kernel>(n);
+		lock_guard<mutex> lock(m);
+		return kernels.emplace(n, kernel).first->second;
+	}
+
+	/// Twiddle factors exp(sign 2 pi i j t step / n) of column j
+	inline void Twiddles(cd *tw, const FFTPlan::Kernel& K, size_t p, size_t j, size_t step, int sign) {
+		for (size_t t = 0; t < p; ++t) {
+			cd w = K.twiddle[j * t * step];
+			tw[t] = (sign < 0) ? w : conj(w);
+		}
+	}
+
+	/**
+	 * Radix-p passes of the Stockham algorithm: s interleaved transforms of
+	 * length p * m. Input a_k = x[q + s (j + k m)], output y[q + s (p j + t)],
+	 * q < s is the contiguous inner loop. step = s / s0 is the twiddle stride.
+	 */
+	void Pass2(const FFTPlan::Kernel& K, const cd *x, cd *y, size_t m, size_t s, size_t step, int sign) {
+		cd tw[2];
+		for (size_t j = 0; j < m; ++j) {
+			Twiddles(tw, K, 2, j, step, sign);
+			const cd *in = x + s * j;
+			cd *out = y + 2 * s * j;
+			for (size_t q = 0; q < s; ++q) {
+				cd a0 = in[q];
+				cd a1 = in[q + s * m];
+				out[q] = a0 + a1;
+				out[q + s] = mul(a0 - a1, tw[1]);
+			}
+		}
+	}
+
+	void Pass4(const FFTPlan::Kernel& K, const cd *x, cd *y, size_t m, size_t s, size_t step, int sign) {
+		cd tw[4];
+		const double sg = sign;
+		for (size_t j = 0; j < m; ++j) {
+			Twiddles(tw, K, 4, j, step, sign);
+			const cd *in = x + s * j;
+			cd *out = y + 4 * s * j;
+			for (size_t q = 0; q < s; ++q) {
+				cd a0 = in[q];
+				cd a1 = in[q + s * m];
+				cd a2 = in[q + 2 * s * m];
+				cd a3 = in[q + 3 * s * m];
+				cd t0 = a0 + a2;
+				cd t1 = a0 - a2;
+				cd t2 = a1 + a3;
+				cd t3 = sg * rot(a1 - a3);
+				out[q] = t0 + t2;
+				out[q + s] = mul(t1 + t3, tw[1]);
+				out[q + 2 * s] = mul(t0 - t2, tw[2]);
+				out[q + 3 * s] = mul(t1 - t3, tw[3]);
+			}
+		}
+	}
+
+	/// Odd prime radix; y_t and y_{P-t} share the sums over a_k +- a_{P-k}
+	template<size_t P>
+	void OddPass(const FFTPlan::Kernel& K, const cd *x, cd *y, size_t m, size_t s, size_t step, int sign) {
+		constexpr size_t h = (P - 1) / 2;
+		double c[P], sn[P];
+		for (size_t u = 0; u < P; ++u) {
+			c[u] = cos(2. * M_PI * u / P);
+			sn[u] = sign * sin(2. * M_PI * u / P);
+		}
+		cd tw[P];
+		for (size_t j = 0; j < m; ++j) {
+			Twiddles(tw, K, P, j, step, sign);
+			const cd *in = x + s * j;
+			cd *out = y + P * s * j;
+			for (size_t q = 0; q < s; ++q) {
+				cd a0 = in[q];
+				cd b[h + 1], d[h + 1];
+				cd y0 = a0;
+				for (size_t k = 1; k <= h; ++k) {
+					cd ak = in[q + k * s * m];
+					cd apk = in[q + (P - k) * s * m];
+					b[k] = ak + apk;
+					d[k] = ak - apk;
+					y0 += b[k];
+				}
+				out[q] = y0;
+				for (size_t t = 1; t <= h; ++t) {
+					cd re = a0;
+					cd im = 0.;
+					for (size_t k = 1; k <= h; ++k) {
+						size_t u = (t * k) % P;
+						re += c[u] * b[k];
+						im += sn[u] * d[k];
+					}
+					out[q + t * s] = mul(re + rot(im), tw[t]);
+					out[q + (P - t) * s] = mul(re - rot(im), tw[P - t]);
+				}
 			}
 		}
 	}
-	return out;
 }
 
-Tensorcd FFT::factor2FFT(const Tensorcd& in, const int sign)
-{
-	Tensorcd out = reverseOrder(in);
-	
-	danielsonLanczosAlgorithm(out, sign);
+FFTPlan::Kernel::Kernel(size_t n)
+	: n(n), twiddle(n) {
+	assert(n > 0);
+	for (size_t k = 0; k < n; ++k) {
+		double angle = -2. * M_PI * k / (1. * n);
+		twiddle[k] = cd(cos(angle), sin(angle));
+	}
 
-	return out;
+	size_t rest = n;
+	while (rest % 4 == 0) {
+		factors.push_back(4);
+		rest /= 4;
+	}
+	for (size_t p = 2; p <= rest; ++p) {
+		while (rest % p == 0) {
+			factors.push_back(p);
+			rest /= p;
+		}
+	}
+	bluestein = !factors.empty() && factors.back() > maxRadix;
+	if (!bluestein) { return; }
+
+	/// Bluestein: jk = (j^2 + k^2 - (k - j)^2) / 2 turns the DFT into a convolution
+	m = 1;
+	while (m < 2 * n - 1) { m *= 2; }
+	inner = GetKernel(m);
+	chirp.resize(n);
+	for (size_t k = 0; k < n; ++k) {
+		double angle = -M_PI * ((k * k) % (2 * n)) / (1. * n);
+		chirp[k] = cd(cos(angle), sin(angle));
+	}
+	vector<cd> work(m);
+	for (size_t i = 0; i < 2; ++i) {
+		vector<cd>& b = filter[i];
+		b.assign(m, 0.);
+		for (size_t k = 0; k < n; ++k) {
+			/// conj(w_k), w_k = exp(sign i pi k^2 / n)
+			cd w = (i == 0) ? conj(chirp[k]) : chirp[k];
+			b[k] = w;
+			if (k > 0) { b[m - k] = w; }
+		}
+		inner->Stockham(b.data(), work.data(), 1, -1);
+		for (cd& x : b) { x /= (double) m; }
+	}
 }
 
-void FFT::danielsonLanczosAlgorithm(Tensorcd& in, const int sign)
-{
-	//get sizes for fft
-	const TensorShape& dim = in.shape();
-	size_t size = dim.lastBefore();
-	size_t states = dim.lastDimension();
+void FFTPlan::Kernel::Stockham(cd *x, cd *work, size_t s0, int sign) const {
+	cd *in = x;
+	cd *out = work;
+	size_t len = n;
+	size_t s = s0;
+	for (size_t p : factors) {
+		len /= p;
+		size_t step = s / s0;
+		switch (p) {
+			case 2: Pass2(*this, in, out, len, s, step, sign);
+				break;
+			case 3: OddPass<3>(*this, in, out, len, s, step, sign);
+				break;
+			case 4: Pass4(*this, in, out, len, s, step, sign);
+				break;
+			case 5: OddPass<5>(*this, in, out, len, s, step, sign);
+				break;
+			case 7: OddPass<7>(*this, in, out, len, s, step, sign);
+				break;
+			case 11: OddPass<11>(*this, in, out, len, s, step, sign);
+				break;
+			case 13: OddPass<13>(*this, in, out, len, s, step, sign);
+				break;
+			default:
+				cerr << "FFTPlan: no pass for radix " << p << endl;
+				exit(1);
+		}
+		swap(in, out);
+		s *= p;
+	}
+	if (in != x) {
+		copy(in, in + n * s0, x);
+	}
+}
 
-	//save some intermediat results
-	complex<double> tmp(0., 0.);
+void FFTPlan::Kernel::Bluestein(cd *x, size_t stride, cd *buf, cd *work, int sign) const {
+	const vector<cd>& f = filter[(sign < 0) ? 0 : 1];
+	for (size_t k = 0; k < n; ++k) {
+		cd w = (sign < 0) ? chirp[k] : conj(chirp[k]);
+		buf[k] = mul(x[k * stride], w);
+	}
+	fill(buf + n, buf + m, cd(0.));
+	inner->Stockham(buf, work, 1, -1);
+	for (size_t k = 0; k < m; ++k) {
+		buf[k] = mul(buf[k], f[k]);
+	}
+	inner->Stockham(buf, work, 1, 1);
+	for (size_t k = 0; k < n; ++k) {
+		cd w = (sign < 0) ? chirp[k] : conj(chirp[k]);
+		x[k * stride] = mul(buf[k], w);
+	}
+}
 
-	//Transform each vector seperadly
-	for(size_t n = 0; n < states; n++)
-	{
-		//Recursion
-		size_t mmax = 1;
+FFTPlan::FFTPlan(size_t n, size_t howmany, size_t stride, size_t dist)
+	: kernel_(GetKernel(n)), n_(n), howmany_(howmany), stride_(stride),
+	dist_(dist ? dist : n * stride) {}
 
+FFTPlan::FFTPlan(const TensorShape& shape, size_t mode)
+	: kernel_(GetKernel(shape[mode])), n_(shape[mode]), howmany_(shape.before(mode)),
+	stride_(shape.before(mode)), dist_(1), nBlocks_(shape.after(mode)),
+	blockDist_(shape[mode] * shape.before(mode)) {}
 
-		while(mmax < size)
-		{
-			size_t j = 0;
-			size_t step = 2*mmax;
-			
-			//prefector for exponent
-			double angle = M_PI/(1.*sign*mmax);
-			complex<double> factor(-2.*pow(sin(0.5*angle),2), sin(angle));
-
-			//transformation factor
-			complex<double> w(1., 0.);
-			
-			//go throug all partitions of the vector
-			for(size_t m = 0; m < mmax; m++)
-			{
-				for(size_t i = m; i < size; i += step)
-				{
-					//Davidson-Lanczos-Formula
-					j = i + mmax;
-
-					tmp = w*in[n*size + j];
-				  
-					in[n*size + j] = in[n*size + i] - tmp;
-					in[n*size + i] = in[n*size + i] + tmp;
+const vector<size_t>& FFTPlan::factors() const {
+	return kernel_->factors;
+}
 
-				}
-				w = w*factor + w;
-			}
+bool FFTPlan::Bluestein() const {
+	return kernel_->bluestein;
+}
 
-			mmax = step;
-		}
+void FFTPlan::Execute(cd *data, int sign) const {
+	assert(kernel_);
+	for (size_t b = 0; b < nBlocks_; ++b) {
+		Transform(data + b * blockDist_, sign);
 	}
+}
 
-	in *= 1./sqrt(size);
+void FFTPlan::Execute(Tensorcd& A, int sign) const {
+	assert(howmany_ == 0 || nBlocks_ == 0 || (nBlocks_ - 1) * blockDist_ + (howmany_ - 1) * dist_
+		+ (n_ - 1) * stride_ < A.shape().totalDimension());
+	Execute(&A[0], sign);
 }
 
-vector<size_t> FFT::primeFactorization(size_t number) const
-{
-	vector<size_t> primefactors;
+void FFTPlan::Transform(cd *data, int sign) const {
+	/// Work space is per thread, so concurrent calls do not interfere
+	thread_local vector<cd> work;
+	thread_local vector<cd> buf;
+	const Kernel& K = *kernel_;
 
-	if(number == 1)
-		primefactors.push_back(1);
+	/// Interleaved vectors are transformed together
+	if (!K.bluestein && dist_ == 1 && stride_ == howmany_) {
+		work.resize(n_ * howmany_);
+		K.Stockham(data, work.data(), howmany_, sign);
+		return;
+	}
 
-	size_t inter = number;
-	for(size_t i = 2; i <= number; i++)
-	{
-		while(inter % i == 0)
-		{
-			inter /= i;
-			primefactors.push_back(i);
+	size_t len = K.bluestein ? K.m : n_;
+	work.resize(len);
+	buf.resize(len);
+	for (size_t v = 0; v < howmany_; ++v) {
+		cd *x = data + v * dist_;
+		if (K.bluestein) {
+			K.Bluestein(x, stride_, buf.data(), work.data(), sign);
+		} else if (stride_ == 1) {
+			K.Stockham(x, work.data(), 1, sign);
+		} else {
+			for (size_t j = 0; j < n_; ++j) {
+				buf[j] = x[j * stride_];
+			}
+			K.Stockham(buf.data(), work.data(), 1, sign);
+			for (size_t j = 0; j < n_; ++j) {
+				x[j * stride_] = buf[j];
+			}
 		}
-
-		if(inter == 1) break;
 	}
+}
 
-	return primefactors;
+Tensorcd FFT::generalFFT(const Tensorcd& in, const int sign)
+{
+	Tensorcd out(in);
+	transform(out, sign);
+	return out;
+}
+
+void FFT::transform(Tensorcd& A, const int sign)
+{
+	const TensorShape& dim = A.shape();
+	size_t size = dim.lastBefore();
+	FFTPlan plan(size, dim.lastDimension());
+	plan.Execute(A, sign);
+	A *= 1. / sqrt(1. * size);
 }
@@ -5,8 +5,29 @@
 #include "benchmark_tensor.h"
 #include "benchmark_helper.h"
 #include "benchmark_tree.h"
+#include "Core/LAKernels.h"
+
+#ifdef QUTREE_FORTRAN_LA_LIB
+extern "C" {
+/// The hole-matrix routine that TensorContraction called before the native kernels
+void rhomat_(double *bra, double *ket, double *matrix, int *a, int *b, int *c);
+}
+#endif
 
 namespace benchmark {
+	/// The routine TensorContraction is compared to: LA_lib.f if it is built in, else its native port
+	void baseline_contraction(Matrixcd& S, const Tensorcd& A, const Tensorcd& B,
+		size_t bef, size_t act, size_t aft) {
+#ifdef QUTREE_FORTRAN_LA_LIB
+		int a = act;
+		int b = bef;
+		int c = aft;
+		rhomat_((double *) &A[0], (double *) &B[0], (double *) &S[0], &a, &b, &c);
+#else
+		LAKernels::rhomat(&S[0], &A[0], &B[0], act, act, bef, aft, false);
+#endif
+	}
+
 	TensorShape make_TensorDim(size_t order, size_t dim) {
 		assert(order > 1);
 		assert(dim > 0);
@@ -100,6 +121,60 @@ namespace benchmark {
 		return hole_product_sample(S, A, B, nsample, bef, act, aft);
 	}
 
+	auto contraction_sample(Matrixcd& S, const Tensorcd& A, const Tensorcd& B, size_t nsample,
+		size_t bef, size_t act, size_t aft, size_t nrep, bool gemm) {
+		vector<chrono::microseconds> duration_vec;
+		for (size_t n = 0; n < nsample; ++n) {
+			std::chrono::time_point<std::chrono::system_clock> start, end;
+			start = std::chrono::system_clock::now();
+			for (size_t k = 0; k < nrep; ++k) {
+				if (gemm) {
+					TensorContraction(S, A, B, bef, act, act, aft);
+				} else {
+					baseline_contraction(S, A, B, bef, act, aft);
+				}
+			}
+			end = std::chrono::system_clock::now();
+			duration_vec.emplace_back(chrono::duration_cast<chrono::microseconds>(end - start).count());
+		}
+
+		return statistic_helper(duration_vec);
+	}
+
+	void screen_contraction(mt19937& gen, ostream& os, size_t nsample) {
+		/// Compare the original hole-matrix routine to TensorContraction, which
+		/// switches to GEMM for larger active dimensions
+#ifdef QUTREE_FORTRAN_LA_LIB
+		os << "# contraction baseline: LA_lib.f rhomat\n";
+#else
+		os << "# contraction baseline: LAKernels::rhomat (configure with USE_FORTRAN_LA_LIB to compare to LA_lib.f)\n";
+#endif
+		os << "# contraction: dim\torder\tmode\tbaseline [ms]\tTensorContraction [ms]\tspeedup\n";
+		vector<size_t> dims = {2, 4, 8, 16, 32, 64, 128};
+		size_t order = 3;
+		for (size_t dim : dims) {
+			for (size_t mode = 0; mode < order; ++mode) {
+				auto tdim = make_TensorDim(order, dim);
+				Tensorcd A(tdim, false);
+				Tensorcd B(tdim, false);
+				Tensor_Extension::Generate(A, gen);
+				Tensor_Extension::Generate(B, gen);
+				Matrixcd S(dim, dim);
+				size_t aft = tdim.after(mode);
+				size_t act = tdim[mode];
+				size_t bef = tdim.before(mode);
+				size_t nrep = max((size_t) 1, (size_t) pow(2, 22) / (tdim.totalDimension() * dim));
+
+				auto base = contraction_sample(S, A, B, nsample, bef, act, aft, nrep, false);
+				auto gemm = contraction_sample(S, A, B, nsample, bef, act, aft, nrep, true);
+				os << std::setprecision(6);
+				os << dim << "\t" << order << "\t" << mode;
+				os << "\t" << base.first / 1000. << "\t" << gemm.first / 1000.;
+				os << "\t" << base.first / gemm.first << endl;
+			}
+		}
+	}
+
 	auto matrix_tensor_sample(Tensorcd& B, const Matrixcd& S, const Tensorcd& A,
 		size_t nsample, size_t bef, size_t act, size_t aft) {
 		vector<chrono::microseconds> duration_vec;
@@ -237,6 +312,7 @@ namespace benchmark {
 		size_t nsample = 20;
 		ostream& os = cout;
 
+		screen_contraction(gen, os, nsample);
 //		screen_order(gen, os, nsample);
 //		screen_dim(gen, os, nsample);
 		screen_nleaves(gen, os, nsample);
@@ -0,0 +1,141 @@
+#include "UnitTest++/UnitTest++.h"
+#include "Util/FFT.h"
+#include "Util/QMConstants.h"
+#include "Core/Tensor_Extension.h"
+#include "TreeShape/LeafTypes/FFTGrid.h"
+
+SUITE (FFT) {
+	typedef complex<double> cd;
+
+	/// Reference: O(n^2) discrete Fourier transform of every column
+	Tensorcd DFT(const Tensorcd& A, int sign) {
+		size_t n = A.shape().lastBefore();
+		Tensorcd B(A.shape());
+		for (size_t b = 0; b < A.shape().lastDimension(); ++b) {
+			for (size_t k = 0; k < n; ++k) {
+				for (size_t j = 0; j < n; ++j) {
+					double angle = sign * QM::two_pi * ((j * k) % n) / (1. * n);
+					B(k, b) += cd(cos(angle), sin(angle)) * A(j, b);
+				}
+			}
+		}
+		return B;
+	}
+
+	TEST (FFTPlan) {
+		mt19937 gen(2468);
+		/// Mixed radix, radix 11 and 13, and Bluestein sizes
+		for (size_t n : {1, 2, 3, 4, 7, 8, 12, 30, 49, 64, 100, 121, 143, 256, 1000, 17, 97, 106, 257}) {
+			Tensorcd A(TensorShape({n, 3}));
+			Tensor_Extension::Generate(A, gen);
+			FFTPlan plan(n, 3);
+				CHECK_EQUAL(n == 17 || n == 97 || n == 106 || n == 257, plan.Bluestein());
+			for (int sign : {-1, 1}) {
+				Tensorcd B(A);
+				plan.Execute(B, sign);
+					CHECK_CLOSE(0., Residual(B, DFT(A, sign)), 1e-10 * n);
+			}
+		}
+	}
+
+	TEST (FFTPlan_Mode) {
+		mt19937 gen(1234);
+		for (size_t n : {12, 19}) {
+			TensorShape shape({5, n, 3});
+			Tensorcd A(shape);
+			Tensor_Extension::Generate(A, gen);
+			Tensorcd B(A);
+			FFTPlan plan(shape, 1);
+				CHECK_EQUAL(15, plan.nVectors());
+			plan.Execute(B, -1);
+
+			/// Strided batch: the same vectors, planned one by one
+			Tensorcd C(A);
+			for (size_t a = 0; a < 3; ++a) {
+				FFTPlan strided(n, 5, 5, 1);
+				strided.Execute(&C[a * 5 * n], -1);
+			}
+			for (size_t a = 0; a < 3; ++a) {
+				for (size_t b = 0; b < 5; ++b) {
+					for (size_t k = 0; k < n; ++k) {
+						cd x = 0.;
+						for (size_t j = 0; j < n; ++j) {
+							double angle = -QM::two_pi * ((j * k) % n) / (1. * n);
+							x += cd(cos(angle), sin(angle)) * A[b + 5 * (j + n * a)];
+						}
+							CHECK_CLOSE(0., abs(x - B[b + 5 * (k + n * a)]), 1e-10);
+							CHECK_CLOSE(0., abs(x - C[b + 5 * (k + n * a)]), 1e-10);
+					}
+				}
+			}
+		}
+	}
+
+	TEST (FFTPlan_Concurrent) {
+		mt19937 gen(9753);
+		size_t n = 360;
+		size_t nTensors = 16;
+		vector<Tensorcd> As;
+		for (size_t i = 0; i < nTensors; ++i) {
+			As.emplace_back(TensorShape({n, 2}));
+			Tensor_Extension::Generate(As.back(), gen);
+		}
+		vector<Tensorcd> Bs(As);
+		FFTPlan plan(n, 2);
+#pragma omp parallel for
+		for (size_t i = 0; i < nTensors; ++i) {
+			plan.Execute(Bs[i], -1);
+		}
+		for (size_t i = 0; i < nTensors; ++i) {
+				CHECK_CLOSE(0., Residual(Bs[i], DFT(As[i], -1)), 1e-9);
+		}
+
+		/// Normalized transforms are unitary
+		FFT fft;
+		Tensorcd C = fft.forwardFFT(As[0]);
+			CHECK_CLOSE(0., Residual(As[0], fft.backwardFFT(C)), 1e-12);
+		fft.backward(C);
+			CHECK_CLOSE(0., Residual(As[0], C), 1e-12);
+	}
+
+	TEST (FFTGrid) {
+		/// Mixed-radix grid size
+		size_t dim = 60;
+		double x0 = -8., x1 = 8.;
+		FFTGrid grid(dim);
+		grid.Initialize(x0, x1, 0., 1.);
+
+		/// Dense transformation that the grid used to apply
+		double dx = (x1 - x0) / (dim - 1.);
+		double dp = QM::two_pi / (dx * dim);
+		double p0 = -(dim - 1.) * dp / 2.;
+		Matrixcd trafo(dim, dim);
+		for (size_t i = 0; i < dim; ++i) {
+			for (size_t j = 0; j < dim; ++j) {
+				double p = p0 + j * dp;
+				trafo(j, i) = exp(-QM::im * (1. * i * dx) * p) / sqrt(1. * dim);
+			}
+		}
+
+		mt19937 gen(1357);
+		Tensorcd A(TensorShape({dim, 4}));
+		Tensor_Extension::Generate(A, gen);
+		Tensorcd B(A.shape());
+		grid.FromGrid(B, A);
+			CHECK_CLOSE(0., Residual(B, MatrixTensor(trafo, A, 0)), 1e-10);
+		grid.ToGrid(B, A);
+			CHECK_CLOSE(0., Residual(B, multATB(trafo, A, 0)), 1e-10);
+
+		Tensorcd C(A.shape());
+		grid.FromGrid(B, A);
+		grid.ToGrid(C, B);
+			CHECK_CLOSE(0., Residual(A, C), 1e-10);
+
+		/// <T> = omega / 4 for the harmonic oscillator ground state
+		Tensorcd Phi(TensorShape({dim, 1}));
+		grid.InitSPF(Phi);
+		grid.applyKin(B, Phi);
+		Matrixcd T = Phi.DotProduct(B);
+			CHECK_CLOSE(0.25, real(T(0, 0)), 1e-8);
+	}
+}
@@ -5,6 +5,12 @@
 #include "Util/RungeKutta4.h"
 #include "Core/Vector.h"
 #include "Util/QMConstants.h"
+#include "Util/ShortIterativeLanczos.h"
+#include "Util/RandomMatrices.h"
+#include "Core/Tensor_Extension.h"
+#include "TreeShape/TreeFactory.h"
+#include "TreeClasses/CMFIntegrator.h"
+#include "TreeClasses/TensorTreeFunctions.h"
 
 SUITE(Integrators) {
 	class HOInterface {
@@ -41,4 +47,211 @@ SUITE(Integrators) {
 		CHECK_CLOSE(0., residual, 10. * h);
 	}
 
-}
\ No newline at end of file
+	TEST (SIL_Tensor) {
+		size_t dim = 60;
+		mt19937 gen(1990);
+		Matrixcd H = RandomMatrices::GUE(dim, gen);
+		Tensorcd Psi(TensorShape({dim, 1}));
+		Tensor_Extension::Generate(Psi, gen);
+		Psi *= 1. / sqrt(abs(KrylovTraits<Tensorcd>::Dot(Psi, Psi)));
+
+		/// Exact solution from the eigenbasis of H
+		double t_end = 2.;
+		auto x = Diagonalize(H);
+		Matrixcd expH(dim, dim);
+		for (size_t n = 0; n < dim; ++n) {
+			expH(n, n) = exp(complex<double>(0., -x.second(n) * t_end));
+		}
+		expH = x.first * expH * x.first.Adjoint();
+		Tensorcd Psi_ex = MatrixTensor(expH, Psi, 0);
+
+		ShortIterativeLanczos<Tensorcd>::Parameters par;
+		par.tolerance = 1e-10;
+		auto apply = [&H](Tensorcd& HPsi, const Tensorcd& Psi) {
+			MatrixTensor(HPsi, H, Psi, 0, true);
+		};
+		ShortIterativeLanczos<Tensorcd> sil(apply, par);
+		double t = 0.;
+		double dt = 0.01;
+		sil.Integrate(Psi, t, t_end, dt);
+
+			CHECK_CLOSE(t_end, t, 1e-12);
+		KrylovTraits<Tensorcd>::Axpy(Psi_ex, -1., Psi);
+			CHECK_CLOSE(0., sqrt(abs(KrylovTraits<Tensorcd>::Dot(Psi_ex, Psi_ex))), 1e-8);
+		/// The step size adapts to the order instead of staying at 0.01
+			CHECK(sil.nSteps() < 30);
+	}
+
+	TEST (SIL_TensorTree) {
+		/// Diagonal operator on all coefficients: every coefficient picks up a phase
+		Tree tree = TreeFactory::BalancedTree(6, 3, 2);
+		mt19937 gen(2020);
+		TensorTreecd Psi(gen, tree, false);
+		TensorTreecd Psi0(Psi);
+		auto energy = [](size_t I) { return 0.1 * (double) (I % 7); };
+		auto apply = [&energy](TensorTreecd& HPsi, const TensorTreecd& Psi) {
+			size_t I = 0;
+			for (size_t n = 0; n < Psi.size(); ++n) {
+				const Tensorcd& Phi = Psi.begin()[n];
+				Tensorcd& HPhi = HPsi.begin()[n];
+				for (size_t i = 0; i < Phi.shape().totalDimension(); ++i, ++I) {
+					HPhi(i) = energy(I) * Phi(i);
+				}
+			}
+		};
+
+		ShortIterativeLanczos<TensorTreecd>::Parameters par;
+		ShortIterativeLanczos<TensorTreecd> sil(apply, par);
+		double t = 0.;
+		double dt = 0.1;
+		double t_end = 5.;
+		sil.Integrate(Psi, t, t_end, dt);
+
+		size_t I = 0;
+		for (size_t n = 0; n < Psi.size(); ++n) {
+			const Tensorcd& Phi = Psi.begin()[n];
+			const Tensorcd& Phi0 = Psi0.begin()[n];
+			for (size_t i = 0; i < Phi.shape().totalDimension(); ++i, ++I) {
+				complex<double> ex = exp(complex<double>(0., -energy(I) * t_end)) * Phi0(i);
+					CHECK_CLOSE(0., abs(Phi(i) - ex), 1e-8);
+			}
+		}
+	}
+
+	/// Real symmetric leaf matrix
+	Matrixcd SymmetricMatrix(size_t dim, mt19937& gen) {
+		Matrixcd G = RandomMatrices::GUE(dim, gen);
+		Matrixcd h(dim, dim);
+		for (size_t i = 0; i < dim; ++i) {
+			for (size_t j = 0; j < dim; ++j) {
+				h(i, j) = real(G(i, j));
+			}
+		}
+		return h;
+	}
+
+	TEST (CMF_Exact) {
+		/// Two leaves with full-rank bottom nodes: MCTDH is exact
+		size_t dim = 3;
+		Tree tree = TreeFactory::BalancedTree(2, dim, dim);
+		mt19937 gen(1990);
+		TensorTreecd Psi(gen, tree, false);
+		const Node& top = tree.TopNode();
+		Tensor_Extension::Generate(Psi[top], gen);
+		Psi[top] *= 1. / sqrt(abs(KrylovTraits<Tensorcd>::Dot(Psi[top], Psi[top])));
+
+		vector<Matrixcd> h = {SymmetricMatrix(dim, gen), SymmetricMatrix(dim, gen)};
+		Matrixcd x = SymmetricMatrix(dim, gen);
+		SOPcd H;
+		H.push_back(MLOcd(h[0], 0), 1.);
+		H.push_back(MLOcd(h[1], 1), 1.);
+		MLOcd M(x, 0);
+		M.push_back(LeafMatrixcd(x), 1);
+		H.push_back(M, 0.5);
+
+		/// Full wavefunction, index k belongs to the k-th child of the top node
+		vector<size_t> idx(2);
+		auto full = [&](const TensorTreecd& Psi) {
+			Tensorcd Chi(Psi[top]);
+			for (size_t k = 0; k < top.nChildren(); ++k) {
+				const Node& child = top.child(k);
+				idx[child.getLeaf().Mode()] = k;
+				const Tensorcd& Phi = Psi[child];
+				Matrixcd U(dim, dim);
+				for (size_t i = 0; i < dim; ++i) {
+					for (size_t a = 0; a < dim; ++a) {
+						U(i, a) = Phi(a * dim + i);
+					}
+				}
+				Chi = MatrixTensor(U, Chi, k);
+			}
+			return Chi;
+		};
+		Tensorcd Chi = full(Psi);
+		auto apply = [&](Tensorcd& HChi, const Tensorcd& Chi) {
+			HChi = MatrixTensor(h[0], Chi, idx[0]);
+			HChi += MatrixTensor(h[1], Chi, idx[1]);
+			Tensorcd xxChi = MatrixTensor(x, MatrixTensor(x, Chi, idx[0]), idx[1]);
+			HChi += complex<double>(0.5) * xxChi;
+		};
+		ShortIterativeLanczos<Tensorcd>::Parameters silpar;
+		silpar.tolerance = 1e-12;
+		ShortIterativeLanczos<Tensorcd> sil(apply, silpar);
+		double t_end = 2.;
+		double t = 0.;
+		double dt = 0.01;
+		sil.Integrate(Chi, t, t_end, dt);
+
+		CMFIntegrator::Parameters par;
+		par.tolerance = 1e-7;
+		CMFIntegrator cmf(H, tree, par);
+		t = 0.;
+		dt = 0.01;
+		cmf.Integrate(Psi, t, t_end, dt);
+
+			CHECK_CLOSE(t_end, t, 1e-12);
+		Tensorcd Chi_cmf = full(Psi);
+		Chi_cmf -= Chi;
+			CHECK_CLOSE(0., sqrt(abs(KrylovTraits<Tensorcd>::Dot(Chi_cmf, Chi_cmf))), 1e-5);
+		/// The macro step adapts instead of staying at 0.01
+			CHECK(cmf.nSteps() < 100);
+	}
+
+	TEST (CMF_Conservation) {
+		/// Transverse-field Ising chain with low-rank nodes: norm and energy are conserved
+		Tree tree = TreeFactory::BalancedTree(8, 2, 2);
+		mt19937 gen(2020);
+		TensorTreecd Psi(gen, tree, false);
+
+		Matrixcd X(2, 2);
+		X(0, 1) = 1.;
+		X(1, 0) = 1.;
+		Matrixcd Z(2, 2);
+		Z(0, 0) = 1.;
+		Z(1, 1) = -1.;
+		SOPcd H;
+		for (size_t i = 0; i < tree.nLeaves(); ++i) {
+			H.push_back(MLOcd(X, i), 0.7);
+		}
+		for (size_t i = 0; i + 1 < tree.nLeaves(); ++i) {
+			MLOcd M(Z, i);
+			M.push_back(LeafMatrixcd(Z), i + 1);
+			H.push_back(M, 1.);
+		}
+
+		const Node& top = tree.TopNode();
+		auto energy = [&](const TensorTreecd& Psi) {
+			complex<double> E = 0.;
+			for (size_t l = 0; l < H.size(); ++l) {
+				auto HPsi = H[l].Apply(Psi, tree);
+				auto S = TreeFunctions::DotProduct(Psi, HPsi, tree);
+				E += H.Coeff(l) * S[top](0, 0);
+			}
+			return E;
+		};
+		auto norm = [&](const TensorTreecd& Psi) {
+			return sqrt(abs(KrylovTraits<Tensorcd>::Dot(Psi[top], Psi[top])));
+		};
+		complex<double> E0 = energy(Psi);
+		double n0 = norm(Psi);
+
+		CMFIntegrator::Parameters par;
+		par.tolerance = 1e-6;
+		CMFIntegrator cmf(H, tree, par);
+		double t = 0.;
+		double dt = 0.01;
+		cmf.Integrate(Psi, t, 1., dt);
+
+		/// Lower-layer tensors stay orthonormal
+		for (const Node& node : tree) {
+			if (node.isToplayer()) { continue; }
+			Matrixcd S = Psi[node].DotProduct(Psi[node]);
+			Matrixcd I = IdentityMatrix<complex<double>>(S.Dim1());
+				CHECK_CLOSE(0., Residual(S, I), 1e-6);
+		}
+			CHECK_CLOSE(n0, norm(Psi), 1e-6);
+			CHECK_CLOSE(0., abs(energy(Psi) - E0), 1e-4);
+		/// Two mean-field evaluations per accepted step plus rejected steps
+			CHECK(cmf.nMeanFields() >= 2 * cmf.nSteps());
+	}
+}
@@ -0,0 +1,123 @@
+#include "UnitTest++/UnitTest++.h"
+#include "Util/Lanczos.h"
+#include "Util/RandomMatrices.h"
+#include "Core/Tensor_Extension.h"
+#include "TreeShape/TreeFactory.h"
+
+SUITE (Lanczos) {
+	double eps = 1e-8;
+
+	class HelperFactory {
+	public:
+		HelperFactory() {
+			Initialize();
+		}
+
+		~HelperFactory() = default;
+
+		size_t dim_{200};
+		mt19937 gen_{1990};
+		Matrixcd H_;
+		Vectord ev_;
+		vector<Tensorcd> start_;
+
+		void Initialize() {
+			H_ = RandomMatrices::GUE(dim_, gen_);
+			ev_ = Diagonalize(H_).second;
+			for (size_t b = 0; b < 2; ++b) {
+				Tensorcd Psi(TensorShape({dim_, 1}));
+				Tensor_Extension::Generate(Psi, gen_);
+				start_.push_back(Psi);
+			}
+		}
+
+		Lanczos<Tensorcd>::Apply apply() const {
+			return [this](Tensorcd& HPsi, const Tensorcd& Psi) {
+				MatrixTensor(HPsi, H_, Psi, 0, true);
+			};
+		}
+
+		void check(const Lanczos<Tensorcd>& lanczos, size_t nEigen, double res = 1e-8) {
+			const Vectord& ev = lanczos.Eigenvalues();
+				CHECK_EQUAL(nEigen, ev.Dim());
+			for (size_t i = 0; i < nEigen; ++i) {
+					CHECK_CLOSE(ev_(i), ev(i), eps);
+				const Tensorcd& y = lanczos.Eigenvectors()[i];
+				Tensorcd Hy = MatrixTensor(H_, y, 0);
+				KrylovTraits<Tensorcd>::Axpy(Hy, -ev(i), y);
+					CHECK_CLOSE(0., sqrt(abs(KrylovTraits<Tensorcd>::Dot(Hy, Hy))), res);
+			}
+		}
+	};
+
+	TEST_FIXTURE (HelperFactory, BlockRestart) {
+		Lanczos<Tensorcd>::Parameters par;
+		par.nEigen = 3;
+		par.maxKrylov = 30;
+		par.tolerance = 1e-9;
+		Lanczos<Tensorcd> lanczos(apply(), par);
+		bool converged = lanczos.Solve(start_);
+			CHECK_EQUAL(true, converged);
+			CHECK(lanczos.nRestarts() > 0);
+		check(lanczos, par.nEigen);
+	}
+
+	TEST_FIXTURE (HelperFactory, Reorthogonalization) {
+		/// Without full reorthogonalization, eigenvectors are accurate to ~sqrt(machine eps)
+		for (auto reorth : {Lanczos<Tensorcd>::Reorthogonalization::None,
+			Lanczos<Tensorcd>::Reorthogonalization::Selective}) {
+			Lanczos<Tensorcd>::Parameters par;
+			par.nEigen = 2;
+			par.tolerance = 1e-9;
+			par.reorthogonalization = reorth;
+			Lanczos<Tensorcd> lanczos(apply(), par);
+				CHECK_EQUAL(true, lanczos.Solve(start_));
+			check(lanczos, par.nEigen, 1e-5);
+		}
+	}
+
+	TEST_FIXTURE (HelperFactory, OutOfCore) {
+		Lanczos<Tensorcd>::Parameters par;
+		par.nEigen = 3;
+		par.maxKrylov = 30;
+		par.tolerance = 1e-9;
+		Lanczos<Tensorcd> inMemory(apply(), par);
+		inMemory.Solve(start_);
+
+		par.storage = "lanczos.krylov.tmp";
+		Lanczos<Tensorcd> outOfCore(apply(), par);
+			CHECK_EQUAL(true, outOfCore.Solve(start_));
+		check(outOfCore, par.nEigen);
+			CHECK_EQUAL(inMemory.nApply(), outOfCore.nApply());
+	}
+
+	TEST (TensorTree) {
+		/// Diagonal operator on all coefficients of a TensorTree
+		Tree tree = TreeFactory::BalancedTree(6, 3, 2);
+		mt19937 gen(2020);
+		TensorTreecd Psi(tree);
+		for (Tensorcd& Phi : Psi) {
+			Tensor_Extension::Generate(Phi, gen);
+		}
+		auto apply = [](TensorTreecd& HPsi, const TensorTreecd& Psi) {
+			size_t I = 0;
+			for (size_t n = 0; n < Psi.size(); ++n) {
+				const Tensorcd& Phi = Psi.begin()[n];
+				Tensorcd& HPhi = HPsi.begin()[n];
+				for (size_t i = 0; i < Phi.shape().totalDimension(); ++i, ++I) {
+					HPhi(i) = (0.5 + (double) I) * Phi(i);
+				}
+			}
+		};
+
+		Lanczos<TensorTreecd>::Parameters par;
+		par.nEigen = 2;
+		par.maxKrylov = 20;
+		par.tolerance = 1e-9;
+		par.storage = "lanczos.tree.tmp";
+		Lanczos<TensorTreecd> lanczos(apply, par);
+			CHECK_EQUAL(true, lanczos.Solve({Psi}));
+			CHECK_CLOSE(0.5, lanczos.Eigenvalues()(0), eps);
+			CHECK_CLOSE(1.5, lanczos.Eigenvalues()(1), eps);
+	}
+}
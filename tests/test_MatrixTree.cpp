@@ -10,6 +10,8 @@
 #include "TreeShape/TreeFactory.h"
 #include "TreeClasses/TreeTransformation.h"
 #include "TreeClasses/TensorTreeFunctions.h"
+#include "TreeClasses/TreeSweep.h"
+#include <atomic>
 
 SUITE (MatrixTree) {
 	double eps = 1e-8;
@@ -57,6 +59,35 @@ SUITE (MatrixTreeFunctions) {
 		}
 	}
 
+	TEST (GramMatrix) {
+		mt19937 gen(1923);
+		Tree tree = TreeFactory::BalancedTree(7, 5, 3);
+		size_t N = 5;
+		vector<TensorTreecd> Psis;
+		for (size_t a = 0; a < N; ++a) {
+			Psis.emplace_back(gen, tree, false);
+		}
+
+		MatrixTreecd S(tree);
+		DotProduct(S, Psis, tree);
+		Matrixcd G = GramMatrix(Psis, tree);
+			CHECK_EQUAL(N, G.Dim1());
+		for (size_t a = 0; a < N; ++a) {
+			for (size_t b = 0; b < N; ++b) {
+				MatrixTreecd Sab = DotProduct(Psis[a], Psis[b], tree);
+				for (const Node& node : tree) {
+					size_t n = node.shape().lastDimension();
+					for (size_t i = 0; i < n; ++i) {
+						for (size_t j = 0; j < n; ++j) {
+								CHECK_CLOSE(0., abs(S[node](a * n + i, b * n + j) - Sab[node](i, j)), eps);
+						}
+					}
+				}
+					CHECK_CLOSE(0., abs(G(a, b) - Sab[tree.TopNode()](0, 0)), eps);
+			}
+		}
+	}
+
 	TEST (Contraction) {
 		mt19937 gen(1923);
 		Tree tree = TreeFactory::BalancedTree(7, 5, 4);
@@ -68,6 +99,75 @@ SUITE (MatrixTreeFunctions) {
 			CHECK_EQUAL(tree.nNodes(), S.size());
 	}
 
+	TEST (Workspace) {
+		mt19937 gen(1923);
+		Tree tree = TreeFactory::BalancedTree(7, 5, 4);
+		TensorTreecd Psi(gen, tree, false);
+		TensorTreecd Chi(gen, tree, false);
+		MatrixTreecd S = DotProduct(Psi, Chi, tree);
+		MatrixTreecd Rho = Contraction(Psi, Chi, S, tree);
+
+		TreeWorkspacecd work(tree);
+		MatrixTreecd Sw(tree);
+		MatrixTreecd Rhow(tree);
+		DotProduct(Sw, Psi, Chi, tree, work);
+		Contraction(Rhow, Psi, Chi, Sw, tree, work);
+		for (const Node& node : tree) {
+				CHECK_CLOSE(0., Residual(S[node], Sw[node]), eps);
+				CHECK_CLOSE(0., Residual(Rho[node], Rhow[node]), eps);
+		}
+
+		/// Repeated sweeps must not allocate
+		Memory::resetStatistics();
+		DotProduct(Sw, Psi, Chi, tree, work);
+		Contraction(Rhow, Psi, Chi, Sw, tree, work);
+			CHECK_EQUAL(0, Memory::statistics().allocations);
+	}
+
+	TEST (TreeSweep) {
+		Tree tree = TreeFactory::BalancedTree(16, 3, 2);
+		vector<atomic<int>> visited(tree.nNodes());
+		for (auto& v : visited) { v = 0; }
+		atomic<bool> ordered(true);
+		TreeSweep::BottomUp(tree, [&](const Node& node) {
+			if (!node.isBottomlayer()) {
+				for (int k = 0; k < node.nChildren(); ++k) {
+					if (visited[node.child(k).Address()] != 1) { ordered = false; }
+				}
+			}
+			visited[node.Address()]++;
+		});
+		for (auto& v : visited) {
+				CHECK_EQUAL(1, v);
+		}
+
+		TreeSweep::TopDown(tree, [&](const Node& node) {
+			if (!node.isToplayer() && visited[node.parent().Address()] != 2) { ordered = false; }
+			visited[node.Address()]++;
+		});
+		for (auto& v : visited) {
+				CHECK_EQUAL(2, v);
+		}
+			CHECK_EQUAL(true, ordered);
+	}
+
+	TEST (Deterministic) {
+		mt19937 gen(1923);
+		Tree tree = TreeFactory::BalancedTree(16, 3, 2);
+		TensorTreecd Psi(gen, tree, false);
+		TensorTreecd Chi(gen, tree, false);
+		MatrixTreecd S = DotProduct(Psi, Chi, tree);
+		MatrixTreecd Rho = Contraction(Psi, Chi, S, tree);
+		for (size_t i = 0; i < 4; ++i) {
+			MatrixTreecd S2 = DotProduct(Psi, Chi, tree);
+			MatrixTreecd Rho2 = Contraction(Psi, Chi, S2, tree);
+			for (const Node& node : tree) {
+					CHECK_EQUAL(0., Residual(S[node], S2[node]));
+					CHECK_EQUAL(0., Residual(Rho[node], Rho2[node]));
+			}
+		}
+	}
+
 	TEST (Density) {
 		mt19937 gen(1923);
 		Tree tree = TreeFactory::BalancedTree(7, 5, 4);
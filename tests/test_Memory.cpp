@@ -0,0 +1,81 @@
+#include "UnitTest++/UnitTest++.h"
+#include "Core/Tensor.h"
+#include "Core/Allocator.h"
+
+SUITE (Memory) {
+
+	TEST (Alignment) {
+		for (size_t n : {1, 3, 17, 1000, 123457}) {
+			Tensorcd A({n, 2});
+				CHECK_EQUAL(0, ((uintptr_t) &A[0]) % Memory::alignment);
+			Matrixd M(n, 3);
+				CHECK_EQUAL(0, ((uintptr_t) M.Coeffs()) % Memory::alignment);
+			Vectorcd v(n);
+				CHECK_EQUAL(0, ((uintptr_t) &v(0)) % Memory::alignment);
+		}
+	}
+
+	TEST (PoolReuse) {
+		TensorShape shape({4, 5, 6});
+		Memory::releasePool();
+		{ Tensorcd warmup(shape); }
+		Memory::resetStatistics();
+		for (size_t i = 0; i < 10; ++i) {
+			Tensorcd A(shape);
+			Tensorcd B(A);
+		}
+		Memory::Statistics stat = Memory::statistics();
+			CHECK_EQUAL(20, stat.allocations);
+			CHECK_EQUAL(20, stat.deallocations);
+		/// Only the second block of the first iteration is new
+			CHECK_EQUAL(19, stat.poolHits);
+	}
+
+	TEST (AdoptNewArray) {
+		/// Tensors that take ownership of a new[] buffer keep its coefficients
+		TensorShape shape({3, 4});
+		auto *ptr = new complex<double>[shape.totalDimension()];
+		for (size_t i = 0; i < shape.totalDimension(); ++i) {
+			ptr[i] = complex<double>(i, -1. * i);
+		}
+		Tensorcd A(shape, ptr, true, false);
+			CHECK_EQUAL(0, ((uintptr_t) &A[0]) % Memory::alignment);
+		for (size_t i = 0; i < shape.totalDimension(); ++i) {
+				CHECK_EQUAL(complex<double>(i, -1. * i), A[i]);
+		}
+		Tensorcd B(shape, new complex<double>[shape.totalDimension()]);
+			CHECK_EQUAL(complex<double>(0.), B[0]);
+	}
+
+	TEST (SystemPolicy) {
+		Memory::setPolicy(Memory::Policy::System);
+		Memory::resetStatistics();
+		for (size_t i = 0; i < 5; ++i) {
+			Matrixcd M(7, 7);
+		}
+		Memory::Statistics stat = Memory::statistics();
+			CHECK_EQUAL(0, stat.poolHits);
+			CHECK_EQUAL(5, stat.systemAllocations);
+		Memory::setPolicy(Memory::Policy::Pool);
+	}
+
+	TEST (Arena) {
+		Memory::Arena arena(1024);
+		Memory::resetStatistics();
+		{
+			Memory::ArenaScope scope(arena);
+			Tensorcd A({10, 10});
+			Tensorcd B({100, 100});
+				CHECK_EQUAL(0, ((uintptr_t) &B[0]) % Memory::alignment);
+				CHECK_EQUAL(2, arena.live());
+		}
+			CHECK_EQUAL(0, arena.live());
+			CHECK_EQUAL(2, Memory::statistics().arenaAllocations);
+		arena.reset();
+			CHECK_EQUAL(0, arena.used());
+
+		/// Outside of the scope the pool is used again
+		Tensorcd C({10, 10});
+			CHECK_EQUAL(2, Memory::statistics().arenaAllocations);
+	}
+}
@@ -4,11 +4,17 @@
 #include "UnitTest++/UnitTest++.h"
 #include "TreeOperators/LeafOperator.h"
 #include "TreeOperators/LeafMatrix.h"
+#include "TreeOperators/LeafDiagonal.h"
+#include "TreeOperators/LeafSparseMatrix.h"
 #include "TreeOperators/MultiLeafOperator.h"
 #include "TreeShape/LeafTypes/HO_Basis.h"
 #include "TreeShape/Tree.h"
 #include "TreeShape/TreeFactory.h"
 #include "TreeOperators/SumOfProductsOperator_Implementation.h"
+#include "TreeOperators/TensorOperators/TensorOperatorTreeFunctions.h"
+#include "TreeClasses/MatrixTreeFunctions.h"
+#include "TreeClasses/SparseMatrixTreeFunctions.h"
+#include "Core/Tensor_Extension.h"
 
 SUITE (Operators) {
 	class HelperFactory {
@@ -89,4 +95,201 @@ SUITE (Operators) {
 		SOPcd SS = S * S;
 			CHECK_EQUAL(4, SS.size());
 	}
+
+	TEST_FIXTURE (HelperFactory, SOP_Compress) {
+		/// Transverse-field Ising chain with 15 terms
+		Tree tree = TreeFactory::BalancedTree(8, 2, 2);
+		mt19937 gen(1990);
+		TensorTreecd Psi(gen, tree, false);
+
+		Matrixcd Z(2, 2);
+		Z(0, 0) = 1.;
+		Z(1, 1) = -1.;
+		LeafMatrixcd z(Z);
+		SOPcd S;
+		for (size_t i = 0; i < tree.nLeaves(); ++i) {
+			MLOcd M(x, i);
+			S.push_back(M, 0.5);
+		}
+		for (size_t i = 0; i + 1 < tree.nLeaves(); ++i) {
+			MLOcd M(z, i);
+			M.push_back(z, i + 1);
+			S.push_back(M, 1.);
+		}
+
+		const Node& top = tree.TopNode();
+		complex<double> ref = 0.;
+		for (size_t l = 0; l < S.size(); ++l) {
+			auto MPsi = S[l].Apply(Psi, tree);
+			auto Sx = TreeFunctions::DotProduct(Psi, MPsi, tree);
+			ref += S.Coeff(l) * Sx[top](0, 0);
+		}
+
+		TensorOperatorTree H(S, tree);
+		auto hs = TreeFunctions::Represent(Psi, H, tree);
+			CHECK_CLOSE(0., abs(hs[top][0](0, 0) - ref), 1e-8 * abs(ref));
+
+		TensorOperatorTree Hc = TreeFunctions::Compress(S, tree, 1e-10);
+		auto hcs = TreeFunctions::Represent(Psi, Hc, tree);
+			CHECK_CLOSE(0., abs(hcs[top][0](0, 0) - ref), 1e-8 * abs(ref));
+		/// Rank is bounded by I, the local Hamiltonian and one Z per cut bond
+		vector<vector<bool>> below(tree.nNodes(), vector<bool>(tree.nLeaves(), false));
+		for (size_t i = 0; i < tree.nLeaves(); ++i) {
+			auto node = (const Node *) &tree.GetLeaf(i).Up();
+			while (!node->isToplayer()) {
+				below[node->Address()][i] = true;
+				node = &node->parent();
+			}
+		}
+		for (const Node& node : tree) {
+			if (!node.isToplayer()) {
+				const vector<bool>& a = below[node.Address()];
+				size_t cut = 0;
+				for (size_t i = 0; i + 1 < tree.nLeaves(); ++i) {
+					if (a[i] != a[i + 1]) { cut++; }
+				}
+					CHECK(Hc[node].shape().lastDimension() <= 2 + cut);
+			}
+		}
+	}
+
+	TEST_FIXTURE (HelperFactory, MLO_Compile) {
+		/// Hermite-DVR leaves: x is diagonal, p is not
+		Tree tree = TreeFactory::UnbalancedTree(4, 4, 2, 0);
+		for (size_t l = 0; l < tree.nLeaves(); ++l) {
+			tree.GetLeaf(l).PrimitiveGrid().Initialize(1., 0., 0., 1.);
+		}
+		mt19937 gen(2024);
+		TensorTreecd Psi(gen, tree, false);
+		Matrixcd A(4, 4), B(4, 4);
+		Tensor_Extension::Generate(A, gen);
+		Tensor_Extension::Generate(B, gen);
+		LeafFuncd xf = &LeafInterface::applyX;
+		LeafFuncd pf = &LeafInterface::applyP;
+
+		/// Leaf 0: matrix, diagonal, matrix; leaf 1: two diagonals;
+		/// leaf 2: non-diagonal function and a matrix; leaf 3: nothing
+		MLOcd M(A, 0);
+		M.push_back(xf, 0);
+		M.push_back(B, 0);
+		M.push_back(xf, 1);
+		M.push_back(xf, 1);
+		M.push_back(pf, 2);
+		M.push_back(A, 2);
+		auto ref = M.Apply(Psi, tree);
+
+		MLOcd Mc(M);
+		Mc.Compile(tree);
+			CHECK(Mc.Compiled());
+			CHECK_EQUAL(1, Mc.nCompiledSteps(0));
+			CHECK_EQUAL(1, Mc.nCompiledSteps(1));
+			CHECK_EQUAL(2, Mc.nCompiledSteps(2));
+			CHECK_EQUAL(0, Mc.nCompiledSteps(3));
+		auto res = Mc.Apply(Psi, tree);
+		for (const Node& node : tree) {
+				CHECK_CLOSE(0., Residual(ref[node], res[node]), 1e-10);
+			if (!node.isBottomlayer()) { continue; }
+			Tensorcd w1(Psi[node].shape()), w2(Psi[node].shape());
+			const Tensorcd& hPhi = Mc.ApplyBottomLayer(Psi[node], w1, w2, node.getLeaf());
+				CHECK_CLOSE(0., Residual(ref[node], hPhi), 1e-10);
+		}
+
+		/// Leaves of another dimension are not applied with the compiled form
+		Tree tree6 = TreeFactory::UnbalancedTree(4, 6, 2, 0);
+		for (size_t l = 0; l < tree6.nLeaves(); ++l) {
+			tree6.GetLeaf(l).PrimitiveGrid().Initialize(1., 0., 0., 1.);
+		}
+		TensorTreecd Psi6(gen, tree6, false);
+		MLOcd F(xf, 1);
+		F.push_back(pf, 1);
+		F.push_back(xf, 1);
+		auto ref6 = F.Apply(Psi6, tree6);
+		F.Compile(tree);
+		auto res6 = F.Apply(Psi6, tree6);
+		for (const Node& node : tree6) {
+				CHECK_CLOSE(0., Residual(ref6[node], res6[node]), 1e-10);
+		}
+
+		/// Adding a SPO invalidates the compiled form
+		Mc.push_back(A, 3);
+			CHECK(!Mc.Compiled());
+	}
+
+	TEST_FIXTURE (HelperFactory, LeafDiagonalSparse) {
+		Tree tree = TreeFactory::UnbalancedTree(4, 4, 2, 0);
+		for (size_t l = 0; l < tree.nLeaves(); ++l) {
+			tree.GetLeaf(l).PrimitiveGrid().Initialize(1., 0., 0., 1.);
+		}
+		mt19937 gen(2025);
+		TensorTreecd Psi(gen, tree, false);
+		Matrixcd A(4, 4);
+		Tensor_Extension::Generate(A, gen);
+		Vectorcd d(4);
+		for (size_t i = 0; i < d.Dim(); ++i) {
+			d(i) = complex<double>(1. + i, 0.5 * i);
+		}
+		/// Annihilation operator and a matrix with two entries per row
+		Matrixcd a(4, 4), B(4, 4);
+		for (size_t i = 0; i + 1 < 4; ++i) {
+			a(i, i + 1) = sqrt(i + 1.);
+		}
+		for (size_t i = 0; i < 4; ++i) {
+			B(i, i) = complex<double>(0.5, 1.);
+			B(i, 3 - i) += complex<double>(-1., 0.25 * i);
+		}
+		LeafDiagonalcd dg(d);
+		LeafSparseMatrixcd as(a);
+		LeafSparseMatrixcd bs(B);
+			CHECK_EQUAL(3, as.nnz());
+			CHECK_EQUAL(8, bs.nnz());
+			CHECK_CLOSE(0., Residual(a, as.Dense()), 1e-14);
+			CHECK_CLOSE(0., Residual(a, toMatrix(as, tree.GetLeaf(0))), 1e-14);
+			CHECK_CLOSE(0., Residual(dg.Dense(), toMatrix(dg, tree.GetLeaf(0))), 1e-14);
+
+		/// Leaf 0: diagonal, sparse, diagonal; leaf 1: two sparse;
+		/// leaf 2: sparse and a matrix; leaf 3: a single diagonal
+		MLOcd M(dg, 0);
+		M.push_back(bs, 0);
+		M.push_back(dg, 0);
+		M.push_back(as, 1);
+		M.push_back(bs, 1);
+		M.push_back(as, 2);
+		M.push_back(A, 2);
+		M.push_back(dg, 3);
+		MLOcd Mdense(dg.Dense(), 0);
+		Mdense.push_back(B, 0);
+		Mdense.push_back(dg.Dense(), 0);
+		Mdense.push_back(a, 1);
+		Mdense.push_back(B, 1);
+		Mdense.push_back(a, 2);
+		Mdense.push_back(A, 2);
+		Mdense.push_back(dg.Dense(), 3);
+
+		auto ref = Mdense.Apply(Psi, tree);
+		auto res = M.Apply(Psi, tree);
+		for (const Node& node : tree) {
+				CHECK_CLOSE(0., Residual(ref[node], res[node]), 1e-10);
+		}
+
+		MLOcd Mc(M);
+		Mc.Compile(tree);
+			CHECK_EQUAL(1, Mc.nCompiledSteps(0));
+			CHECK_EQUAL(2, Mc.nCompiledSteps(1));
+			CHECK_EQUAL(1, Mc.nCompiledSteps(2));
+			CHECK_EQUAL(1, Mc.nCompiledSteps(3));
+		auto resc = Mc.Apply(Psi, tree);
+		for (const Node& node : tree) {
+				CHECK_CLOSE(0., Residual(ref[node], resc[node]), 1e-10);
+		}
+
+		/// Represent uses the diagonal and sparse kernels at the bottom layer
+		auto href = TreeFunctions::Represent(Mdense, Psi, tree);
+		auto h = TreeFunctions::Represent(M, Psi, tree);
+		auto hc = TreeFunctions::Represent(Mc, Psi, tree);
+		for (const Node& node : tree) {
+			if (!href.Active(node)) { continue; }
+				CHECK_CLOSE(0., Residual(href[node], h[node]), 1e-10);
+				CHECK_CLOSE(0., Residual(href[node], hc[node]), 1e-10);
+		}
+	}
 }
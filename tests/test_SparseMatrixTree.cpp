@@ -67,6 +67,92 @@ SUITE (SparseMatrixTree) {
 		}
 	}
 
+	TEST_FIXTURE (HelperFactory, Workspace) {
+		SparseMatrixTreecd mats = TreeFunctions::Represent(M_, Psi_, tree_);
+		SparseMatrixTreecd holes(M_, tree_);
+		TreeFunctions::Contraction(holes, Psi_, Psi_, mats, tree_);
+
+		TreeWorkspacecd work(tree_);
+		SparseMatrixTreecd matsw(M_, tree_);
+		SparseMatrixTreecd holesw(M_, tree_);
+		TreeFunctions::Represent(matsw, M_, Psi_, Psi_, tree_, work);
+		TreeFunctions::Contraction(holesw, Psi_, Psi_, matsw, tree_, work);
+		const SparseTree& active = mats.Active();
+		for (const Node *node_ptr : active) {
+			const Node& node = *node_ptr;
+			if (!node.isToplayer()) {
+					CHECK_CLOSE(0., Residual(mats[node], matsw[node]), eps);
+			}
+				CHECK_CLOSE(0., Residual(holes[node], holesw[node]), eps);
+		}
+
+		/// Repeated sweeps must not allocate
+		Memory::resetStatistics();
+		TreeFunctions::Represent(matsw, M_, Psi_, Psi_, tree_, work);
+		TreeFunctions::Contraction(holesw, Psi_, Psi_, matsw, tree_, work);
+			CHECK_EQUAL(0, Memory::statistics().allocations);
+	}
+
+	TEST_FIXTURE (HelperFactory, ParallelSOP) {
+		SOPcd H;
+		for (size_t k = 0; k < 7; ++k) {
+			Matrixcd X(2, 2);
+			X(0, 1) = 1.;
+			X(1, 0) = 1. + 0.1 * k;
+			MLOcd M(X, k);
+			M.push_back(X, k + 1);
+			H.push_back(M, 1.);
+		}
+		SOPMatrixTrees<complex<double>> mats(H, tree_);
+		TreeFunctions::Represent(mats, H, Psi_, Psi_, tree_);
+
+		TreeWorkspacescd work(3, TreeWorkspacecd(tree_));
+		SOPMatrixTrees<complex<double>> matsw(H, tree_);
+		TreeFunctions::Represent(matsw, H, Psi_, Psi_, tree_, work);
+		for (size_t l = 0; l < H.size(); ++l) {
+			const SparseTree& active = mats.matrices_[l].Active();
+			for (const Node *node_ptr : active) {
+				const Node& node = *node_ptr;
+				if (!node.isToplayer()) {
+						CHECK_CLOSE(0., Residual(mats.matrices_[l][node], matsw.matrices_[l][node]), eps);
+				}
+					CHECK_CLOSE(0., Residual(mats.contractions_[l][node], matsw.contractions_[l][node]), eps);
+			}
+		}
+	}
+
+	TEST_FIXTURE (HelperFactory, SubtreeCache) {
+		/// All terms share the operator on leaf 0
+		Matrixcd X(2, 2);
+		X(0, 1) = 1.;
+		X(1, 0) = 1.;
+		shared_ptr<LeafOperatorcd> x = make_shared<LeafMatrixcd>(X);
+		SOPcd H;
+		for (size_t k = 1; k < 8; ++k) {
+			MLOcd M(x, 0);
+			M.push_back(X, k);
+			H.push_back(M, 1.);
+		}
+		SOPSubtreeCache<complex<double>> cache(H, tree_);
+			CHECK_EQUAL(true, cache.nDistinct() < cache.nMatrices());
+
+		SOPMatrixTrees<complex<double>> mats(H, tree_);
+		TreeFunctions::Represent(mats, H, Psi_, Psi_, tree_);
+
+		TreeWorkspacescd work(2, TreeWorkspacecd(tree_));
+		SOPMatrixTrees<complex<double>> matsw(H, tree_);
+		TreeFunctions::Represent(matsw, H, Psi_, Psi_, cache, tree_, work);
+		for (size_t l = 0; l < H.size(); ++l) {
+			for (const Node *node_ptr : mats.matrices_[l].Active()) {
+				const Node& node = *node_ptr;
+				if (!node.isToplayer()) {
+						CHECK_CLOSE(0., Residual(mats.matrices_[l][node], matsw.matrices_[l][node]), eps);
+				}
+					CHECK_CLOSE(0., Residual(mats.contractions_[l][node], matsw.contractions_[l][node]), eps);
+			}
+		}
+	}
+
 	TEST_FIXTURE (HelperFactory, Constructor) {
 		SparseMatrixTreecd hmat(M_, tree_);
 			CHECK_EQUAL(6, hmat.Size());
@@ -3,6 +3,8 @@
 #include <UnitTest++/UnitTest++.h>
 #include "Util/QMConstants.h"
 #include "Core/Tensor_Extension.h"
+#include "Core/LAKernels.h"
+#include "Core/TensorKernels.h"
 
 using namespace std;
 
@@ -204,6 +206,284 @@ SUITE (Tensor) {
 		}
 	}
 
+	Tensorcd NaiveMatrixTensor(const Matrixcd& M, const Tensorcd& B, size_t mode) {
+		/// C(i, j, k) = M(j, l) * B(i, l, k)
+		TensorShape shape = replaceDimension(B.shape(), mode, M.Dim1());
+		Tensorcd C(shape);
+		size_t before = shape.before(mode);
+		size_t after = shape.after(mode);
+		for (size_t k = 0; k < after; ++k) {
+			for (size_t j = 0; j < M.Dim1(); ++j) {
+				for (size_t l = 0; l < M.Dim2(); ++l) {
+					for (size_t i = 0; i < before; ++i) {
+						C(i, j, k, mode) += M(j, l) * B(i, l, k, mode);
+					}
+				}
+			}
+		}
+		return C;
+	}
+
+	TEST_FIXTURE (TensorFactory, MatrixTensor_AllModes) {
+		mt19937 gen(1923);
+		for (size_t mode = 0; mode < A.shape().order(); ++mode) {
+			size_t active = A.shape()[mode];
+			for (size_t activeC : {active, active + 2}) {
+				Matrixcd M(activeC, active);
+				Tensor_Extension::Generate(M, gen);
+				Tensorcd C = MatrixTensor(M, A, mode);
+				Tensorcd Cref = NaiveMatrixTensor(M, A, mode);
+					CHECK_EQUAL(activeC, C.shape()[mode]);
+					CHECK_CLOSE(0., Residual(C, Cref), eps);
+
+				/// Accumulate onto the previous result
+				MatrixTensor(C, M, A, mode, false);
+					CHECK_CLOSE(0., Residual(C, 2. * Cref), eps);
+
+				/// B * M^T == M * B
+				Matrixcd MT = M.Transpose();
+				Tensorcd D = TensorMatrix(A, MT, mode);
+					CHECK_CLOSE(0., Residual(D, Cref), eps);
+
+				/// M^H * (M * B) == (M^H M) * B
+				Tensorcd E = multATB(M, Cref, mode);
+				Tensorcd Eref = NaiveMatrixTensor(M.Adjoint() * M, A, mode);
+					CHECK_CLOSE(0., Residual(E, Eref), eps);
+			}
+		}
+	}
+
+	TEST (FixedDimKernels) {
+		/// Active dimensions 2, 3 and 4 run on the fixed-size kernels, 5 on the generic ones
+		mt19937 gen(1923);
+		for (size_t d = 2; d <= 5; ++d) {
+			TensorShape shape({d, d, d, 3});
+			Tensorcd B(shape);
+			Tensor_Extension::Generate(B, gen);
+			Tensord Bd(shape);
+			Tensor_Extension::Generate(Bd, gen);
+			for (size_t mode = 0; mode < shape.order(); ++mode) {
+				size_t a = shape[mode];
+				Matrixcd M(a, a);
+				Tensor_Extension::Generate(M, gen);
+				Tensorcd Cref = NaiveMatrixTensor(M, B, mode);
+				Tensorcd C = MatrixTensor(M, B, mode);
+					CHECK_CLOSE(0., Residual(C, Cref), eps);
+				MatrixTensor(C, M, B, mode, false);
+					CHECK_CLOSE(0., Residual(C, 2. * Cref), eps);
+				Tensorcd D = TensorMatrix(B, M.Transpose(), mode);
+					CHECK_CLOSE(0., Residual(D, Cref), eps);
+				Tensorcd E = multATB(M, B, mode);
+					CHECK_CLOSE(0., Residual(E, NaiveMatrixTensor(M.Adjoint(), B, mode)), eps);
+
+				/// S(i, j) = sum conj(C(l, i, n)) * B(l, j, n)
+				Matrixcd S = Contraction(C, B, mode);
+				Matrixcd Sref(a, a);
+				size_t before = shape.before(mode);
+				size_t after = shape.after(mode);
+				for (size_t n = 0; n < after; ++n) {
+					for (size_t j = 0; j < a; ++j) {
+						for (size_t i = 0; i < a; ++i) {
+							for (size_t l = 0; l < before; ++l) {
+								Sref(i, j) += conj(C(l, i, n, mode)) * B(l, j, n, mode);
+							}
+						}
+					}
+				}
+					CHECK_CLOSE(0., Residual(S, Sref), eps * Sref.FrobeniusNorm());
+
+				/// Real tensors
+				Matrixd Md(a, a);
+				for (size_t i = 0; i < a * a; ++i) {
+					Md[i] = (double) i - 1.5;
+				}
+				Tensord Cd = MatrixTensor(Md, Bd, mode);
+				Tensord Ed = multATB(Md, Bd, mode);
+				Matrixd Sd = Contraction(Bd, Bd, mode);
+				Tensord Cdref(shape), Edref(shape);
+				Matrixd Sdref(a, a);
+				for (size_t n = 0; n < after; ++n) {
+					for (size_t j = 0; j < a; ++j) {
+						for (size_t k = 0; k < a; ++k) {
+							for (size_t l = 0; l < before; ++l) {
+								Cdref(l, j, n, mode) += Md(j, k) * Bd(l, k, n, mode);
+								Edref(l, j, n, mode) += Md(k, j) * Bd(l, k, n, mode);
+								Sdref(j, k) += Bd(l, j, n, mode) * Bd(l, k, n, mode);
+							}
+						}
+					}
+				}
+					CHECK_CLOSE(0., Residual(Cd, Cdref), eps);
+					CHECK_CLOSE(0., Residual(Ed, Edref), eps);
+					CHECK_CLOSE(0., Residual(Sd, Sdref), eps * Sdref.FrobeniusNorm());
+			}
+		}
+	}
+
+	TEST (MatrixTensor_RealMatrix) {
+		mt19937 gen(1923);
+		TensorShape shape({3, 4, 2});
+		Tensorcd B(shape);
+		Tensor_Extension::Generate(B, gen);
+		Matrixd M(5, 4);
+		for (size_t i = 0; i < M.Dim1() * M.Dim2(); ++i) {
+			M[i] = (double) i - 3.;
+		}
+		Matrixcd Mcd(5, 4);
+		for (size_t i = 0; i < M.Dim1() * M.Dim2(); ++i) {
+			Mcd[i] = M[i];
+		}
+		Tensorcd C = MatrixTensor(M, B, 1);
+		Tensorcd Cref = NaiveMatrixTensor(Mcd, B, 1);
+			CHECK_CLOSE(0., Residual(C, Cref), eps);
+	}
+
+	TEST (Contraction_Real) {
+		/// Contraction of real tensors with different active dimensions
+		mt19937 gen(1923);
+		Tensord A({3, 4, 2});
+		Tensord B({3, 5, 2});
+		Tensor_Extension::Generate(A, gen);
+		Tensor_Extension::Generate(B, gen);
+		Matrixd S = Contraction(A, B, 1);
+		Matrixd Sref(4, 5);
+		for (size_t n = 0; n < 2; ++n) {
+			for (size_t j = 0; j < 5; ++j) {
+				for (size_t i = 0; i < 4; ++i) {
+					for (size_t l = 0; l < 3; ++l) {
+						Sref(i, j) += A(l, i, n, 1) * B(l, j, n, 1);
+					}
+				}
+			}
+		}
+			CHECK_CLOSE(0., Residual(S, Sref), eps);
+
+		/// Accumulate if zero == false
+		Contraction(S, A, B, 1, false);
+			CHECK_CLOSE(0., Residual(S, 2. * Sref), eps);
+	}
+
+	TEST_FIXTURE (TensorFactory, TensorKernels_contraction) {
+		/// GEMM-based contraction against the loop kernel for every mode
+		mt19937 gen(1923);
+		for (size_t mode = 0; mode < A.shape().order(); ++mode) {
+			const TensorShape& shape = A.shape();
+			size_t before = shape.before(mode);
+			size_t after = shape.after(mode);
+			size_t active = shape[mode];
+			Tensorcd D(replaceDimension(shape, mode, active + 1));
+			Tensor_Extension::Generate(D, gen);
+
+			Matrixcd Sref(active, active + 1);
+			LAKernels::rhomat(&Sref[0], &A[0], &D[0], active, active + 1, before, after, false);
+			Matrixcd S(active, active + 1);
+			TensorKernels::contraction(&S[0], &A[0], &D[0], before, active, active + 1, after, true);
+				CHECK_CLOSE(0., Residual(S, Sref), eps);
+			TensorKernels::contraction(&S[0], &A[0], &D[0], before, active, active + 1, after, false);
+				CHECK_CLOSE(0., Residual(S, 2. * Sref), eps);
+		}
+	}
+
+	TEST_FIXTURE (TensorFactory, LAKernels_matvec) {
+		mt19937 gen(1923);
+		for (size_t mode = 0; mode < A.shape().order(); ++mode) {
+			const TensorShape& shape = A.shape();
+			size_t active = shape[mode];
+			Matrixcd M(active + 1, active);
+			Tensor_Extension::Generate(M, gen);
+			Tensorcd Cref = MatrixTensor(M, A, mode);
+
+			Tensorcd C(Cref.shape());
+			LAKernels::matvec(&C[0], &A[0], &M[0], active + 1, active,
+				shape.before(mode), shape.after(mode), false);
+				CHECK_CLOSE(0., Residual(C, Cref), eps);
+
+			Matrixcd MT = M.Transpose();
+			LAKernels::tmatvec(&C[0], &A[0], &MT[0], active + 1, active,
+				shape.before(mode), shape.after(mode), true);
+				CHECK_CLOSE(0., Residual(C, 2. * Cref), eps);
+		}
+	}
+
+	TEST (LAKernels_BLAS1) {
+		/// Long enough for several chunks (and threads), not a multiple of the chunk size
+		size_t n = 100003;
+		mt19937 gen(1923);
+		Tensorcd x({n}), y({n}), z({n});
+		Tensor_Extension::Generate(x, gen);
+		Tensor_Extension::Generate(y, gen);
+		Tensor_Extension::Generate(z, gen);
+		complex<double> a(0.3, -1.2), b(-0.7, 0.4);
+
+		complex<double> dot = 0.;
+		double nrm = 0.;
+		for (size_t i = 0; i < n; ++i) {
+			dot += conj(x(i)) * y(i);
+			nrm += pow(abs(x(i)), 2);
+		}
+			CHECK_CLOSE(0., abs(dot - LAKernels::vdot(&x[0], &y[0], n)), 1e-9);
+			CHECK_CLOSE(sqrt(nrm), LAKernels::vnrm2(&x[0], n), 1e-9);
+
+#ifdef _OPENMP
+		/// Reductions are bitwise identical for any number of threads
+		complex<double> dotN = LAKernels::vdot(&x[0], &y[0], n);
+		double nrmN = LAKernels::vnrm2(&x[0], n);
+		int nthreads = omp_get_max_threads();
+		omp_set_num_threads(1);
+		complex<double> dot1 = LAKernels::vdot(&x[0], &y[0], n);
+		double nrm1 = LAKernels::vnrm2(&x[0], n);
+		omp_set_num_threads(nthreads);
+			CHECK_EQUAL(dot1, dotN);
+			CHECK_EQUAL(nrm1, nrmN);
+#endif
+
+		Tensorcd w(y);
+		LAKernels::vaxpby(&w[0], &x[0], a, b, n);
+		double res = 0.;
+		for (size_t i = 0; i < n; ++i) { res += abs(w(i) - (a * x(i) + b * y(i))); }
+			CHECK_CLOSE(0., res, 1e-9);
+
+		w = y;
+		LAKernels::vaxpbz(&w[0], &x[0], a, &z[0], b, n);
+		res = 0.;
+		for (size_t i = 0; i < n; ++i) { res += abs(w(i) - (y(i) + a * x(i) + b * z(i))); }
+			CHECK_CLOSE(0., res, 1e-9);
+
+		/// Output aliases an input
+		w = x;
+		LAKernels::vlincomb(&w[0], &w[0], a, &z[0], b, n);
+		res = 0.;
+		for (size_t i = 0; i < n; ++i) { res += abs(w(i) - (a * x(i) + b * z(i))); }
+			CHECK_CLOSE(0., res, 1e-9);
+
+		/// Overwriting does not read stale NaNs from the output
+		const double nan = numeric_limits<double>::quiet_NaN();
+		for (size_t i = 0; i < n; ++i) { w(i) = complex<double>(nan, nan); }
+		LAKernels::vlincomb(&w[0], &x[0], a, &z[0], b, n);
+		res = 0.;
+		for (size_t i = 0; i < n; ++i) { res += abs(w(i) - (a * x(i) + b * z(i))); }
+			CHECK_CLOSE(0., res, 1e-9);
+		Tensord u({n}), v({n}), s({n});
+		for (size_t i = 0; i < n; ++i) {
+			u(i) = real(x(i));
+			v(i) = imag(z(i));
+			s(i) = nan;
+		}
+		LAKernels::vlincomb(&s[0], &u[0], 2., &v[0], -0.5, n);
+		res = 0.;
+		for (size_t i = 0; i < n; ++i) { res += abs(s(i) - (2. * u(i) - 0.5 * v(i))); }
+			CHECK_CLOSE(0., res, 1e-9);
+
+		w = x;
+		LAKernels::vscal(&w[0], a, n);
+		LAKernels::vaxpy(&w[0], &x[0], -a, n);
+			CHECK_CLOSE(0., LAKernels::vnrm2(&w[0], n), 1e-9);
+
+		Tensord r({n});
+		for (size_t i = 0; i < n; ++i) { r(i) = real(x(i)); }
+			CHECK_CLOSE(LAKernels::vnrm2(&r[0], n), sqrt(LAKernels::vdot(&r[0], &r[0], n)), 1e-9);
+	}
+
 	TEST (DirectSum) {
 		TensorShape Ashape({2, 2});
 		TensorShape Bshape({3, 3});
@@ -6,6 +6,12 @@
 #include "TreeShape/Tree.h"
 #include "TreeShape/TreeFactory.h"
 #include "TreeClasses/TensorTreeFunctions.h"
+#include "TreeClasses/RankAdaptation.h"
+#include "Util/KrylovSpace.h"
+#include "TreeClasses/TensorTreeCheckpoint.h"
+#include "TreeClasses/CheckpointWriter.h"
+#include "TreeClasses/OutOfCoreTensorTree.h"
+#include "TreeClasses/MatrixTreeFunctions.h"
 
 SUITE (TensorTree) {
 
@@ -83,5 +89,441 @@ SUITE (TensorTree) {
 		}
 	}
 
-}
+	/// Check that node shapes, tensor shapes and orthonormality agree
+	void CheckConsistent(const TensorTreecd& Psi, const Tree& tree) {
+		for (const Node& node : tree) {
+				CHECK_EQUAL(node.shape(), Psi[node].shape());
+			if (!node.isToplayer()) {
+				const Node& parent = node.parent();
+					CHECK_EQUAL(node.shape().lastDimension(), parent.shape()[node.childIdx()]);
+				Matrixcd S = Psi[node].DotProduct(Psi[node]);
+					CHECK_CLOSE(0., Residual(S, IdentityMatrix<complex<double>>(S.Dim1())), 1e-10);
+			}
+		}
+	}
+
+	/// |Psi - Chi|^2, Chi is padded to the shapes of tree
+	double Distance(const TensorTreecd& Psi, TensorTreecd Chi, const Tree& tree) {
+		TreeFunctions::Adjust(Chi, tree);
+		const Node& top = tree.TopNode();
+		auto spp = TreeFunctions::DotProduct(Psi, Psi, tree)[top](0, 0);
+		auto scc = TreeFunctions::DotProduct(Chi, Chi, tree)[top](0, 0);
+		auto spc = TreeFunctions::DotProduct(Psi, Chi, tree)[top](0, 0);
+		return abs(spp + scc - 2. * real(spc));
+	}
+
+	TEST (RankAdaptation_GrowTruncate) {
+		Tree tree = TreeFactory::BalancedTree(8, 4, 2);
+		mt19937 gen(1234);
+		TensorTreecd Psi(gen, tree, false);
+		TensorTreecd Psi0(Psi);
+		Tree tree0(tree);
+
+		/// Starved edges grow, the state does not change
+		TreeFunctions::RankParameters par;
+		par.tolerance = 0.;
+		par.spare = 2;
+			CHECK(TreeFunctions::AdaptRanks(Psi, tree, par));
+		CheckConsistent(Psi, tree);
+		for (const Node& node : tree) {
+			if (!node.isToplayer()) {
+				/// Bounded by the dimensions on both sides of the edge
+				const TensorShape& pshape = node.parent().shape();
+				size_t r = min((size_t) 4, node.shape().lastBefore());
+				r = min(r, pshape.totalDimension() / pshape[node.childIdx()]);
+					CHECK_EQUAL(r, node.shape().lastDimension());
+			}
+		}
+			CHECK_CLOSE(0., Distance(Psi, Psi0, tree), 1e-12);
+
+		/// Unoccupied functions are removed again
+		par.tolerance = 1e-12;
+		par.spare = 0;
+			CHECK(TreeFunctions::AdaptRanks(Psi, tree, par));
+		CheckConsistent(Psi, tree);
+		for (const Node& node : tree) {
+				CHECK_EQUAL(tree0.GetNode(node.Address()).shape(), node.shape());
+		}
+			CHECK_CLOSE(0., Distance(Psi0, Psi, tree0), 1e-12);
+
+		/// Without rank changes the basis is not rotated either
+		TensorTreecd Psi1(Psi);
+			CHECK(!TreeFunctions::AdaptRanks(Psi, tree, par));
+		for (const Node& node : tree) {
+				CHECK_EQUAL(Psi1[node], Psi[node]);
+		}
+	}
+
+	TEST (RankAdaptation_Error) {
+		/// The squared truncation error is bounded by the sum of the discarded populations
+		Tree tree = TreeFactory::BalancedTree(8, 4, 4);
+		mt19937 gen(4321);
+		TensorTreecd Psi(gen, tree, false);
+		const Node& top = tree.TopNode();
+		Psi[top] *= 1. / sqrt(abs(Psi[top].DotProduct(Psi[top])(0, 0)));
+		TensorTreecd Psi0(Psi);
+		Tree tree0(tree);
+
+		TreeFunctions::RankParameters par;
+		par.tolerance = 0.02;
+		par.spare = 0;
+			CHECK(TreeFunctions::AdaptRanks(Psi, tree, par));
+		CheckConsistent(Psi, tree);
+		size_t nEdges = tree.nNodes() - 1;
+		double err = Distance(Psi0, Psi, tree0);
+			CHECK(err > 0.);
+			CHECK(err <= nEdges * par.tolerance);
+	}
+
+	TEST (Truncate_HSVD) {
+		Tree tree = TreeFactory::BalancedTree(8, 4, 4);
+		mt19937 gen(987);
+		TensorTreecd Psi(gen, tree, false);
+		const Node& top = tree.TopNode();
+		Psi[top] *= 1. / sqrt(abs(Psi[top].DotProduct(Psi[top])(0, 0)));
+
+		TreeFunctions::TruncationParameters par;
+		par.eps = 0.2;
+		auto x = TreeFunctions::Truncate(Psi, tree, par);
+		CheckConsistent(x.Psi, x.tree);
+		double sum = 0.;
+		size_t nReduced = 0;
+		for (const Node& node : tree) {
+			if (node.isToplayer()) { continue; }
+			sum += x.discarded[node.Address()];
+			const Node& newnode = x.tree.GetNode(node.Address());
+			if (newnode.shape().lastDimension() < node.shape().lastDimension()) { nReduced++; }
+		}
+			CHECK(nReduced > 0);
+			CHECK_CLOSE(sqrt(sum), x.error, 1e-12);
+			CHECK(x.error <= par.eps);
+		double dist = Distance(Psi, x.Psi, tree);
+			CHECK(dist <= sum + 1e-12);
+			CHECK(dist > 0.);
+
+		/// Maximum rank
+		par.maxRank = 2;
+		auto y = TreeFunctions::Truncate(Psi, tree, par);
+		for (const Node& node : y.tree) {
+			if (!node.isToplayer()) {
+					CHECK(node.shape().lastDimension() <= 2);
+			}
+		}
+			CHECK(Distance(Psi, y.Psi, tree) <= y.error * y.error + 1e-12);
+	}
+
+	TEST (Truncate_Exact) {
+		/// A low-rank state on a larger tree is recovered without error
+		Tree tree = TreeFactory::BalancedTree(8, 4, 2);
+		mt19937 gen(5678);
+		TensorTreecd Psi(gen, tree, false);
+		Tree tree0(tree);
+		TreeFunctions::RankParameters rpar;
+		rpar.tolerance = 0.;
+		rpar.spare = 2;
+		TreeFunctions::AdaptRanks(Psi, tree, rpar);
+
+		TreeFunctions::TruncationParameters par;
+		par.eps = 1e-6;
+		auto x = TreeFunctions::Truncate(Psi, tree, par);
+		for (const Node& node : x.tree) {
+				CHECK_EQUAL(tree0.GetNode(node.Address()).shape(), node.shape());
+		}
+			CHECK_CLOSE(0., x.error, 1e-7);
+			CHECK_CLOSE(0., Distance(Psi, x.Psi, tree), 1e-12);
+	}
+
+	TEST (Contiguous) {
+		Tree tree = TreeFactory::BalancedTree(12, 3, 4);
+		mt19937 gen(2468);
+		TensorTreecd Psi(gen, tree, false);
+			CHECK(!Psi.Contiguous());
+
+		TensorTreecd Chi(Psi);
+		Chi.MakeContiguous();
+			CHECK(Chi.Contiguous());
+		for (const Node& node : tree) {
+				CHECK_EQUAL(Psi[node], Chi[node]);
+				CHECK_EQUAL(0, ((uintptr_t) &Chi[node][0]) % Memory::alignment);
+		}
+
+		/// Copies are contiguous and independent
+		TensorTreecd X(Chi);
+			CHECK(X.Contiguous());
+			CHECK(X.SameLayout(Chi));
+			CHECK(X.data() != Chi.data());
+		X += Chi;
+		X *= 0.5;
+		for (const Node& node : tree) {
+				CHECK_EQUAL(Psi[node], X[node]);
+		}
+		typedef KrylovTraits<TensorTreecd> Traits;
+			CHECK_CLOSE(0., abs(Traits::Dot(Psi, Psi) - Traits::Dot(X, Chi)), 1e-12);
+		Traits::Axpy(X, -1., Chi);
+			CHECK_CLOSE(0., abs(Traits::Dot(X, X)), 1e-24);
+
+		/// Same shape: written into the slab, different shape: leaves the slab
+		const Node& top = tree.TopNode();
+		Chi[top] = Psi[top];
+			CHECK(Chi.Contiguous());
+		Chi[top] = Psi[top].AdjustStateDim(2);
+			CHECK(!Chi.Contiguous());
+		Chi[top] = Psi[top];
+		Chi -= Psi;
+			CHECK_CLOSE(0., abs(Traits::Dot(Chi, Chi)), 1e-24);
+
+		/// Reading keeps the layout
+		TensorTreecd Y;
+		Y.InitializeContiguous(tree);
+			CHECK(Y.Contiguous());
+		stringstream ss;
+		Psi.Write(ss);
+		Y.Read(ss);
+			CHECK(Y.Contiguous());
+		for (const Node& node : tree) {
+				CHECK_EQUAL(Psi[node], Y[node]);
+		}
+	}
+
+	TEST (BLAS1) {
+		Tree tree = TreeFactory::BalancedTree(12, 3, 4);
+		mt19937 gen(1357);
+		TensorTreecd X(gen, tree, false);
+		TensorTreecd Y(gen, tree, false);
+		TensorTreecd Z(gen, tree, false);
+		typedef complex<double> cd;
+		cd a(0.5, -0.25), b(-1.5, 2.);
+
+		/// Reference node by node
+		TensorTreecd Ref(Y);
+		for (const Node& node : tree) {
+			Ref[node] *= b;
+			Ref[node] += a * X[node];
+		}
+
+		/// Same results with and without contiguous layout
+		for (bool contiguous : {false, true}) {
+			TensorTreecd x(X), y(Y), z(Z);
+			if (contiguous) {
+				x.MakeContiguous();
+				y.MakeContiguous();
+				z.MakeContiguous();
+			}
+				CHECK_CLOSE(0., abs(TreeFunctions::Dot(X, X) - pow(TreeFunctions::Nrm2(x), 2)), 1e-10);
+
+			TreeFunctions::Axpby(y, a, x, b);
+			TensorTreecd d(y);
+			d -= Ref;
+				CHECK_CLOSE(0., TreeFunctions::Nrm2(d), 1e-12);
+
+			/// y += a x + b z, then undo both parts
+			TreeFunctions::Axpbz(y, a, x, b, z);
+			TreeFunctions::Axpy(y, -a, x);
+			TreeFunctions::Axpy(y, -b, z);
+			d = y;
+			d -= Ref;
+				CHECK_CLOSE(0., TreeFunctions::Nrm2(d), 1e-12);
+
+			/// w = y / b - a / b x into preallocated memory gives Y
+			TensorTreecd w(y);
+			const cd *mem = &w[tree.TopNode()][0];
+			TreeFunctions::LinearCombination(w, 1. / b, y, -a / b, x);
+				CHECK_EQUAL(mem, &w[tree.TopNode()][0]);
+			TreeFunctions::Scal(w, b);
+			TreeFunctions::Axpy(w, -b, Y);
+				CHECK_CLOSE(0., TreeFunctions::Nrm2(w), 1e-12);
+
+			/// Into an empty tree
+			TensorTreecd e;
+			TreeFunctions::LinearCombination(e, a, x, b, z);
+			TreeFunctions::Axpy(e, -b, z);
+			TreeFunctions::Scal(e, 1. / a);
+			TreeFunctions::Axpy(e, cd(-1.), X);
+				CHECK_CLOSE(0., TreeFunctions::Nrm2(e), 1e-12);
+		}
+	}
+
+	TEST (Checkpoint) {
+		Tree tree = TreeFactory::BalancedTree(12, 3, 4);
+		mt19937 gen(97531);
+		TensorTreecd Psi(gen, tree, false);
+		TensorTreecd Chi(Psi);
+		Chi.MakeContiguous();
+		string file("TensorTree.ckp");
+
+		/// Node-by-node and bulk writes give the same file
+		stringstream a, b;
+		Checkpoint::Write(Psi, a);
+		Checkpoint::Write(Chi, b);
+			CHECK(a.str() == b.str());
+
+		TensorTreecd Read;
+		Checkpoint::Read(Read, a);
+			CHECK(Read.Contiguous());
+			CHECK_EQUAL(Psi.size(), Read.size());
+		for (const Node& node : tree) {
+				CHECK_EQUAL(Psi[node], Read[node]);
+		}
+
+		Checkpoint::Write(Psi, file);
+		{
+			MappedTensorTree<complex<double>> map(file, true);
+			const TensorTreecd& Mapped = map.Psi();
+				CHECK_EQUAL(Psi.size(), Mapped.size());
+				CHECK(map.Index().crc);
+			for (const Node& node : tree) {
+					CHECK_EQUAL(Psi[node], Mapped[node]);
+					CHECK_EQUAL(0, ((uintptr_t) &Mapped[node][0]) % 64);
+			}
+			/// Private mapping: the file is not changed
+			map.Psi()[tree.TopNode()] *= 2.;
+		}
+		TensorTreecd Again;
+		Checkpoint::Read(Again, file);
+			CHECK_EQUAL(Psi[tree.TopNode()], Again[tree.TopNode()]);
+
+		/// Real trees and files without CRCs
+		TensorTreed X(gen, tree, false);
+		stringstream c;
+		Checkpoint::Write(X, c, false);
+		auto idx = Checkpoint::ReadIndex(c);
+			CHECK(!idx.crc);
+			CHECK_EQUAL(Checkpoint::version, idx.version);
+			CHECK_EQUAL(0, idx.dataOffset % 64);
+		c.seekg(0);
+		TensorTreed Y;
+		Checkpoint::Read(Y, c);
+		for (const Node& node : tree) {
+				CHECK_EQUAL(X[node], Y[node]);
+		}
+
+		/// Check value of the standard
+			CHECK_EQUAL(0xCBF43926u, Checkpoint::CRC32("123456789", 9));
+	}
+
+	TEST (Compression) {
+		mt19937 gen(4242);
+		normal_distribution<double> dist;
+		/// Smooth, random and zero data, length not a multiple of the element size
+		vector<double> smooth(10001), noise(10001), zero(10001, 0.);
+		for (size_t i = 0; i < smooth.size(); ++i) {
+			smooth[i] = exp(-1e-6 * (double) (i * i));
+			noise[i] = dist(gen);
+		}
+		for (const vector<double>& x : {smooth, noise, zero}) {
+			size_t bytes = x.size() * sizeof(double) - 3;
+			auto c = Compression::Compress(x.data(), bytes, Compression::Codec::builtin, sizeof(double));
+			vector<double> y(x.size(), 1.);
+			Compression::Decompress(c.data(), c.size(), y.data(), bytes,
+				Compression::Codec::builtin, sizeof(double));
+				CHECK(memcmp(x.data(), y.data(), bytes) == 0);
+		}
+		auto c = Compression::Compress(zero.data(), zero.size() * sizeof(double), Compression::Codec::builtin);
+			CHECK(c.size() < zero.size() / 10);
+	}
+
+	TEST (Restart) {
+		Tree tree = TreeFactory::BalancedTree(12, 3, 4);
+		mt19937 gen(8642);
+		TensorTreecd Psi(gen, tree, false);
+		string file("TensorTree.rst");
+
+		/// Small blocks: several blocks per node and per batch
+		Checkpoint::RestartParameters par;
+		par.codec = Compression::Codec::builtin;
+		par.blockSize = 100;
+		{
+			CheckpointWriter<complex<double>> writer(par);
+			writer.Write(Psi, tree, file);
+			Psi *= 2.;
+			writer.Write(Psi, tree, file);
+			writer.Wait();
+				CHECK_EQUAL(2, writer.nWritten());
+				CHECK(!writer.Busy());
+				CHECK(writer.Bytes() > 0);
+		}
+
+		Tree tree2;
+		TensorTreecd Chi;
+		Checkpoint::ReadRestart(tree2, Chi, file);
+			CHECK_EQUAL(tree.nNodes(), tree2.nNodes());
+			CHECK_EQUAL(tree.nLeaves(), tree2.nLeaves());
+			CHECK(Chi.Contiguous());
+		for (const Node& node : tree2) {
+				CHECK(node.shape() == tree.GetNode(node.Address()).shape());
+				CHECK_EQUAL(Psi[node], Chi[node]);
+		}
+
+		/// Uncompressed
+		par.codec = Compression::Codec::none;
+		par.blockSize = 1 << 20;
+		TensorTreed X(gen, tree, false);
+		Checkpoint::WriteRestart(X, tree, file, par);
+		TensorTreed Y;
+		Checkpoint::ReadRestart(tree2, Y, file);
+		for (const Node& node : tree) {
+				CHECK_EQUAL(X[node], Y[node]);
+		}
+	}
+
+	TEST (OutOfCore) {
+		Tree tree = TreeFactory::BalancedTree(12, 3, 4);
+		mt19937 gen(1357);
+		TensorTreecd Psi(gen, tree, false);
+		TensorTreecd Chi(gen, tree, false);
+		MatrixTreecd S = TreeFunctions::DotProduct(Psi, Chi, tree);
+		MatrixTreecd Rho = TreeFunctions::Contraction(Psi, Chi, S, tree);
+
+		/// Cache for a few nodes only
+		size_t cache = 4 * tree.TopNode().shape().totalDimension() * sizeof(complex<double>);
+		{
+			OutOfCoreTensorTree<complex<double>> Bra(Psi, "Bra.ooc", cache);
+			OutOfCoreTensorTree<complex<double>> Ket(tree, "Ket.ooc", cache);
+			for (const Node& node : tree) {
+					CHECK_EQUAL(Tensorcd(node.shape()), *Ket.Read(node));
+				Ket.Write(node, Chi[node]);
+			}
+				CHECK(Ket.CachedBytes() <= Ket.CacheBytes());
 
+			MatrixTreecd S2 = TreeFunctions::DotProduct(Bra, Ket, tree);
+			MatrixTreecd Rho2(tree);
+			TreeFunctions::Contraction(Rho2, Bra, Ket, tree, &S2);
+			for (const Node& node : tree) {
+					CHECK_CLOSE(0., Residual(S[node], S2[node]), 1e-12);
+					CHECK_CLOSE(0., Residual(Rho[node], Rho2[node]), 1e-12);
+			}
+				CHECK(Bra.nMisses() + Bra.nPrefetched() > tree.nNodes());
+				CHECK(Bra.CachedBytes() <= Bra.CacheBytes());
+		}
+
+		/// Modified tensors are on disk after the destructor
+		OutOfCoreTensorTree<complex<double>> Ket("Ket.ooc", cache);
+		TensorTreecd Loaded = Ket.Load();
+		for (const Node& node : tree) {
+				CHECK_EQUAL(Chi[node], *Ket.Read(node));
+				CHECK_EQUAL(Chi[node], Loaded[node]);
+		}
+		TensorTreecd Read;
+		Checkpoint::Read(Read, "Ket.ooc");
+			CHECK_EQUAL(Chi[tree.TopNode()], Read[tree.TopNode()]);
+
+		/// The CRCs stay valid until a tensor is written back
+		Checkpoint::Write(Psi, "Psi.ooc");
+		{
+			OutOfCoreTensorTree<complex<double>> Bra("Psi.ooc", cache);
+			for (const Node& node : tree) {
+					CHECK_EQUAL(Psi[node], *Bra.Read(node));
+			}
+		}
+		{
+			ifstream is("Psi.ooc", ios::binary);
+				CHECK(Checkpoint::ReadIndex(is).crc);
+		}
+		{
+			OutOfCoreTensorTree<complex<double>> Bra("Psi.ooc", cache);
+			Bra.Write(tree.TopNode(), Chi[tree.TopNode()]);
+		}
+		ifstream is("Psi.ooc", ios::binary);
+			CHECK(!Checkpoint::ReadIndex(is).crc);
+	}
+}